@@ -0,0 +1,292 @@
+#include "AdaptiveSampling.hpp"
+#include "IterationBudget.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Pipeline.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+	// spec constant of supersample.comp
+	static constexpr uint32_t SAMPLES_CONSTANT = 0;
+	// bits of -1.0f, the shade of pixels that were not supersampled
+	static constexpr uint32_t NO_SHADE = 0xbf800000;
+}
+
+namespace fve {
+
+	AdaptiveSampling::AdaptiveSampling(Device& device,
+									   std::shared_ptr<Shader> classifyShader,
+									   std::shared_ptr<Shader> supersampleShader,
+									   const IterationBudget& iterationBudget,
+									   vk::Extent2D extent,
+									   uint32_t samples,
+									   float threshold)
+		:
+		device_{ device },
+		iterationBudget_{ iterationBudget },
+		extent_{ extent },
+		samples_{ samples == 0 ? 0 : std::clamp(samples, MIN_SAMPLES, MAX_SAMPLES) },
+		threshold_{ threshold }
+	{
+		createBuffers();
+		createDescriptors();
+		clearShades();
+
+		if (samples_ == 0)
+			return;
+
+		if (!classifyShader || !supersampleShader) {
+			Log_warn("supersampling shaders are not loaded, edges are drawn at 1 spp");
+			return;
+		}
+
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(PushConstant));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.setSetLayouts(*computeSetLayout_);
+		pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+
+		try {
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create supersampling pipeline layout. error {}", err.what());
+			throw;
+		}
+
+		// the sample count is baked into the loop of the supersampling pass
+		Pipeline::Specialization specialization{};
+		specialization.set(SAMPLES_CONSTANT, samples_);
+		const auto specializationInfo = specialization.info();
+
+		classifyPipeline_ = createComputePipeline(classifyShader, nullptr);
+		supersamplePipeline_ = createComputePipeline(supersampleShader, &specializationInfo);
+	}
+
+	AdaptiveSampling::~AdaptiveSampling() noexcept {
+	}
+
+	void AdaptiveSampling::setCells(const std::vector<glm::vec4>& cells) {
+		if (cells.size() > MAX_CELLS)
+			Log_warn("{} mandelbrot cells, only the first {} are supersampled", cells.size(), MAX_CELLS);
+		cellCount_ = static_cast<uint32_t>(std::min<size_t>(cells.size(), MAX_CELLS));
+		if (cellCount_ > 0)
+			cells_->write(cells.data(), cellCount_ * sizeof(glm::vec4), 0);
+		if (samples_ > 0)
+			Log_info("supersampling edges of {} cells at {} spp", cellCount_, samples_);
+	}
+
+	void AdaptiveSampling::setView(const glm::vec2& center, float scale, int32_t steps) noexcept {
+		center_ = center;
+		scale_ = scale;
+		steps_ = steps > 0 ? steps : DEFAULT_STEPS;
+	}
+
+	void AdaptiveSampling::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSet_, nullptr);
+	}
+
+	void AdaptiveSampling::update(vk::CommandBuffer commandBuffer) {
+		if (!enabled())
+			return;
+
+		// the previous passes are done with the list, the render pass with the iterations and shades
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eIndirectCommandRead);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect,
+										  vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+										  {},
+										  memoryBarrier,
+										  nullptr,
+										  nullptr);
+		}
+
+		const std::array<uint32_t, 3> dispatch{ 0, 1, 1 };
+		commandBuffer.fillBuffer(edges_->buffer(), 0, sizeof(uint32_t), 0);
+		commandBuffer.updateBuffer(dispatch_->buffer(), 0, sizeof(dispatch), dispatch.data());
+
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+		}
+
+		const PushConstant pushConstant{ extent_.width, extent_.height, cellCount_, threshold_, center_, scale_, static_cast<uint32_t>(steps_) };
+		const auto computeSet = computeSets_[iterationBudget_.current()];
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, computeSet, nullptr);
+		commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *classifyPipeline_);
+		commandBuffer.dispatch((extent_.width + TILE_SIZE - 1) / TILE_SIZE, (extent_.height + TILE_SIZE - 1) / TILE_SIZE, 1);
+
+		// the classification counted the workgroups of the supersampling
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+										  vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+										  {},
+										  memoryBarrier,
+										  nullptr,
+										  nullptr);
+		}
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *supersamplePipeline_);
+		commandBuffer.dispatchIndirect(dispatch_->buffer(), 0);
+
+		// shown by the next frame's render pass
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, memoryBarrier, nullptr, nullptr);
+	}
+
+	void AdaptiveSampling::createBuffers() {
+		const auto pixels = static_cast<vk::DeviceSize>(extent_.width) * extent_.height;
+
+		shades_ = std::make_unique<Buffer>(device_,
+										   sizeof(float),
+										   pixels,
+										   vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+										   vk::MemoryPropertyFlagBits::eDeviceLocal,
+										   "supersampling shades");
+
+		edges_ = std::make_unique<Buffer>(device_,
+										  sizeof(uint32_t),
+										  pixels + 1,
+										  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+										  vk::MemoryPropertyFlagBits::eDeviceLocal,
+										  "supersampling edges");
+
+		dispatch_ = std::make_unique<Buffer>(device_,
+											 sizeof(uint32_t),
+											 3,
+											 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+											 vk::MemoryPropertyFlagBits::eDeviceLocal,
+											 "supersampling dispatch");
+
+		cells_ = std::make_unique<Buffer>(device_,
+										  sizeof(glm::vec4),
+										  MAX_CELLS,
+										  vk::BufferUsageFlagBits::eStorageBuffer,
+										  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+										  "supersampling cells");
+	}
+
+	void AdaptiveSampling::createDescriptors() {
+		// the render pass only reads the shades
+		vk::DescriptorSetLayoutBinding shadesBinding{};
+		shadesBinding.setBinding(0);
+		shadesBinding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		shadesBinding.setDescriptorCount(1);
+		shadesBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+		// 0 iterations, 1 shades, 2 edges, 3 dispatch, 4 cells
+		std::array<vk::DescriptorSetLayoutBinding, 5> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].setBinding(i);
+			bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			bindings[i].setDescriptorCount(1);
+			bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		}
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(shadesBinding);
+
+		vk::DescriptorSetLayoutCreateInfo computeSetLayoutCreateInfo{};
+		computeSetLayoutCreateInfo.setBindings(bindings);
+
+		const auto setCount = static_cast<uint32_t>(computeSets_.size()) + 1;
+		vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(bindings.size() * computeSets_.size()) + 1 };
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(setCount);
+		descriptorPoolCreateInfo.setPoolSizes(poolSize);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			computeSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(computeSetLayoutCreateInfo);
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			std::array<vk::DescriptorSetLayout, 3> setLayouts{ *descriptorSetLayout_, *computeSetLayout_, *computeSetLayout_ };
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(setLayouts);
+
+			const auto descriptorSets = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo);
+			descriptorSet_ = descriptorSets[0];
+			std::copy(descriptorSets.begin() + 1, descriptorSets.end(), computeSets_.begin());
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create supersampling descriptors. error {}", err.what());
+			throw;
+		}
+
+		vk::DescriptorBufferInfo shadesInfo{ shades_->buffer(), 0, VK_WHOLE_SIZE };
+		vk::WriteDescriptorSet shadesWrite{};
+		shadesWrite.setDstSet(descriptorSet_);
+		shadesWrite.setDstBinding(0);
+		shadesWrite.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		shadesWrite.setBufferInfo(shadesInfo);
+		device_.logical().updateDescriptorSets(shadesWrite, nullptr);
+
+		for (uint32_t i = 0; i < computeSets_.size(); ++i) {
+			std::array<vk::DescriptorBufferInfo, 5> infos{
+				vk::DescriptorBufferInfo{ iterationBudget_.iterations(i), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ shades_->buffer(), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ edges_->buffer(), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ dispatch_->buffer(), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ cells_->buffer(), 0, VK_WHOLE_SIZE }
+			};
+
+			std::array<vk::WriteDescriptorSet, 5> writes{};
+			for (uint32_t binding = 0; binding < writes.size(); ++binding) {
+				writes[binding].setDstSet(computeSets_[i]);
+				writes[binding].setDstBinding(binding);
+				writes[binding].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+				writes[binding].setBufferInfo(infos[binding]);
+			}
+
+			device_.logical().updateDescriptorSets(writes, nullptr);
+		}
+	}
+
+	vk::UniquePipeline AdaptiveSampling::createComputePipeline(std::shared_ptr<Shader> shader, const vk::SpecializationInfo* specializationInfo) {
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+		shaderStageCreateInfo.setPSpecializationInfo(specializationInfo);
+
+		vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+		computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+		computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+		try {
+			return device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create supersampling pipeline. error {}", err.what());
+		}
+		return {};
+	}
+
+	void AdaptiveSampling::clearShades() {
+		auto commandBuffer = device_.beginSingleTimeCommandBuffer();
+		commandBuffer.fillBuffer(shades_->buffer(), 0, VK_WHOLE_SIZE, NO_SHADE);
+		device_.endSingleTimeCommandBuffer(commandBuffer);
+	}
+
+}
\ No newline at end of file
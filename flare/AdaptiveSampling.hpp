@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+	class IterationBudget;
+
+	// anti-aliasing of the mandelbrot edges only. after the render pass a compute pass classifies
+	// the 1 spp iterations, pixels whose 3x3 neighbourhood varies by more than the threshold are
+	// appended to a compacted list that also counts the workgroups of an indirect dispatch. a second
+	// pass supersamples just the listed pixels and stores their shade. see
+	// shaders/supersample_classify.comp and shaders/supersample.comp
+	//
+	// like the iteration budget this is a feedback loop, mandelbrot.frag shows the supersampled
+	// shades from the frame before as long as the view stands still
+	class AdaptiveSampling final {
+	public:
+		// workgroup sides of the classification and workgroup size of the supersampling
+		static constexpr uint32_t TILE_SIZE = 16;
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+		static constexpr uint32_t MIN_SAMPLES = 4;
+		static constexpr uint32_t MAX_SAMPLES = 64;
+		// mandelbrot cells of a gallery beyond this are drawn at 1 spp
+		static constexpr uint32_t MAX_CELLS = 64;
+		// MAX_STEPS of mandelbrot.frag when the quality constant is not set
+		static constexpr int32_t DEFAULT_STEPS = 256;
+
+		// samples of 0 disable the passes, others are clamped to MIN_SAMPLES..MAX_SAMPLES
+		explicit AdaptiveSampling(Device& device,
+								  std::shared_ptr<Shader> classifyShader,
+								  std::shared_ptr<Shader> supersampleShader,
+								  const IterationBudget& iterationBudget,
+								  vk::Extent2D extent,
+								  uint32_t samples,
+								  float threshold);
+
+		~AdaptiveSampling() noexcept;
+
+		AdaptiveSampling(const AdaptiveSampling&) = delete;
+		AdaptiveSampling& operator=(const AdaptiveSampling&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+		inline bool enabled() const noexcept { return samples_ > 0 && cellCount_ > 0 && classifyPipeline_ && supersamplePipeline_; }
+
+		// framebuffer areas drawn by mandelbrot.frag as offset xy and size zw, nothing else is classified
+		void setCells(const std::vector<glm::vec4>& cells);
+		// the view and step count of the frame the passes are recorded for
+		void setView(const glm::vec2& center, float scale, int32_t steps) noexcept;
+
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set);
+
+		// must be recorded after IterationBudget::update, the iterations of this frame are classified
+		void update(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct PushConstant {
+			uint32_t width;
+			uint32_t height;
+			uint32_t cellCount;
+			float threshold;
+			glm::vec2 center;
+			float scale;
+			uint32_t steps;
+		};
+
+		void createBuffers();
+		void createDescriptors();
+		vk::UniquePipeline createComputePipeline(std::shared_ptr<Shader> shader, const vk::SpecializationInfo* specializationInfo);
+		void clearShades();
+
+		Device& device_;
+		const IterationBudget& iterationBudget_;
+		vk::Extent2D extent_;
+		uint32_t samples_ = 0;
+		float threshold_ = 1.0f;
+		uint32_t cellCount_ = 0;
+		glm::vec2 center_{ 0.0f, 0.0f };
+		float scale_ = 1.0f;
+		int32_t steps_ = DEFAULT_STEPS;
+		// one float per pixel, negative where the pixel was not supersampled
+		std::unique_ptr<Buffer> shades_ = nullptr;
+		// count followed by the indices of the listed pixels
+		std::unique_ptr<Buffer> edges_ = nullptr;
+		std::unique_ptr<Buffer> dispatch_ = nullptr;
+		std::unique_ptr<Buffer> cells_ = nullptr;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorSetLayout computeSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		vk::DescriptorSet descriptorSet_;
+		// set i classifies the iteration buffer i of the iteration budget
+		std::array<vk::DescriptorSet, 2> computeSets_;
+		vk::UniquePipelineLayout pipelineLayout_;
+		vk::UniquePipeline classifyPipeline_;
+		vk::UniquePipeline supersamplePipeline_;
+	};
+
+}
\ No newline at end of file
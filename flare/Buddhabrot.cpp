@@ -0,0 +1,239 @@
+#include "Buddhabrot.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Pipeline.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+	// spec constant of buddhabrot.comp
+	static constexpr uint32_t SAMPLES_PER_INVOCATION_CONSTANT = 3;
+}
+
+namespace fve {
+
+	Buddhabrot::Buddhabrot(Device& device, std::shared_ptr<Shader> shader, vk::Extent2D extent, uint32_t samplesPerFrame) : device_{ device }, extent_{ extent } {
+		const auto samplesPerWorkgroup = WORKGROUP_SIZE * SAMPLES_PER_INVOCATION;
+		workgroupCount_ = std::max(1u, (samplesPerFrame + samplesPerWorkgroup - 1) / samplesPerWorkgroup);
+
+		createBuffers();
+		createDescriptors();
+		createComputePipeline(shader);
+	}
+
+	Buddhabrot::~Buddhabrot() noexcept {
+	}
+
+	void Buddhabrot::setView(const glm::vec2& center, float scale) noexcept {
+		if (center == center_ && scale == scale_)
+			return;
+		center_ = center;
+		scale_ = scale;
+		reset_ = true;
+	}
+
+	void Buddhabrot::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSet_, nullptr);
+	}
+
+	void Buddhabrot::update(vk::CommandBuffer commandBuffer) {
+		if (!enabled())
+			return;
+
+		if (reset_) {
+			samples_ = 0;
+			// the previous frame may still be resolving the histogram
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, {}, memoryBarrier, nullptr, nullptr);
+
+			commandBuffer.fillBuffer(histogram_->buffer(), 0, VK_WHOLE_SIZE, 0);
+			reset_ = false;
+		}
+
+		const bool accumulate = samples_ < MAX_SAMPLES;
+		if (accumulate) {
+			// the clear above, or the previous resolve reading while this pass keeps adding up
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader,
+										  vk::PipelineStageFlagBits::eComputeShader,
+										  {},
+										  memoryBarrier,
+										  nullptr,
+										  nullptr);
+
+			PushConstant pushConstant{ center_, scale_, seed_++, extent_.width, extent_.height };
+
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline_);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, descriptorSet_, nullptr);
+			commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+			commandBuffer.dispatch(workgroupCount_, 1, 1);
+
+			const auto samples = static_cast<uint64_t>(workgroupCount_) * WORKGROUP_SIZE * SAMPLES_PER_INVOCATION;
+			samples_ += samples;
+			reportSamples_ += samples;
+		}
+
+		// the resolve of the previous frame has to be done before the constants are replaced
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, {}, memoryBarrier, nullptr, nullptr);
+		}
+
+		Resolve resolve{};
+		resolve.width = extent_.width;
+		resolve.height = extent_.height;
+		resolve.density = static_cast<float>(static_cast<double>(samples_) / (static_cast<double>(extent_.width) * extent_.height));
+		commandBuffer.updateBuffer(resolve_->buffer(), 0, sizeof(Resolve), &resolve);
+
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+									  vk::PipelineStageFlagBits::eFragmentShader,
+									  {},
+									  memoryBarrier,
+									  nullptr,
+									  nullptr);
+
+		report();
+	}
+
+	void Buddhabrot::createBuffers() {
+		histogram_ = std::make_unique<Buffer>(device_,
+											  sizeof(uint32_t),
+											  static_cast<vk::DeviceSize>(extent_.width) * extent_.height * 3,
+											  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+											  vk::MemoryPropertyFlagBits::eDeviceLocal,
+											  "buddhabrot histogram");
+
+		resolve_ = std::make_unique<Buffer>(device_,
+											sizeof(Resolve),
+											1,
+											vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+											vk::MemoryPropertyFlagBits::eDeviceLocal,
+											"buddhabrot resolve");
+	}
+
+	void Buddhabrot::createDescriptors() {
+		// 0 histogram, 1 resolve constants
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute);
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+
+		vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(bindings.size()) };
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(1);
+		descriptorPoolCreateInfo.setPoolSizes(poolSize);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(*descriptorSetLayout_);
+
+			descriptorSet_ = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo).front();
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create buddhabrot descriptors. error {}", err.what());
+			throw;
+		}
+
+		vk::DescriptorBufferInfo histogramInfo{ histogram_->buffer(), 0, VK_WHOLE_SIZE };
+		vk::DescriptorBufferInfo resolveInfo{ resolve_->buffer(), 0, VK_WHOLE_SIZE };
+
+		std::array<vk::WriteDescriptorSet, 2> writes{};
+		writes[0].setDstSet(descriptorSet_);
+		writes[0].setDstBinding(0);
+		writes[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writes[0].setBufferInfo(histogramInfo);
+		writes[1].setDstSet(descriptorSet_);
+		writes[1].setDstBinding(1);
+		writes[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writes[1].setBufferInfo(resolveInfo);
+
+		device_.logical().updateDescriptorSets(writes, nullptr);
+	}
+
+	void Buddhabrot::createComputePipeline(std::shared_ptr<Shader> shader) {
+		if (!shader) {
+			Log_warn("buddhabrot shader is not loaded, the histogram stays empty");
+			return;
+		}
+
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(PushConstant));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.setSetLayouts(*descriptorSetLayout_);
+		pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+
+		Pipeline::Specialization specialization{};
+		specialization.set(SAMPLES_PER_INVOCATION_CONSTANT, SAMPLES_PER_INVOCATION);
+		const auto specializationInfo = specialization.info();
+
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+		shaderStageCreateInfo.setPSpecializationInfo(&specializationInfo);
+
+		try {
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+			vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+			computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+			computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+			computePipeline_ = device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create buddhabrot pipeline. error {}", err.what());
+			computePipeline_.reset();
+		}
+	}
+
+	void Buddhabrot::report() {
+		const auto now = Trace::now();
+		if (reportTime_ == 0) {
+			reportTime_ = now;
+			reportSamples_ = 0;
+			return;
+		}
+
+		// frames are throttled by the swapchain fences, so over a few seconds the recording rate
+		// matches what the gpu gets through
+		const auto seconds = static_cast<double>(now - reportTime_) / 1e9;
+		if (seconds < REPORT_INTERVAL)
+			return;
+
+		Log_info("buddhabrot {:.2f} M samples/s, {} M samples accumulated", static_cast<double>(reportSamples_) / seconds / 1e6, samples_ / 1000000);
+		reportTime_ = now;
+		reportSamples_ = 0;
+	}
+
+}
\ No newline at end of file
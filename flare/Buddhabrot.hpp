@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+
+	// progressive buddhabrot renderer. every frame a compute pass splats the orbits of a fixed number
+	// of random samples into a histogram that keeps accumulating until the view changes, the
+	// fragment shader tone maps it. see shaders/buddhabrot.comp and shaders/buddhabrot.frag
+	class Buddhabrot final {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+		static constexpr uint32_t SAMPLES_PER_INVOCATION = 16;
+		// accumulation stops here, the busiest bins would overflow soon after
+		static constexpr uint64_t MAX_SAMPLES = 1ull << 34;
+		// seconds between two throughput reports
+		static constexpr double REPORT_INTERVAL = 2.0;
+
+		explicit Buddhabrot(Device& device, std::shared_ptr<Shader> shader, vk::Extent2D extent, uint32_t samplesPerFrame);
+
+		~Buddhabrot() noexcept;
+
+		Buddhabrot(const Buddhabrot&) = delete;
+		Buddhabrot& operator=(const Buddhabrot&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+		inline bool enabled() const noexcept { return enabled_ && computePipeline_; }
+		// nothing is dispatched while disabled
+		inline void enable(bool enabled) noexcept { enabled_ = enabled; }
+		// false once the histogram holds every sample it is going to get for the current view
+		inline bool accumulating() const noexcept { return enabled() && (reset_ || samples_ < MAX_SAMPLES); }
+
+		// the histogram is cleared when the view differs from the previous frame
+		void setView(const glm::vec2& center, float scale) noexcept;
+
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set);
+
+		// must be recorded before the render pass that resolves the histogram
+		void update(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct PushConstant {
+			glm::vec2 center;
+			float scale;
+			uint32_t seed;
+			uint32_t width;
+			uint32_t height;
+		};
+
+		struct Resolve {
+			uint32_t width;
+			uint32_t height;
+			float density;
+		};
+
+		void createBuffers();
+		void createDescriptors();
+		void createComputePipeline(std::shared_ptr<Shader> shader);
+		void report();
+
+		Device& device_;
+		vk::Extent2D extent_;
+		uint32_t workgroupCount_ = 0;
+		bool enabled_ = true;
+		glm::vec2 center_{ 0.0f, 0.0f };
+		float scale_ = 0.0f;
+		bool reset_ = true;
+		uint32_t seed_ = 0;
+		uint64_t samples_ = 0;
+		uint64_t reportSamples_ = 0;
+		int64_t reportTime_ = 0;
+		std::unique_ptr<Buffer> histogram_ = nullptr;
+		std::unique_ptr<Buffer> resolve_ = nullptr;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		vk::DescriptorSet descriptorSet_;
+		vk::UniquePipelineLayout pipelineLayout_;
+		vk::UniquePipeline computePipeline_;
+	};
+
+}
\ No newline at end of file
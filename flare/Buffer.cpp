@@ -1,7 +1,9 @@
 #include "Buffer.hpp"
 #include "Device.hpp"
 
+#include <cstring>
 #include <stdexcept>
+#include <string>
 
 namespace fve {
 
@@ -9,7 +11,8 @@ namespace fve {
 				   vk::DeviceSize instanceSize,
 				   vk::DeviceSize instanceCount,
 				   vk::BufferUsageFlags usageFlags,
-				   vk::MemoryPropertyFlags memoryPropertyFlags)
+				   vk::MemoryPropertyFlags memoryPropertyFlags,
+				   const char* tag)
 		:
 		device_{ device },
 		bufferSize_{ instanceSize * instanceCount },
@@ -17,17 +20,21 @@ namespace fve {
 		instanceCount_{ instanceCount },
 		usageFlags_{ usageFlags }
 	{
-		buffer_ = device_.createBuffer(instanceSize, instanceCount, usageFlags_, memoryPropertyFlags);
+		// a refused allocation, also one beyond the memory limit, must not leave a buffer without handles
+		buffer_ = device_.createBuffer(instanceSize, instanceCount, usageFlags_, memoryPropertyFlags, tag);
+		if (!buffer_.first)
+			throw std::runtime_error{ std::string{ "failed to create buffer " } + tag };
 	}
 
 	Buffer::~Buffer() noexcept {
 		device_.logical().destroyBuffer(buffer_.first);
-		device_.logical().freeMemory(buffer_.second);
+		device_.freeMemory(buffer_.second);
 	}
 
 	bool Buffer::map() noexcept {
 		try {
 			mapped_ = device_.logical().mapMemory(buffer_.second, 0, bufferSize_);
+			return true;
 		}
 		catch (const vk::SystemError& err) {
 			Log_error("failed to map buffer memory. error {}", err.what());
@@ -41,6 +48,38 @@ namespace fve {
 		return false;
 	}
 
+	bool Buffer::write(const void* data, vk::DeviceSize size, vk::DeviceSize offset) {
+		if (offset + size > bufferSize_) {
+			Log_error("failed to write data to the vulkan buffer. out of range");
+			return false;
+		}
+
+		if (!mapped_ && !map()) {
+			Log_error("failed to write data to the vulkan buffer. failed to map buffer memory");
+			return false;
+		}
+
+		std::memcpy(static_cast<char*>(mapped_) + offset, data, size);
+
+		return true;
+	}
+
+	bool Buffer::read(void* data, vk::DeviceSize size, vk::DeviceSize offset) {
+		if (offset + size > bufferSize_) {
+			Log_error("failed to read data from the vulkan buffer. out of range");
+			return false;
+		}
+
+		if (!mapped_ && !map()) {
+			Log_error("failed to read data from the vulkan buffer. failed to map buffer memory");
+			return false;
+		}
+
+		std::memcpy(data, static_cast<const char*>(mapped_) + offset, size);
+
+		return true;
+	}
+
 	bool Buffer::unmap() noexcept {
 		if (!mapped_)
 			return false;
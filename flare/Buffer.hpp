@@ -12,11 +12,13 @@ namespace fve {
 
 	class Buffer final {
 	public:
+		// throws when the buffer or its memory can not be created
 		explicit Buffer(Device& device,
 						vk::DeviceSize instanceSize,
 						vk::DeviceSize instanceCount,
 						vk::BufferUsageFlags usageFlags,
-						vk::MemoryPropertyFlags memoryPropertyFlags);
+						vk::MemoryPropertyFlags memoryPropertyFlags,
+						const char* tag = "buffer");
 
 		~Buffer() noexcept;
 
@@ -42,6 +44,16 @@ namespace fve {
 			return true;
 		}
 
+		// writes the data at the byte offset, the rest of the buffer is left untouched
+		template<typename T>
+		bool write(const std::vector<T>& data, vk::DeviceSize offset) {
+			return write(data.data(), data.size() * sizeof(T), offset);
+		}
+
+		bool write(const void* data, vk::DeviceSize size, vk::DeviceSize offset);
+		// copies out of host visible memory, the gpu writes have to be finished
+		bool read(void* data, vk::DeviceSize size, vk::DeviceSize offset);
+
 		inline vk::Buffer buffer() const noexcept { return buffer_.first; }
 		inline vk::DeviceSize bufferSize() const noexcept { return bufferSize_; }
 		inline vk::DeviceSize instanceCount() const noexcept { return instanceCount_; }
@@ -0,0 +1,103 @@
+#include "Clock.hpp"
+#include "Log.hpp"
+
+#include <chrono>
+#include <type_traits>
+
+namespace {
+	double seconds() noexcept {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+namespace fve {
+
+	static_assert(std::is_trivially_copyable_v<Clock::Frame>, "frames are written to captures as they are");
+
+	Clock::Clock(Source source, double timeStep) : source_{ source }, timeStep_{ timeStep }, start_{ seconds() } {
+	}
+
+	Clock::~Clock() noexcept {
+	}
+
+	Clock::Source Clock::parse(const std::string& name) noexcept {
+		if (name == "fixed")
+			return Source::Fixed;
+		if (name == "replay")
+			return Source::Replay;
+		if (name != "wall")
+			Log_warn("unknown clock {}. skip to wall", name);
+		return Source::Wall;
+	}
+
+	bool Clock::open(const std::string& filepath) noexcept {
+		try {
+			std::ifstream file{ filepath, std::ios::in | std::ios::binary };
+			if (!file.is_open()) {
+				Log_error("failed to open capture {} for reading", filepath);
+				return false;
+			}
+
+			Header header{};
+			file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+			if (!file || header.magic != MAGIC || header.version != VERSION || header.frameSize != sizeof(Frame)) {
+				Log_error("failed to open capture {}. unsupported format", filepath);
+				return false;
+			}
+
+			Frame frame{};
+			frames_.clear();
+			while (file.read(reinterpret_cast<char*>(&frame), sizeof(Frame)))
+				frames_.push_back(frame);
+
+			Log_info("loaded capture {} with {} frames", filepath, frames_.size());
+			return true;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to read capture {}. error {}", filepath, ex.what());
+		}
+		return false;
+	}
+
+	bool Clock::capture(const std::string& filepath) noexcept {
+		try {
+			capture_.open(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!capture_.is_open()) {
+				Log_error("failed to open capture {} for writing", filepath);
+				return false;
+			}
+
+			const Header header{ MAGIC, VERSION, sizeof(Frame), 0 };
+			capture_.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			return true;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to write capture {}. error {}", filepath, ex.what());
+		}
+		return false;
+	}
+
+	bool Clock::next(Frame& frame) noexcept {
+		switch (source_) {
+		case Source::Wall:
+			frame.time = seconds() - start_;
+			break;
+		case Source::Fixed:
+			frame.time = frameCount_ * timeStep_;
+			break;
+		case Source::Replay:
+			if (frameCount_ >= frames_.size())
+				return false;
+			frame = frames_[frameCount_];
+			break;
+		}
+		++frameCount_;
+		return true;
+	}
+
+	void Clock::record(const Frame& frame) noexcept {
+		if (capture_.is_open())
+			capture_.write(reinterpret_cast<const char*>(&frame), sizeof(Frame));
+	}
+
+}
\ No newline at end of file
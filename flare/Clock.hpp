@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fve {
+
+	// source of the per-frame inputs that determine what the gpu renders. the wall clock follows real
+	// time, the fixed clock advances by a constant step per frame and the replay clock plays back a
+	// capture. any clock can capture the frames it produces into a compact binary log
+	class Clock final {
+	public:
+		enum class Source {
+			Wall,
+			Fixed,
+			Replay
+		};
+
+		// everything a frame depends on besides the settings
+		struct Frame {
+			double time;
+			uint32_t width;
+			uint32_t height;
+			float centerX;
+			float centerY;
+			float scale;
+			int32_t quality;
+			// tiles drawn by the frame when it is time sliced, 0 otherwise. the count depends on gpu
+			// timings, a replay draws the captured count instead of measuring its own
+			uint32_t tiles;
+		};
+
+		// 'FLRC'
+		static constexpr uint32_t MAGIC = 0x43524c46;
+		static constexpr uint32_t VERSION = 2;
+
+		explicit Clock(Source source, double timeStep = 1.0 / 60.0);
+
+		~Clock() noexcept;
+
+		Clock(const Clock&) = delete;
+		Clock& operator=(const Clock&) = delete;
+
+		// "wall", "fixed" or "replay", unknown names fall back to the wall clock
+		static Source parse(const std::string& name) noexcept;
+
+		inline Source source() const noexcept { return source_; }
+		inline bool replaying() const noexcept { return source_ == Source::Replay; }
+		inline uint32_t frameCount() const noexcept { return frameCount_; }
+
+		// loads every frame of a capture for the replay clock
+		bool open(const std::string& filepath) noexcept;
+		// starts writing every frame passed to next() into the file
+		bool capture(const std::string& filepath) noexcept;
+
+		// replay fills the whole frame and returns false once the capture is exhausted, the other
+		// clocks only set the time and leave the rest to the caller
+		bool next(Frame& frame) noexcept;
+		// appends the frame to the capture, if one is open
+		void record(const Frame& frame) noexcept;
+
+	private:
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t frameSize;
+			uint32_t reserved;
+		};
+
+		Source source_;
+		double timeStep_;
+		double start_ = 0.0;
+		uint32_t frameCount_ = 0;
+		std::vector<Frame> frames_;
+		std::ofstream capture_;
+	};
+
+}
\ No newline at end of file
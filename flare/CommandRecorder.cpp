@@ -0,0 +1,111 @@
+#include "CommandRecorder.hpp"
+#include "Device.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace fve {
+
+	CommandRecorder::CommandRecorder(Device& device, JobSystem& jobs, uint32_t slotCount, uint32_t threadCount) : device_{ device }, jobs_{ jobs } {
+		createCommandPools(slotCount * maxThreadCount());
+		setThreadCount(threadCount == 0 ? maxThreadCount() : threadCount);
+	}
+
+	uint32_t CommandRecorder::maxThreadCount() const noexcept {
+		return jobs_.threadCount();
+	}
+
+	void CommandRecorder::setThreadCount(uint32_t threadCount) noexcept {
+		threadCount_ = std::clamp(threadCount, 1u, maxThreadCount());
+	}
+
+	void CommandRecorder::record(vk::CommandBuffer commandBuffer,
+								 uint32_t slot,
+								 const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+								 uint32_t drawCount,
+								 const Task& task) {
+		Trace_zone("record secondary");
+
+		if (drawCount == 0)
+			return;
+
+		const auto pools = pools_.begin() + slot * maxThreadCount();
+		try {
+			for (auto pool = pools; pool != pools + maxThreadCount(); ++pool) {
+				device_.logical().resetCommandPool(*pool->commandPool);
+				pool->used = 0;
+			}
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to reset recording command pools. error {}", err.what());
+			throw;
+		}
+
+		const auto partCount = std::min(threadCount_, drawCount);
+		parts_.assign(partCount, vk::CommandBuffer{});
+
+		vk::CommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		commandBufferBeginInfo.setPInheritanceInfo(&inheritanceInfo);
+
+		// one part per job, whichever thread takes it records it with its own pool
+		jobs_.parallelFor(partCount, 1, [&](uint32_t first, uint32_t last) {
+			Trace_zone("record range");
+
+			auto& pool = pools[jobs_.threadIndex()];
+			for (uint32_t part = first; part < last; ++part) {
+				const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * part / partCount);
+				const auto end = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (part + 1) / partCount);
+
+				auto secondary = this->commandBuffer(pool);
+				secondary.begin(commandBufferBeginInfo);
+				task(secondary, begin, end);
+				secondary.end();
+				parts_[part] = secondary;
+			}
+		});
+
+		// parts are executed in order, whichever thread finished first
+		commandBuffer.executeCommands(parts_);
+	}
+
+	void CommandRecorder::createCommandPools(uint32_t poolCount) {
+		auto indices = Device::QueueFamilyIndices::findQueueFamilyIndices(device_.physical(), device_.surface());
+
+		vk::CommandPoolCreateInfo commandPoolCreateInfo{};
+		commandPoolCreateInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+		commandPoolCreateInfo.setQueueFamilyIndex(indices.graphicsFamily.value());
+
+		pools_.resize(poolCount);
+
+		try {
+			for (auto& pool : pools_)
+				pool.commandPool = device_.logical().createCommandPoolUnique(commandPoolCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create recording command pools. error {}", err.what());
+			throw;
+		}
+	}
+
+	vk::CommandBuffer CommandRecorder::commandBuffer(Pool& pool) {
+		if (pool.used == pool.commandBuffers.size()) {
+			vk::CommandBufferAllocateInfo commandBufferAllocateInfo{};
+			commandBufferAllocateInfo.setCommandPool(*pool.commandPool);
+			commandBufferAllocateInfo.setLevel(vk::CommandBufferLevel::eSecondary);
+			commandBufferAllocateInfo.setCommandBufferCount(1);
+
+			try {
+				pool.commandBuffers.push_back(device_.logical().allocateCommandBuffers(commandBufferAllocateInfo).front());
+			}
+			catch (const vk::SystemError& err) {
+				Log_error("failed to allocate recording command buffer. error {}", err.what());
+				throw;
+			}
+		}
+		return pool.commandBuffers[pool.used++];
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace fve {
+
+	class Device;
+	class JobSystem;
+
+	// records the draws of a render pass into secondary command buffers on the job system. every
+	// thread of the job system owns a command pool per slot, so no pool is ever shared between
+	// threads. the draws are split into contiguous parts, one secondary command buffer each, and the
+	// secondary command buffers are executed in part order, which keeps the result independent of
+	// the thread scheduling
+	class CommandRecorder final {
+	public:
+		// records the draws [begin, end) into the secondary command buffer. no state is inherited
+		// from the primary command buffer, every range has to bind its pipeline and resources
+		using Task = std::function<void(vk::CommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
+		// threadCount 0 records with every thread of the job system
+		explicit CommandRecorder(Device& device, JobSystem& jobs, uint32_t slotCount, uint32_t threadCount = 0);
+
+		CommandRecorder(const CommandRecorder&) = delete;
+		CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+		uint32_t maxThreadCount() const noexcept;
+		// parts the draws are split into, at most one per thread
+		inline uint32_t threadCount() const noexcept { return threadCount_; }
+		// clamped to [1, maxThreadCount()]
+		void setThreadCount(uint32_t threadCount) noexcept;
+
+		// must be called inside a render pass begun with vk::SubpassContents::eSecondaryCommandBuffers.
+		// the previous submission of the slot has to be complete, its command pools are reset. the
+		// threads that are not workers share the pools of the job system's index 0, so the calling
+		// thread has to be the only one of them recording
+		void record(vk::CommandBuffer commandBuffer,
+					uint32_t slot,
+					const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+					uint32_t drawCount,
+					const Task& task);
+
+	private:
+		struct Pool {
+			vk::UniqueCommandPool commandPool;
+			// allocated as needed, a thread records as many parts as it takes
+			std::vector<vk::CommandBuffer> commandBuffers;
+			uint32_t used = 0;
+		};
+
+		void createCommandPools(uint32_t poolCount);
+		vk::CommandBuffer commandBuffer(Pool& pool);
+
+		Device& device_;
+		JobSystem& jobs_;
+		uint32_t threadCount_ = 1;
+		// indexed by slot * maxThreadCount() + thread index of the job system
+		std::vector<Pool> pools_;
+		// the secondary command buffers of the parts of the last record, in part order
+		std::vector<vk::CommandBuffer> parts_;
+	};
+
+}
\ No newline at end of file
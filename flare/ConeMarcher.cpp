@@ -0,0 +1,298 @@
+#include "ConeMarcher.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Pipeline.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+	// spec constant of mandelbulb.cone.comp
+	static constexpr uint32_t CONE_STEPS_CONSTANT = 0;
+}
+
+namespace fve {
+
+	ConeMarcher::ConeMarcher(Device& device, std::shared_ptr<Shader> shader, vk::Extent2D extent, uint32_t slotCount, int32_t coneSteps, bool enabled)
+		:
+		device_{ device },
+		tiles_{ (extent.width + TILE_SIZE - 1) / TILE_SIZE, (extent.height + TILE_SIZE - 1) / TILE_SIZE },
+		enabled_{ enabled }
+	{
+		auto indices = Device::QueueFamilyIndices::findQueueFamilyIndices(device_.physical(), device_.surface());
+		const auto timestampValidBits = device_.physical().getQueueFamilyProperties()[indices.graphicsFamily.value()].timestampValidBits;
+		timestamps_ = timestampValidBits > 0;
+		if (timestampValidBits > 0 && timestampValidBits < 64)
+			timestampMask_ = (1ull << timestampValidBits) - 1;
+		timestampPeriod_ = static_cast<double>(device_.physical().getProperties().limits.timestampPeriod);
+
+		createBuffers();
+		createDescriptors();
+		createQueryPool(slotCount);
+
+		// without the pre-pass every ray starts at the camera
+		auto commandBuffer = device_.beginSingleTimeCommandBuffer();
+		commandBuffer.fillBuffer(depths_->buffer(), 0, VK_WHOLE_SIZE, 0);
+		device_.endSingleTimeCommandBuffer(commandBuffer);
+
+		if (enabled_)
+			createComputePipeline(shader, coneSteps);
+	}
+
+	ConeMarcher::~ConeMarcher() noexcept {
+	}
+
+	void ConeMarcher::setCells(const std::vector<glm::vec4>& cells) {
+		if (cells.size() > MAX_CELLS)
+			Log_warn("{} mandelbulb cells, only the first {} are cone marched", cells.size(), MAX_CELLS);
+		cellCount_ = static_cast<uint32_t>(std::min<size_t>(cells.size(), MAX_CELLS));
+		if (cellCount_ > 0) {
+			cells_->write(cells.data(), cellCount_ * sizeof(glm::vec4), 0);
+			if (enabled())
+				Log_info("mandelbulb depth pre-pass of {}x{} cones of {} px", tiles_.width, tiles_.height, TILE_SIZE);
+			else
+				Log_info("mandelbulb rays are marched from the camera");
+			if (!timestamps_)
+				Log_warn("graphics queue does not support timestamps, raymarching is not timed");
+		}
+	}
+
+	void ConeMarcher::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSet_, nullptr);
+	}
+
+	void ConeMarcher::update(vk::CommandBuffer commandBuffer, uint32_t slot, const glm::vec2& center, float scale, float time) {
+		if (cellCount_ == 0)
+			return;
+
+		currentSlot_ = slot;
+		if (timestamps_) {
+			readTimings(slot);
+			commandBuffer.resetQueryPool(*queryPool_, slot * QUERIES, QUERIES);
+			commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *queryPool_, slot * QUERIES);
+		}
+
+		if (enabled()) {
+			// the previous render pass may still be reading the depths
+			{
+				vk::MemoryBarrier memoryBarrier{};
+				memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+				memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+				commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+			}
+
+			const PushConstant pushConstant{ center, scale, time, tiles_.width, tiles_.height, cellCount_ };
+
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline_);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, descriptorSet_, nullptr);
+			commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+			commandBuffer.dispatch((tiles_.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (tiles_.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, memoryBarrier, nullptr, nullptr);
+		}
+
+		if (timestamps_)
+			commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *queryPool_, slot * QUERIES + 1);
+	}
+
+	void ConeMarcher::beginRenderPass(vk::CommandBuffer commandBuffer) {
+		if (cellCount_ == 0 || !timestamps_)
+			return;
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *queryPool_, currentSlot_ * QUERIES + 2);
+	}
+
+	void ConeMarcher::endRenderPass(vk::CommandBuffer commandBuffer) {
+		if (cellCount_ == 0 || !timestamps_)
+			return;
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *queryPool_, currentSlot_ * QUERIES + 3);
+		measured_[currentSlot_] = true;
+	}
+
+	void ConeMarcher::readTimings(uint32_t slot) {
+		if (!measured_[slot])
+			return;
+		measured_[slot] = false;
+
+		std::array<uint64_t, QUERIES> timestamps{};
+		const auto result = device_.logical().getQueryPoolResults(*queryPool_,
+																  slot * QUERIES,
+																  QUERIES,
+																  timestamps.size() * sizeof(uint64_t),
+																  timestamps.data(),
+																  sizeof(uint64_t),
+																  vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess)
+			return;
+
+		const auto milliseconds = [&](uint32_t begin) {
+			const auto ticks = ((timestamps[begin + 1] & timestampMask_) - (timestamps[begin] & timestampMask_)) & timestampMask_;
+			return static_cast<double>(ticks) * timestampPeriod_ / 1e6;
+		};
+		coneTime_ += milliseconds(0);
+		renderTime_ += milliseconds(2);
+		++reportFrames_;
+
+		report();
+	}
+
+	void ConeMarcher::report() {
+		const auto now = Trace::now();
+		if (reportTime_ == 0) {
+			reportTime_ = now;
+			coneTime_ = 0.0;
+			renderTime_ = 0.0;
+			reportFrames_ = 0;
+			return;
+		}
+
+		const auto seconds = static_cast<double>(now - reportTime_) / 1e9;
+		if (seconds < REPORT_INTERVAL || reportFrames_ == 0)
+			return;
+
+		// the render pass draws every cell, the other effects of a gallery are included
+		if (enabled())
+			Log_info("mandelbulb cone pre-pass {:.3f} ms, render pass {:.3f} ms per frame", coneTime_ / reportFrames_, renderTime_ / reportFrames_);
+		else
+			Log_info("mandelbulb per-pixel march, render pass {:.3f} ms per frame", renderTime_ / reportFrames_);
+		reportTime_ = now;
+		coneTime_ = 0.0;
+		renderTime_ = 0.0;
+		reportFrames_ = 0;
+	}
+
+	void ConeMarcher::createBuffers() {
+		depths_ = std::make_unique<Buffer>(device_,
+										   sizeof(float),
+										   static_cast<vk::DeviceSize>(tiles_.width) * tiles_.height,
+										   vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+										   vk::MemoryPropertyFlagBits::eDeviceLocal,
+										   "cone depths");
+
+		cells_ = std::make_unique<Buffer>(device_,
+										  sizeof(glm::vec4),
+										  MAX_CELLS,
+										  vk::BufferUsageFlagBits::eStorageBuffer,
+										  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+										  "cone cells");
+	}
+
+	void ConeMarcher::createDescriptors() {
+		// 0 depths, 1 cells
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute);
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+
+		vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(bindings.size()) };
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(1);
+		descriptorPoolCreateInfo.setPoolSizes(poolSize);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(*descriptorSetLayout_);
+
+			descriptorSet_ = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo).front();
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create cone marching descriptors. error {}", err.what());
+			throw;
+		}
+
+		vk::DescriptorBufferInfo depthsInfo{ depths_->buffer(), 0, VK_WHOLE_SIZE };
+		vk::DescriptorBufferInfo cellsInfo{ cells_->buffer(), 0, VK_WHOLE_SIZE };
+
+		std::array<vk::WriteDescriptorSet, 2> writes{};
+		writes[0].setDstSet(descriptorSet_);
+		writes[0].setDstBinding(0);
+		writes[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writes[0].setBufferInfo(depthsInfo);
+		writes[1].setDstSet(descriptorSet_);
+		writes[1].setDstBinding(1);
+		writes[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writes[1].setBufferInfo(cellsInfo);
+
+		device_.logical().updateDescriptorSets(writes, nullptr);
+	}
+
+	void ConeMarcher::createComputePipeline(std::shared_ptr<Shader> shader, int32_t coneSteps) {
+		if (!shader) {
+			Log_warn("cone marching shader is not loaded, mandelbulb rays are marched from the camera");
+			return;
+		}
+
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(PushConstant));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.setSetLayouts(*descriptorSetLayout_);
+		pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+
+		// the shader default applies when no step count is set
+		Pipeline::Specialization specialization{};
+		if (coneSteps > 0)
+			specialization.set(CONE_STEPS_CONSTANT, coneSteps);
+		const auto specializationInfo = specialization.info();
+
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+		shaderStageCreateInfo.setPSpecializationInfo(&specializationInfo);
+
+		try {
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+			vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+			computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+			computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+			computePipeline_ = device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create cone marching pipeline. error {}", err.what());
+			computePipeline_.reset();
+		}
+	}
+
+	void ConeMarcher::createQueryPool(uint32_t slotCount) {
+		measured_.assign(slotCount, false);
+		if (!timestamps_)
+			return;
+
+		vk::QueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.setQueryType(vk::QueryType::eTimestamp);
+		queryPoolCreateInfo.setQueryCount(slotCount * QUERIES);
+
+		try {
+			queryPool_ = device_.logical().createQueryPoolUnique(queryPoolCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create vulkan query pool. error {}", err.what());
+			throw;
+		}
+	}
+
+}
\ No newline at end of file
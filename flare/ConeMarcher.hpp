@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+
+	// low resolution depth pre-pass of mandelbulb.frag. before the render pass a compute pass marches
+	// one cone per TILE_SIZE x TILE_SIZE tile of the mandelbulb cells, wide enough to hold the rays
+	// of every pixel of the tile, and stops where the distance estimate gets close to the cone. no
+	// ray of the tile hits anything before that depth, so the fragment shader starts there instead
+	// of at the camera. see shaders/mandelbulb.cone.comp
+	//
+	// the pre-pass and the render pass are timed and reported periodically. while disabled the
+	// depths stay 0, every pixel is marched from the camera and the timings are those of the plain
+	// per-pixel march
+	class ConeMarcher final {
+	public:
+		// CONE_TILE of shaders/include/mandelbulb.glsl
+		static constexpr uint32_t TILE_SIZE = 8;
+		// tiles per side of a workgroup
+		static constexpr uint32_t WORKGROUP_SIZE = 8;
+		// mandelbulb cells of a gallery beyond this are marched from the camera
+		static constexpr uint32_t MAX_CELLS = 64;
+		// seconds between two timing reports
+		static constexpr double REPORT_INTERVAL = 2.0;
+
+		// coneSteps is the step count of a cone, a specialization constant of the pre-pass
+		explicit ConeMarcher(Device& device, std::shared_ptr<Shader> shader, vk::Extent2D extent, uint32_t slotCount, int32_t coneSteps, bool enabled);
+
+		~ConeMarcher() noexcept;
+
+		ConeMarcher(const ConeMarcher&) = delete;
+		ConeMarcher& operator=(const ConeMarcher&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+		inline bool enabled() const noexcept { return enabled_ && cellCount_ > 0 && computePipeline_; }
+
+		// framebuffer areas drawn by mandelbulb.frag as offset xy and size zw, nothing is timed without
+		void setCells(const std::vector<glm::vec4>& cells);
+
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set);
+
+		// must be recorded before the render pass with the view of its push constants. the previous
+		// frame of the slot has to be done, its timings are read back
+		void update(vk::CommandBuffer commandBuffer, uint32_t slot, const glm::vec2& center, float scale, float time);
+		// outside of the render pass, around it
+		void beginRenderPass(vk::CommandBuffer commandBuffer);
+		void endRenderPass(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct PushConstant {
+			glm::vec2 center;
+			float scale;
+			float time;
+			uint32_t width;
+			uint32_t height;
+			uint32_t cellCount;
+		};
+
+		// timestamps of a slot, around the pre-pass and around the render pass
+		static constexpr uint32_t QUERIES = 4;
+
+		void createBuffers();
+		void createDescriptors();
+		void createComputePipeline(std::shared_ptr<Shader> shader, int32_t coneSteps);
+		void createQueryPool(uint32_t slotCount);
+		void readTimings(uint32_t slot);
+		void report();
+
+		Device& device_;
+		// tiles per row and column
+		vk::Extent2D tiles_;
+		bool enabled_ = true;
+		uint32_t cellCount_ = 0;
+		uint32_t currentSlot_ = 0;
+		bool timestamps_ = false;
+		double timestampPeriod_ = 1.0;
+		uint64_t timestampMask_ = ~0ull;
+		// true while the queries of the slot hold a frame that was not read back yet
+		std::vector<bool> measured_;
+		// milliseconds summed over the frames since the last report
+		double coneTime_ = 0.0;
+		double renderTime_ = 0.0;
+		uint32_t reportFrames_ = 0;
+		int64_t reportTime_ = 0;
+		std::unique_ptr<Buffer> depths_ = nullptr;
+		std::unique_ptr<Buffer> cells_ = nullptr;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		vk::DescriptorSet descriptorSet_;
+		vk::UniquePipelineLayout pipelineLayout_;
+		vk::UniquePipeline computePipeline_;
+		vk::UniqueQueryPool queryPool_;
+	};
+
+}
\ No newline at end of file
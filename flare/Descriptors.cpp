@@ -0,0 +1,240 @@
+#include "Descriptors.hpp"
+#include "Device.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+	// sets and descriptors of every frame pool, a frame needing more continues in another pool
+	static constexpr uint32_t POOL_SETS = 64;
+	static constexpr std::array<vk::DescriptorPoolSize, 4> POOL_SIZES{
+		vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, 256 },
+		vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, 128 },
+		vk::DescriptorPoolSize{ vk::DescriptorType::eUniformBuffer, 64 },
+		vk::DescriptorPoolSize{ vk::DescriptorType::eStorageImage, 64 }
+	};
+	// stages the table is visible to
+	static constexpr vk::ShaderStageFlags TABLE_STAGES = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+}
+
+namespace fve {
+
+	Descriptors::Descriptors(Device& device, uint32_t slotCount) : device_{ device }, slotCount_{ slotCount } {
+		pools_.resize(slotCount_);
+		currentPools_.resize(slotCount_, 0);
+		for (auto& pools : pools_)
+			pools.push_back(createPool());
+
+		createTable();
+	}
+
+	Descriptors::~Descriptors() noexcept {
+	}
+
+	void Descriptors::beginFrame(uint32_t slot) {
+		++frame_;
+
+		auto& pools = pools_[slot];
+		for (size_t i = 0; i <= currentPools_[slot] && i < pools.size(); ++i)
+			device_.logical().resetDescriptorPool(*pools[i]);
+		currentPools_[slot] = 0;
+
+		recycle(images_);
+		recycle(buffers_);
+	}
+
+	vk::DescriptorSet Descriptors::allocate(uint32_t slot, vk::DescriptorSetLayout layout) {
+		auto& pools = pools_[slot];
+		auto& current = currentPools_[slot];
+		for (;; ++current) {
+			const bool created = current == pools.size();
+			if (created)
+				pools.push_back(createPool());
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*pools[current]);
+			descriptorSetAllocateInfo.setDescriptorSetCount(1);
+			descriptorSetAllocateInfo.setPSetLayouts(&layout);
+
+			try {
+				return device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo).front();
+			}
+			catch (const vk::SystemError& err) {
+				// a full pool moves on to the next one, a set that does not fit into an empty pool never will
+				const auto code = static_cast<vk::Result>(err.code().value());
+				if (created || (code != vk::Result::eErrorOutOfPoolMemory && code != vk::Result::eErrorFragmentedPool)) {
+					Log_error("failed to allocate frame descriptor set. error {}", err.what());
+					throw;
+				}
+			}
+		}
+	}
+
+	uint32_t Descriptors::addImage(vk::ImageView view, vk::Sampler sampler, vk::ImageLayout layout) {
+		const auto handle = acquire(images_);
+		if (handle == INVALID)
+			return INVALID;
+
+		vk::DescriptorImageInfo imageInfo{ sampler, view, layout };
+
+		vk::WriteDescriptorSet write{};
+		write.setDstSet(table_);
+		write.setDstBinding(IMAGE_BINDING);
+		write.setDstArrayElement(handle);
+		write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		write.setDescriptorCount(1);
+		write.setPImageInfo(&imageInfo);
+		device_.logical().updateDescriptorSets(write, nullptr);
+		return handle;
+	}
+
+	uint32_t Descriptors::addBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+		const auto handle = acquire(buffers_);
+		if (handle == INVALID)
+			return INVALID;
+
+		vk::DescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+		vk::WriteDescriptorSet write{};
+		write.setDstSet(table_);
+		write.setDstBinding(BUFFER_BINDING);
+		write.setDstArrayElement(handle);
+		write.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		write.setDescriptorCount(1);
+		write.setPBufferInfo(&bufferInfo);
+		device_.logical().updateDescriptorSets(write, nullptr);
+		return handle;
+	}
+
+	void Descriptors::removeImage(uint32_t handle) {
+		retire(images_, handle);
+	}
+
+	void Descriptors::removeBuffer(uint32_t handle) {
+		retire(buffers_, handle);
+	}
+
+	void Descriptors::bind(vk::CommandBuffer commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, uint32_t set) const {
+		if (table_)
+			commandBuffer.bindDescriptorSets(bindPoint, pipelineLayout, set, table_, nullptr);
+	}
+
+	uint32_t Descriptors::acquire(Handles& handles) noexcept {
+		if (!handles.free.empty()) {
+			const auto handle = handles.free.back();
+			handles.free.pop_back();
+			return handle;
+		}
+		if (handles.next < handles.capacity)
+			return handles.next++;
+
+		if (table_)
+			Log_warn("bindless table is full, {} handles are in use", handles.capacity);
+		return INVALID;
+	}
+
+	void Descriptors::retire(Handles& handles, uint32_t handle) {
+		if (handle != INVALID)
+			handles.retired.push_back({ handle, frame_ });
+	}
+
+	void Descriptors::recycle(Handles& handles) noexcept {
+		// the frames in flight were all recorded after the removal, see TextureStreamer::update
+		handles.retired.erase(std::remove_if(handles.retired.begin(), handles.retired.end(), [&](const auto& retired) {
+			if (retired.second + slotCount_ + 1 > frame_)
+				return false;
+			handles.free.push_back(retired.first);
+			return true;
+		}), handles.retired.end());
+	}
+
+	vk::UniqueDescriptorPool Descriptors::createPool() const {
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(POOL_SETS);
+		descriptorPoolCreateInfo.setPoolSizes(POOL_SIZES);
+
+		try {
+			return device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create frame descriptor pool. error {}", err.what());
+			throw;
+		}
+	}
+
+	void Descriptors::createTable() {
+		if (!device_.descriptorIndexing()) {
+			try {
+				tableLayout_ = device_.logical().createDescriptorSetLayoutUnique(vk::DescriptorSetLayoutCreateInfo{});
+			}
+			catch (const vk::SystemError& err) {
+				Log_error("failed to create bindless table layout. error {}", err.what());
+				throw;
+			}
+			return;
+		}
+
+		// combined image samplers count against the image and the sampler limits
+		const auto chain = device_.physical().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+		const auto& limits = chain.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+		images_.capacity = std::min({ MAX_IMAGES,
+									  limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+									  limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+									  limits.maxDescriptorSetUpdateAfterBindSampledImages,
+									  limits.maxDescriptorSetUpdateAfterBindSamplers });
+		buffers_.capacity = std::min({ MAX_BUFFERS,
+									   limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+									   limits.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].setBinding(IMAGE_BINDING);
+		bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		bindings[0].setDescriptorCount(images_.capacity);
+		bindings[0].setStageFlags(TABLE_STAGES);
+		bindings[1].setBinding(BUFFER_BINDING);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(buffers_.capacity);
+		bindings[1].setStageFlags(TABLE_STAGES);
+
+		// unused handles are never written, written ones may change while the table is bound
+		const vk::DescriptorBindingFlags flags = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+		const std::array<vk::DescriptorBindingFlags, 2> bindingFlags{ flags, flags };
+
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+		bindingFlagsCreateInfo.setBindingFlags(bindingFlags);
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool);
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+		descriptorSetLayoutCreateInfo.setPNext(&bindingFlagsCreateInfo);
+
+		const std::array<vk::DescriptorPoolSize, 2> poolSizes{
+			vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, images_.capacity },
+			vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, buffers_.capacity }
+		};
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind);
+		descriptorPoolCreateInfo.setMaxSets(1);
+		descriptorPoolCreateInfo.setPoolSizes(poolSizes);
+
+		try {
+			tableLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			tablePool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*tablePool_);
+			descriptorSetAllocateInfo.setDescriptorSetCount(1);
+			descriptorSetAllocateInfo.setPSetLayouts(&*tableLayout_);
+			table_ = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo).front();
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create bindless table. error {}", err.what());
+			throw;
+		}
+
+		Log_info("bindless table of {} images and {} buffers", images_.capacity, buffers_.capacity);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace fve {
+
+	class Device;
+
+	// descriptors that are not owned by a single pass. not thread safe, everything is called from the
+	// thread recording the primary command buffer, bind() excepted.
+	//
+	// frame pools: every slot has pools of its own for sets that live for one frame. they are reset
+	// in bulk once the previous frame of the slot is done, so transient sets are never freed one by one.
+	//
+	// bindless table: one set holding every registered sampled image and storage buffer, bound once
+	// per command buffer. shaders index its arrays with handles passed in push constants, so adding a
+	// resource writes a single descriptor and draws switch resources without binding anything. the
+	// table needs descriptor indexing with update-after-bind, without it bindless() is false and the
+	// table layout is an empty placeholder
+	class Descriptors final {
+	public:
+		// set of the table in the pipeline layouts of the engine
+		static constexpr uint32_t TABLE_SET = 5;
+		static constexpr uint32_t IMAGE_BINDING = 0;
+		static constexpr uint32_t BUFFER_BINDING = 1;
+		// upper bounds of the table arrays, lowered to the limits of the device
+		static constexpr uint32_t MAX_IMAGES = 4096;
+		static constexpr uint32_t MAX_BUFFERS = 1024;
+		static constexpr uint32_t INVALID = ~0u;
+
+		explicit Descriptors(Device& device, uint32_t slotCount);
+
+		~Descriptors() noexcept;
+
+		Descriptors(const Descriptors&) = delete;
+		Descriptors& operator=(const Descriptors&) = delete;
+
+		inline bool bindless() const noexcept { return static_cast<bool>(table_); }
+		inline vk::DescriptorSetLayout tableLayout() const noexcept { return *tableLayout_; }
+
+		// resets the pools of the slot and recycles the handles removed a full round of slots ago.
+		// the previous frame of the slot has to be done
+		void beginFrame(uint32_t slot);
+		// valid until the next beginFrame() of the slot
+		vk::DescriptorSet allocate(uint32_t slot, vk::DescriptorSetLayout layout);
+
+		// handles stay valid until they are removed, INVALID when the table is full or missing.
+		// the resources have to outlive every frame that may read them
+		uint32_t addImage(vk::ImageView view, vk::Sampler sampler, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+		uint32_t addBuffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+		// removed handles are reused once no frame in flight can read them anymore
+		void removeImage(uint32_t handle);
+		void removeBuffer(uint32_t handle);
+
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, uint32_t set = TABLE_SET) const;
+
+	private:
+		// handles of one array of the table
+		struct Handles {
+			uint32_t capacity = 0;
+			uint32_t next = 0;
+			std::vector<uint32_t> free;
+			// handle and the frame it was removed in
+			std::vector<std::pair<uint32_t, uint64_t>> retired;
+		};
+
+		uint32_t acquire(Handles& handles) noexcept;
+		void retire(Handles& handles, uint32_t handle);
+		void recycle(Handles& handles) noexcept;
+		vk::UniqueDescriptorPool createPool() const;
+		void createTable();
+
+		Device& device_;
+		uint32_t slotCount_;
+		uint64_t frame_ = 0;
+		// pools of every slot, a frame running out of sets continues in the next one
+		std::vector<std::vector<vk::UniqueDescriptorPool>> pools_;
+		std::vector<size_t> currentPools_;
+		vk::UniqueDescriptorSetLayout tableLayout_;
+		vk::UniqueDescriptorPool tablePool_;
+		vk::DescriptorSet table_;
+		Handles images_;
+		Handles buffers_;
+	};
+
+}
\ No newline at end of file
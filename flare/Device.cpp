@@ -1,5 +1,8 @@
 #include "Device.hpp"
+#include "Trace.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -10,6 +13,9 @@
 
 PFN_vkCreateDebugUtilsMessengerEXT pfnVkCreateDebugUtilsMessengerEXT;
 PFN_vkDestroyDebugUtilsMessengerEXT pfnVkDestroyDebugUtilsMessengerEXT;
+PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
+PFN_vkGetCalibratedTimestampsEXT pfnVkGetCalibratedTimestampsEXT;
+PFN_vkCmdDrawIndexedIndirectCountKHR pfnVkCmdDrawIndexedIndirectCountKHR;
 
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateDebugUtilsMessengerEXT(VkInstance instance,
 															  const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -24,10 +30,40 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyDebugUtilsMessengerEXT(VkInstance instance,
 	return pfnVkDestroyDebugUtilsMessengerEXT(instance, messenger, pAllocator);
 }
 
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(VkPhysicalDevice physicalDevice,
+																			  uint32_t* pTimeDomainCount,
+																			  VkTimeDomainEXT* pTimeDomains) {
+	return pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, pTimeDomainCount, pTimeDomains);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetCalibratedTimestampsEXT(VkDevice device,
+															uint32_t timestampCount,
+															const VkCalibratedTimestampInfoEXT* pTimestampInfos,
+															uint64_t* pTimestamps,
+															uint64_t* pMaxDeviation) {
+	return pfnVkGetCalibratedTimestampsEXT(device, timestampCount, pTimestampInfos, pTimestamps, pMaxDeviation);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirectCountKHR(VkCommandBuffer commandBuffer,
+															VkBuffer buffer,
+															VkDeviceSize offset,
+															VkBuffer countBuffer,
+															VkDeviceSize countBufferOffset,
+															uint32_t maxDrawCount,
+															uint32_t stride) {
+	return pfnVkCmdDrawIndexedIndirectCountKHR(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+}
+
 namespace fve {
 
-	Device::Device(GLFWwindow* window) : window_{ window } {
-		createInstance();
+	Device::Device(GLFWwindow* window) : Device{ [window]() { return window; } } {
+	}
+
+	Device::Device(const std::function<GLFWwindow*()>& window) {
+		{
+			Trace_zone("create instance");
+			createInstance();
+		}
 
 		if (VALIDATION_LAYERS_ENABLED) {
 			pfnVkCreateDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(instance_->getProcAddr("vkCreateDebugUtilsMessengerEXT"));
@@ -55,8 +91,35 @@ namespace fve {
 			}
 		}
 
-		createDevice();
-		createCommandPool();
+		// everything up to here does not need the window
+		std::vector<vk::PhysicalDevice> candidates;
+		{
+			Trace_zone("enumerate physical devices");
+			const auto devices = instance_->enumeratePhysicalDevices();
+			if (devices.empty())
+				throw std::runtime_error{ "failed to pick physical device. there are devices with vulkan support" };
+			std::copy_if(devices.begin(), devices.end(), std::back_inserter(candidates), [this](vk::PhysicalDevice device) {
+				return checkDeviceExtensionSupport(device);
+			});
+		}
+
+		{
+			Trace_zone("wait for window");
+			window_ = window();
+		}
+
+		{
+			Trace_zone("pick physical device");
+			pickPhysicalDevice(candidates);
+		}
+
+		{
+			Trace_zone("create logical device");
+			createDevice();
+			createCommandPool();
+			loadExtensionFunctions();
+			memory_ = std::make_unique<MemoryBudget>(physical_, extensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+		}
 	}
 
 	Device::~Device() noexcept {
@@ -125,7 +188,8 @@ namespace fve {
 	std::pair<vk::Buffer, vk::DeviceMemory> Device::createBuffer(vk::DeviceSize instanceSize,
 																 vk::DeviceSize instanceCount,
 																 vk::BufferUsageFlags usageFlags,
-																 vk::MemoryPropertyFlags memoryPropertyFlags) const noexcept {
+																 vk::MemoryPropertyFlags memoryPropertyFlags,
+																 const char* tag) const noexcept {
 		vk::BufferCreateInfo bufferCreateInfo{};
 		bufferCreateInfo.size = instanceSize * instanceCount;
 		bufferCreateInfo.usage = usageFlags;
@@ -142,7 +206,7 @@ namespace fve {
 		}
 
 		const auto& memoryRequirements = logical_->getBufferMemoryRequirements(buffer.first);
-		const auto& memoryTypeIndex = findMemoryTypeIndex(memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		const auto& memoryTypeIndex = findMemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryPropertyFlags);
 
 		vk::MemoryAllocateInfo memoryAllocateInfo{};
 		memoryAllocateInfo.setAllocationSize(memoryRequirements.size);
@@ -152,7 +216,14 @@ namespace fve {
 			buffer.second = logical_->allocateMemory(memoryAllocateInfo);
 		}
 		catch (const vk::SystemError& err) {
-			Log_error("failed to allocate vulkan device memory. error {}", err.what());
+			Log_error("failed to allocate vulkan device memory for {}. error {}", tag, err.what());
+			logical_->destroyBuffer(buffer.first);
+			return {};
+		}
+
+		if (!memory_->add(buffer.second, tag, memoryRequirements.size, memoryTypeIndex)) {
+			logical_->freeMemory(buffer.second);
+			logical_->destroyBuffer(buffer.first);
 			return {};
 		}
 
@@ -161,15 +232,63 @@ namespace fve {
 		}
 		catch (const vk::SystemError& err) {
 			Log_error("failed to bind vulkan buffer memory. error {}", err.what());
+			logical_->destroyBuffer(buffer.first);
+			freeMemory(buffer.second);
 			return {};
 		}
 
 		return buffer;
 	}
 
-	bool Device::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
+	std::pair<vk::Image, vk::DeviceMemory> Device::createImage(const vk::ImageCreateInfo& imageCreateInfo,
+															   vk::MemoryPropertyFlags memoryPropertyFlags,
+															   const char* tag) const noexcept {
+		std::pair<vk::Image, vk::DeviceMemory> image;
+
+		try {
+			image.first = logical_->createImage(imageCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create vulkan image. error {}", err.what());
+			return {};
+		}
+
+		try {
+			const auto& memoryRequirements = logical_->getImageMemoryRequirements(image.first);
+
+			const auto memoryTypeIndex = findMemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryPropertyFlags);
+
+			vk::MemoryAllocateInfo memoryAllocateInfo{};
+			memoryAllocateInfo.setAllocationSize(memoryRequirements.size);
+			memoryAllocateInfo.setMemoryTypeIndex(memoryTypeIndex);
+
+			image.second = logical_->allocateMemory(memoryAllocateInfo);
+			if (!memory_->add(image.second, tag, memoryRequirements.size, memoryTypeIndex)) {
+				logical_->freeMemory(image.second);
+				logical_->destroyImage(image.first);
+				return {};
+			}
+			logical_->bindImageMemory(image.first, image.second, 0);
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to allocate vulkan image memory for {}. error {}", tag, ex.what());
+			logical_->destroyImage(image.first);
+			if (image.second)
+				freeMemory(image.second);
+			return {};
+		}
+
+		return image;
+	}
+
+	void Device::freeMemory(vk::DeviceMemory memory) const noexcept {
+		memory_->remove(memory);
+		logical_->freeMemory(memory);
+	}
+
+	bool Device::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size, vk::DeviceSize dstOffset) {
 		if (auto cmb = beginSingleTimeCommandBuffer()) {
-			std::array<vk::BufferCopy, 1> copyRegions{ vk::BufferCopy{0, 0, size} };
+			std::array<vk::BufferCopy, 1> copyRegions{ vk::BufferCopy{0, dstOffset, size} };
 			cmb.copyBuffer(srcBuffer, dstBuffer, copyRegions);
 			endSingleTimeCommandBuffer(cmb);
 			return true;
@@ -231,16 +350,16 @@ namespace fve {
 		}
 		switch (static_cast<vk::DebugUtilsMessageSeverityFlagBitsEXT>(messageSeverity)) {
 		case vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose:
-			Log_debug(message.str());
+			Log_debug("{}", message.str());
 			break;
 		case vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo:
-			Log_warn(message.str());
+			Log_warn("{}", message.str());
 			break;
 		case vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning:
-			Log_warn(message.str());
+			Log_warn("{}", message.str());
 			break;
 		case vk::DebugUtilsMessageSeverityFlagBitsEXT::eError:
-			Log_error(message.str());
+			Log_error("{}", message.str());
 			break;
 		}
 
@@ -279,21 +398,24 @@ namespace fve {
 			Log_error("failed to create vulkan instance. error {}", err.what());
 			throw;
 		}
+	}
+
+	void Device::pickPhysicalDevice(const std::vector<vk::PhysicalDevice>& candidates) {
+		if (!window_)
+			throw std::runtime_error{ "failed to create vulkan window surface. there is no window" };
 
 		VkSurfaceKHR surface;
 		if (glfwCreateWindowSurface(*instance_, window_, nullptr, &surface) != VK_SUCCESS)
 			throw std::runtime_error{ "failed to create vulkan window surface" };
 		surface_ = vk::UniqueSurfaceKHR{ surface, *instance_ };
 
-		auto isSuitable = [this](vk::PhysicalDevice device, vk::SurfaceKHR surface) {
+		// candidates already support the required extensions
+		auto isSuitable = [](vk::PhysicalDevice device, vk::SurfaceKHR surface) {
 			auto indices = QueueFamilyIndices::findQueueFamilyIndices(device, surface);
-			return indices.isCompleted() && checkDeviceExtensionSupport(device);
+			return indices.isCompleted();
 		};
 
-		const auto devices = instance_->enumeratePhysicalDevices();
-		if (devices.empty())
-			throw std::runtime_error{ "failed to pick physical device. there are devices with vulkan support" };
-		for (auto d : devices) {
+		for (auto d : candidates) {
 			if (isSuitable(d, *surface_)) {
 				physical_ = d;
 				const auto id = physical_.getProperties().deviceID;
@@ -328,9 +450,52 @@ namespace fve {
 			queueCreateInfos.back().setQueueCount(1);
 		}
 
+		std::vector<const char*> extensions = DEVICE_EXTENSIONS;
+		const auto& deviceExtensionProperties = physical_.enumerateDeviceExtensionProperties();
+		for (auto extension : OPTIONAL_DEVICE_EXTENSIONS) {
+			auto it = std::find_if(deviceExtensionProperties.begin(),
+								   deviceExtensionProperties.end(),
+								   [=](const vk::ExtensionProperties& properties) {
+									   return std::strcmp(extension, properties.extensionName) == 0;
+								   });
+			if (it != deviceExtensionProperties.end())
+				extensions.push_back(extension);
+			else
+				Log_info("optional device extension {} is not supported", extension);
+		}
+		enabledExtensions_ = std::set<std::string>(extensions.begin(), extensions.end());
+
+		// optional features, enabled when the physical device supports them
+		const auto supportedFeatures = physical_.getFeatures();
+		features_.setFragmentStoresAndAtomics(supportedFeatures.fragmentStoresAndAtomics);
+		features_.setMultiDrawIndirect(supportedFeatures.multiDrawIndirect);
+		features_.setDrawIndirectFirstInstance(supportedFeatures.drawIndirectFirstInstance);
+
+		vk::PhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+		if (extensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+			const auto chain = physical_.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeatures>();
+			const auto& supported = chain.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+			descriptorIndexing_ = supported.runtimeDescriptorArray &&
+								  supported.descriptorBindingPartiallyBound &&
+								  supported.descriptorBindingSampledImageUpdateAfterBind &&
+								  supported.descriptorBindingStorageBufferUpdateAfterBind;
+		}
+		if (descriptorIndexing_) {
+			descriptorIndexingFeatures.setRuntimeDescriptorArray(true);
+			descriptorIndexingFeatures.setDescriptorBindingPartiallyBound(true);
+			descriptorIndexingFeatures.setDescriptorBindingSampledImageUpdateAfterBind(true);
+			descriptorIndexingFeatures.setDescriptorBindingStorageBufferUpdateAfterBind(true);
+		}
+		else {
+			Log_info("descriptor indexing is not supported, there is no bindless table");
+		}
+
 		vk::DeviceCreateInfo deviceCreateInfo{};
 		deviceCreateInfo.setQueueCreateInfos(queueCreateInfos);
-		deviceCreateInfo.setPEnabledExtensionNames(DEVICE_EXTENSIONS);
+		deviceCreateInfo.setPEnabledExtensionNames(extensions);
+		deviceCreateInfo.setPEnabledFeatures(&features_);
+		if (descriptorIndexing_)
+			deviceCreateInfo.setPNext(&descriptorIndexingFeatures);
 		if (VALIDATION_LAYERS_ENABLED)
 			deviceCreateInfo.setPEnabledLayerNames(VALIDATION_LAYERS);
 
@@ -362,4 +527,23 @@ namespace fve {
 		}
 	}
 
+	void Device::loadExtensionFunctions() {
+		if (extensionEnabled(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+			pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(instance_->getProcAddr("vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+			pfnVkGetCalibratedTimestampsEXT = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(logical_->getProcAddr("vkGetCalibratedTimestampsEXT"));
+			if (!pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT || !pfnVkGetCalibratedTimestampsEXT) {
+				Log_warn("failed to get calibrated timestamps functions, disable {}", VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+				enabledExtensions_.erase(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+			}
+		}
+
+		if (extensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+			pfnVkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(logical_->getProcAddr("vkCmdDrawIndexedIndirectCountKHR"));
+			if (!pfnVkCmdDrawIndexedIndirectCountKHR) {
+				Log_warn("failed to get draw indirect count functions, disable {}", VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+				enabledExtensions_.erase(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			}
+		}
+	}
+
 }
\ No newline at end of file
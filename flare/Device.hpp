@@ -2,9 +2,14 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <functional>
+#include <memory>
 #include <optional>
+#include <set>
+#include <string>
 
 #include "Log.hpp"
+#include "MemoryBudget.hpp"
 
 struct GLFWwindow;
 
@@ -34,6 +39,9 @@ namespace fve {
 		};
 
 		explicit Device(GLFWwindow* window);
+		// the window is requested once the instance exists and the physical devices are enumerated,
+		// so it can be created on another thread meanwhile. the function may block until it is ready
+		explicit Device(const std::function<GLFWwindow*()>& window);
 
 		~Device() noexcept;
 
@@ -48,15 +56,31 @@ namespace fve {
 		inline vk::Queue presentQueue() const noexcept { return presentQueue_; }
 		inline vk::CommandPool commandPool() const noexcept { return *commandPool_; }
 
+		inline bool extensionEnabled(const std::string& extension) const noexcept { return enabledExtensions_.count(extension) != 0; }
+		inline const vk::PhysicalDeviceFeatures& features() const noexcept { return features_; }
+		// runtime sized, partially bound and update-after-bind descriptor arrays, see Descriptors
+		inline bool descriptorIndexing() const noexcept { return descriptorIndexing_; }
+		// every allocation of createBuffer and createImage is registered here under its tag
+		inline MemoryBudget& memory() noexcept { return *memory_; }
+
 		vk::CommandBuffer Device::beginSingleTimeCommandBuffer();
 		void Device::endSingleTimeCommandBuffer(vk::CommandBuffer commandBuffer);
 
+		// both are null on failure, nothing is left allocated or registered
 		std::pair<vk::Buffer, vk::DeviceMemory> createBuffer(vk::DeviceSize instanceSize,
 															 vk::DeviceSize instanceCount,
 															 vk::BufferUsageFlags usageFlags,
-															 vk::MemoryPropertyFlags memoryPropertyFlags) const noexcept;
+															 vk::MemoryPropertyFlags memoryPropertyFlags,
+															 const char* tag = "buffer") const noexcept;
+
+		// the image is bound to memory of its own, both are null on failure
+		std::pair<vk::Image, vk::DeviceMemory> createImage(const vk::ImageCreateInfo& imageCreateInfo,
+														   vk::MemoryPropertyFlags memoryPropertyFlags,
+														   const char* tag = "image") const noexcept;
+		// frees memory of createBuffer or createImage and removes it from the registry
+		void freeMemory(vk::DeviceMemory memory) const noexcept;
 
-		bool copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
+		bool copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size, vk::DeviceSize dstOffset = 0);
 
 	private:
 #ifdef _DEBUG
@@ -73,6 +97,14 @@ namespace fve {
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
 
+		// enabled when the physical device supports them, check with extensionEnabled()
+		const std::vector<const char*> OPTIONAL_DEVICE_EXTENSIONS = {
+			VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+			VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+			VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+			VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+		};
+
 		inline uint32_t Device::findMemoryTypeIndex(uint32_t typeFilter, vk::MemoryPropertyFlags memoryPropertyFlags) const {
 			vk::PhysicalDeviceMemoryProperties properties;
 			physical_.getMemoryProperties(&properties);
@@ -92,8 +124,10 @@ namespace fve {
 															void* pUserData);
 
 		void createInstance();
+		void pickPhysicalDevice(const std::vector<vk::PhysicalDevice>& candidates);
 		void createDevice();
 		void createCommandPool();
+		void loadExtensionFunctions();
 
 		GLFWwindow* window_ = nullptr;
 		vk::UniqueInstance instance_;
@@ -104,6 +138,10 @@ namespace fve {
 		vk::Queue graphicsQueue_;
 		vk::Queue presentQueue_;
 		vk::UniqueCommandPool commandPool_;
+		std::set<std::string> enabledExtensions_;
+		vk::PhysicalDeviceFeatures features_;
+		bool descriptorIndexing_ = false;
+		std::unique_ptr<MemoryBudget> memory_;
 	};
 
 }
\ No newline at end of file
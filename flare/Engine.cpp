@@ -4,11 +4,38 @@
 #include "Swapchain.hpp"
 #include "Pipeline.hpp"
 #include "Mesh.hpp"
+#include "GeometryArena.hpp"
+#include "MeshFile.hpp"
+#include "MeshConverter.hpp"
+#include "Buffer.hpp"
+#include "GpuTrace.hpp"
+#include "IterationBudget.hpp"
+#include "AdaptiveSampling.hpp"
+#include "IterationHistogram.hpp"
+#include "ConeMarcher.hpp"
+#include "FramePrologue.hpp"
+#include "Buddhabrot.hpp"
+#include "CommandRecorder.hpp"
+#include "Clock.hpp"
+#include "TextureStreamer.hpp"
+#include "Descriptors.hpp"
+#include "TileScheduler.hpp"
+#include "JuliaSweep.hpp"
+#include "TaskGraph.hpp"
+#include "JobSystem.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShaderBuilder.hpp"
+#include "Trace.hpp"
 #include "Log.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <fstream>
 #include <filesystem>
+#include <future>
+#include <limits>
 #include <stdexcept>
 
 #include <flare_config.h>
@@ -19,23 +46,50 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <shaderc/shaderc.hpp>
-
 namespace fve {
 
 	static Engine* engineInstance = nullptr;
 
+	// laid out like the std430 push constant block of the shaders
 	struct GlobalConstant {
-		alignas(16) glm::vec2 resolution;
-		alignas(16) float time;
+		glm::vec2 resolution;
+		float time;
+		float scale;
+		glm::vec2 center;
+		glm::vec2 previousCenter;
+		float previousScale;
+		uint32_t frame;
+		// 1 while the view is the one of the previous frame, whether or not its history is reprojected
+		uint32_t still;
+		// bindless table handles of iChannel0..3, pushed per batch
+		alignas(16) glm::uvec4 channels;
 	};
 
-	Engine::Engine(int /*argc*/, char** /*argv*/) {
+	// zoom factor per scroll wheel step
+	static constexpr float ZOOM_STEP = 0.9f;
+	// frames averaged per thread count in benchmark mode
+	static constexpr uint32_t BENCHMARK_FRAMES = 240;
+	// frames rendered after a change in on-demand mode. mandelbrot.frag refreshes every reprojected
+	// pixel within 64 frames and the iteration budget adapts over a few more
+	static constexpr uint32_t SETTLE_FRAMES = 72;
+	// seconds slept per wait while idle, so a close request is never missed
+	static constexpr double IDLE_TIMEOUT = 0.25;
+	// room of the geometry arena shared by every mesh
+	static constexpr uint32_t GEOMETRY_VERTICES = 1 << 20;
+	static constexpr uint32_t GEOMETRY_INDICES = 1 << 22;
+	static constexpr uint32_t GEOMETRY_COMMANDS = 1 << 16;
+	// shared glsl files of the shaders compiled at runtime, see ShaderBuilder
+	static constexpr const char* SHADER_INCLUDE_DIRECTORY = "shaders/include";
+
+	// true when the rectangles share pixels
+	static bool intersects(const vk::Rect2D& a, const vk::Rect2D& b) noexcept {
+		return a.offset.x < b.offset.x + static_cast<int32_t>(b.extent.width) && b.offset.x < a.offset.x + static_cast<int32_t>(a.extent.width) &&
+			   a.offset.y < b.offset.y + static_cast<int32_t>(b.extent.height) && b.offset.y < a.offset.y + static_cast<int32_t>(a.extent.height);
+	}
+
+	Engine::Engine(int argc, char** argv) : arguments_{ argv, argv + argc } {
 		if (engineInstance)
 			throw std::runtime_error{ "failed to initialize engine instance. engine instance already exists" };
 		engineInstance = this;
@@ -50,9 +104,40 @@ namespace fve {
 	}
 
 	int32_t Engine::run() noexcept {
+		// flare --convert <input> <output> [--float] writes a mesh file and exits
+		if (arguments_.size() >= 4 && arguments_.size() <= 5 && arguments_[1] == "--convert") {
+			const auto layout = arguments_.size() == 5 && arguments_[4] == "--float" ? layouts::Id::Position : layouts::Id::CompactPosition;
+			return MeshConverter::convert(arguments_[2], arguments_[3], layout) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		// flare --build-shaders <sources> <output> compiles every shader variant that is out of date
+		if (arguments_.size() == 4 && arguments_[1] == "--build-shaders") {
+			jobs_ = std::make_unique<JobSystem>();
+			return ShaderBuilder{ *jobs_, arguments_[2], arguments_[3] }.build() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		// flare --benchmark-jobs [threads] logs how a cpu mandelbrot scales over the threads of the job system
+		if (arguments_.size() >= 2 && arguments_.size() <= 3 && arguments_[1] == "--benchmark-jobs") {
+			try {
+				const auto threadCount = arguments_.size() == 3 ? static_cast<uint32_t>(std::stoul(arguments_[2])) : 0u;
+				return JobSystem::benchmark(threadCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+			}
+			catch (const std::exception& ex) {
+				Log_error("failed to parse thread count {}. error {}", arguments_[2], ex.what());
+				return EXIT_FAILURE;
+			}
+		}
+
 		if (!load())
 			return EXIT_FAILURE;
 
+		if (!settings.sweep.empty()) {
+			const bool swept = sweep();
+			if (!unload())
+				return EXIT_FAILURE;
+			if (Trace::enabled())
+				Trace::write(settings.trace);
+			return swept ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
 		try {
 			mainLoop();
 		}
@@ -71,6 +156,8 @@ namespace fve {
 
 		if (!unload())
 			return EXIT_FAILURE;
+		if (Trace::enabled())
+			Trace::write(settings.trace);
 		return EXIT_SUCCESS;
 	}
 
@@ -89,7 +176,7 @@ namespace fve {
 
 		try {
 			vk::ShaderModule shaderModule = device_->logical().createShaderModule(shaderModuleCreateInfo);
-			auto shader = std::shared_ptr<Shader>(new Shader{ *device_, shaderModule, shaderStage });
+			auto shader = std::shared_ptr<Shader>(new Shader{ *device_, shaderModule, shaderStage, shaderBinary });
 			shaders_.insert({ shaderName, shader });
 			return shader;
 		}
@@ -128,33 +215,17 @@ namespace fve {
 	}
 
 	std::vector<uint32_t> Engine::compileShaderSource(const std::string& shaderSource, const std::string& shaderName, vk::ShaderStageFlagBits shaderStage, bool optimize) {
-		shaderc_shader_kind kind;
-		switch (shaderStage) {
-		case vk::ShaderStageFlagBits::eVertex:
-			kind = shaderc_vertex_shader;
-			break;
-		case vk::ShaderStageFlagBits::eFragment:
-			kind = shaderc_fragment_shader;
-			break;
-		default:
-			Log_error("failed to compile shader source. unsupported shader stage {}", vk::to_string(shaderStage));
-			return {};
-		}
-
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions options;
+		ShaderCompiler::Options options{};
+		options.optimization = optimize ? ShaderCompiler::Optimization::Size : ShaderCompiler::Optimization::None;
+		options.includeDirectory = SHADER_INCLUDE_DIRECTORY;
 
-		if (optimize)
-			options.SetOptimizationLevel(shaderc_optimization_level_size);
-
-		shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(shaderSource, kind, shaderName.c_str(), options);
-
-		if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
-			Log_error("failed to compile shader source. error {}", module.GetErrorMessage());
+		const auto result = ShaderCompiler{}.compile(shaderSource, shaderName, shaderStage, options);
+		if (!result.error.empty()) {
+			Log_error("failed to compile shader source. error {}", result.error);
 			return {};
 		}
 
-		return { module.cbegin(), module.cend() };
+		return result.binary;
 	}
 
 	bool Engine::load() noexcept {
@@ -162,127 +233,184 @@ namespace fve {
 			Log_info("{} {} {}.{}.{}", flare_PROJECT, flare_REVISION, flare_VERSION_MAJOR, flare_VERSION_MINOR, flare_VERSION_PATCH);
 
 			const auto filepath = "flare.json";
-			if (!Settings::load(filepath, settings)) {
-				Log_warn("failed to load settings from file {}. skip to default", filepath);
+			// the file is only written when there is none, a file that fails to load is left as it is
+			if (!std::filesystem::exists(filepath)) {
+				Log_info("settings file {} does not exist. write the defaults", filepath);
 				Settings::save(filepath, settings);
 			}
+			else if (!Settings::load(filepath, settings)) {
+				Log_warn("failed to load settings from file {}. skip to default", filepath);
+			}
 
-			if (!glfwInit())
-				throw std::runtime_error{ "failed to initialize GLFW" };
+			if (!settings.trace.empty()) {
+				Trace::setThreadName("main");
+				Trace::enable(true);
+			}
 
-			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-			glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+			jobs_ = std::make_unique<JobSystem>(settings.jobThreads);
+			Log_info("job system runs on {} threads", jobs_->threadCount());
 
-			std::stringstream ss;
-			ss << flare_PROJECT << " "
-				<< flare_VERSION_MAJOR << "."
-				<< flare_VERSION_MINOR << "."
-				<< flare_VERSION_PATCH << " "
-				<< flare_REVISION;
+			clock_ = std::make_unique<Clock>(Clock::parse(settings.clock), settings.timeStep);
+			if (clock_->replaying()) {
+				if (!clock_->open(settings.capture))
+					return false;
+			}
+			else if (!settings.capture.empty()) {
+				clock_->capture(settings.capture);
+			}
 
-			window_ = glfwCreateWindow(settings.width, settings.height, ss.str().c_str(), nullptr, nullptr);
+			Trace_zone("load");
 
-			if (!window_)
-				throw std::runtime_error{ "failed to create GLFW window" };
+			// startup runs as a dependency graph. glfw keeps its windows on the main thread while the
+			// vulkan instance, shaderc and the shader files are brought up on workers. the graphics
+			// queue and the device command pool are not thread safe, so their users form a chain
+			TaskGraph startup{ "startup", *jobs_ };
 
-			GLFWimage icons[1];
-			icons[0].pixels = stbi_load("icons/flare.png", &icons[0].width, &icons[0].height, 0, STBI_default);
-			glfwSetWindowIcon(window_, 1, icons);
-			stbi_image_free(icons[0].pixels);
+			std::promise<GLFWwindow*> windowPromise;
+			auto windowFuture = windowPromise.get_future().share();
+			vk::Extent2D framebufferExtent{};
 
-			device_ = std::make_unique<Device>(window_);
+			const auto glfw = startup.addMain("glfw init", []() {
+				if (!glfwInit())
+					throw std::runtime_error{ "failed to initialize GLFW" };
+			});
 
-			auto readFile = [](const std::filesystem::path& filepath, std::vector<uint32_t>& buffer) {
-				std::ifstream file{ filepath, std::ios::in | std::ios::binary };
-				if (!file.is_open())
-					return false;
+			const auto window = startup.addMain("create window", [&]() {
 				try {
-					file.seekg(0, std::ios::end);
-					const size_t size = static_cast<size_t>(file.tellg());
-					file.seekg(0, std::ios::beg);
-					buffer.resize(size / 4, 0);
-					file.read(reinterpret_cast<char*>(buffer.data()), size);
-					return true;
-				}
-				catch (const std::exception& ex) {
-					Log_error("failed to read from the file {}. error {}", filepath.string(), ex.what());
+					glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+					glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+					glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+
+					std::stringstream ss;
+					ss << flare_PROJECT << " "
+						<< flare_VERSION_MAJOR << "."
+						<< flare_VERSION_MINOR << "."
+						<< flare_VERSION_PATCH << " "
+						<< flare_REVISION;
+
+					window_ = glfwCreateWindow(settings.width, settings.height, ss.str().c_str(), nullptr, nullptr);
+
+					if (!window_)
+						throw std::runtime_error{ "failed to create GLFW window" };
+
+					glfwSetKeyCallback(window_, [](GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/) {
+						if (auto engine = Engine::get())
+							engine->onKey(key, action);
+					});
+					glfwSetScrollCallback(window_, [](GLFWwindow* /*window*/, double /*xoffset*/, double yoffset) {
+						if (auto engine = Engine::get())
+							engine->onScroll(yoffset);
+					});
+					glfwSetWindowRefreshCallback(window_, [](GLFWwindow* /*window*/) {
+						if (auto engine = Engine::get())
+							engine->onRefresh();
+					});
+
+					int w, h;
+					glfwGetFramebufferSize(window_, &w, &h);
+					framebufferExtent = vk::Extent2D{ static_cast<uint32_t>(w), static_cast<uint32_t>(h) };
 				}
 				catch (...) {
-					Log_error("failed to read from the file {}. unknown error.", filepath.string());
+					// the device creation waits on the window
+					windowPromise.set_exception(std::current_exception());
+					throw;
 				}
-				return false;
+				windowPromise.set_value(window_);
+			}, { glfw });
+
+			GLFWimage icon{};
+			const auto loadIcon = startup.add("load icon", [&]() {
+				icon.pixels = stbi_load("icons/flare.png", &icon.width, &icon.height, 0, STBI_default);
+			});
+
+			startup.addMain("set icon", [&]() {
+				if (icon.pixels)
+					glfwSetWindowIcon(window_, 1, &icon);
+				stbi_image_free(icon.pixels);
+			}, { window, loadIcon });
+
+			// the instance and the physical devices are enumerated before the window is needed
+			const auto device = startup.add("create device", [&]() {
+				device_ = std::make_unique<Device>([&]() { return windowFuture.get(); });
+				device_->memory().setLimit(static_cast<vk::DeviceSize>(settings.memoryLimit) << 20);
+			}, { glfw });
+
+			struct ShaderBinary {
+				std::string name;
+				std::vector<uint32_t> binary;
+				vk::ShaderStageFlagBits stage;
 			};
-
-			for (const auto& entry : std::filesystem::directory_iterator("shaders")) {
-				// trying to find previous file extension to determine shader stage
-				bool supported = false;
-
-				auto origin = entry.path().filename().stem();
-				vk::ShaderStageFlagBits shaderStage{};
-				if (origin.extension() == ".vert")
-					shaderStage = vk::ShaderStageFlagBits::eVertex; supported = true;
-				if (origin.extension() == ".frag")
-					shaderStage = vk::ShaderStageFlagBits::eFragment; supported = true;
-				if (!supported)
-					continue;
-				std::vector<uint32_t> shaderBinary{};
-				if (readFile(entry.path(), shaderBinary) && !shaderBinary.empty()) {
-					if (!createShaderFromBinary(origin.string(), shaderBinary, shaderStage))
-						Log_error("failed to load shader {} from binary file", origin.string());
+			std::vector<ShaderBinary> shaderBinaries;
+
+			const auto readShaders = startup.add("read shaders", [&]() {
+				auto readFile = [](const std::filesystem::path& filepath, std::vector<uint32_t>& buffer) {
+					std::ifstream file{ filepath, std::ios::in | std::ios::binary };
+					if (!file.is_open())
+						return false;
+					try {
+						file.seekg(0, std::ios::end);
+						const size_t size = static_cast<size_t>(file.tellg());
+						file.seekg(0, std::ios::beg);
+						buffer.resize(size / 4, 0);
+						file.read(reinterpret_cast<char*>(buffer.data()), size);
+						return true;
+					}
+					catch (const std::exception& ex) {
+						Log_error("failed to read from the file {}. error {}", filepath.string(), ex.what());
+					}
+					catch (...) {
+						Log_error("failed to read from the file {}. unknown error.", filepath.string());
+					}
+					return false;
+				};
+
+				for (const auto& entry : std::filesystem::directory_iterator("shaders")) {
+					// trying to find previous file extension to determine shader stage
+					auto origin = entry.path().filename().stem();
+					vk::ShaderStageFlagBits shaderStage{};
+					if (origin.extension() == ".vert")
+						shaderStage = vk::ShaderStageFlagBits::eVertex;
+					else if (origin.extension() == ".frag")
+						shaderStage = vk::ShaderStageFlagBits::eFragment;
+					else if (origin.extension() == ".comp")
+						shaderStage = vk::ShaderStageFlagBits::eCompute;
+					else
+						continue;
+					std::vector<uint32_t> shaderBinary{};
+					if (readFile(entry.path(), shaderBinary) && !shaderBinary.empty())
+						shaderBinaries.push_back({ origin.string(), std::move(shaderBinary), shaderStage });
 				}
-			}
-
-			const float side = 1.0f;
-
-			std::vector<Mesh::Vertex> vertices = {
-				{{-side, side, 0.0f}},
-				{{side, side, 0.0f}},
-				{{side, -side, 0.0f}},
-				{{-side, -side, 0.0f}},
-			};
+			});
 
-			std::vector<Mesh::Index> indices = {
-				0, 1, 2, 2, 3, 0
-			};
-
-			canvas_ = std::make_unique<Mesh>(*device_, vertices, indices);
-
-			vk::PushConstantRange pushConstantRange{};
-			pushConstantRange.setOffset(0);
-			pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eFragment);
-			pushConstantRange.setSize(sizeof(GlobalConstant));
+			ShaderBinary canvasBinary{ "canvas.vert", {}, vk::ShaderStageFlagBits::eVertex };
+			ShaderBinary defaultBinary{ "default.frag", {}, vk::ShaderStageFlagBits::eFragment };
 
-			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-			pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
-
-			try {
-				pipelineLayout_ = device_->logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
-			}
-			catch (const vk::SystemError& err) {
-				Log_error("failed to create vulkan pipeline layout. error {}", err.what());
-				return false;
-			}
-
-			int w, h;
-			glfwGetFramebufferSize(window_, &w, &h);
-			swapchain_ = std::make_unique<Swapchain>(*device_, vk::Extent2D{ static_cast<uint32_t>(w), static_cast<uint32_t>(h) });
-
-			const auto& canvasSource = R"glsl(
-				#version 450
-				#extension GL_ARB_separate_shader_objects : enable
-				
-				layout(location = 0) in vec3 inPos;
-				
-				void main() {
-				    gl_Position = vec4(inPos, 1.0);
-				}
-			)glsl";
-
-			auto vert = createShaderFromSource("canvas.vert", canvasSource, vk::ShaderStageFlagBits::eVertex);
+			const auto compileShaders = startup.add("compile shaders", [&]() {
+				const auto& canvasSource = R"glsl(
+					#version 450
+					#extension GL_ARB_separate_shader_objects : enable
+					
+					layout(location = 0) in vec3 inPos;
+					layout(location = 1) in vec4 inRect;
+					layout(location = 2) in vec4 inCell;
+					layout(location = 3) in vec4 inParameters;
+					layout(location = 4) in vec4 inScale;
+					layout(location = 5) in vec4 inOffset;
+
+					layout(location = 0) out flat vec4 cell;
+					layout(location = 1) out flat vec4 parameters;
+					// indexes the records of the frame prologues
+					layout(location = 2) out flat uint instance;
+					
+					void main() {
+					    vec3 pos = inPos * inScale.xyz + inOffset.xyz;
+					    gl_Position = vec4(mix(inRect.xy, inRect.zw, pos.xy * 0.5 + 0.5), pos.z, 1.0);
+					    cell = inCell;
+					    parameters = inParameters;
+					    instance = gl_InstanceIndex;
+					}
+				)glsl";
 
-			auto frag = getShader(settings.shader);
-			if (!frag) {
 				const auto& defaultSource = R"glsl(
 					#version 450
 					#extension GL_ARB_separate_shader_objects : enable
@@ -301,33 +429,370 @@ namespace fve {
 					}
 				)glsl";
 
-				frag = createShaderFromSource("default.frag", defaultSource, vk::ShaderStageFlagBits::eFragment);
-			}
+				canvasBinary.binary = compileShaderSource(canvasSource, canvasBinary.name, canvasBinary.stage);
+				defaultBinary.binary = compileShaderSource(defaultSource, defaultBinary.name, defaultBinary.stage);
+			});
 
-			Pipeline::Settings pipelineSettings{};
-			Pipeline::defaultPipelineSettings(pipelineSettings);
-			pipelineSettings.pipelineLayout = *pipelineLayout_;
-			pipelineSettings.renderPass = swapchain_->renderPass();
-			pipelineSettings.bindingDescriptions = Mesh::Vertex::bindingDescriptions();
-			pipelineSettings.attributeDescriptions = Mesh::Vertex::attributeDescriptions();
+			const auto createShaders = startup.add("create shaders", [&]() {
+				shaderBinaries.push_back(std::move(canvasBinary));
+				shaderBinaries.push_back(std::move(defaultBinary));
+				for (const auto& shader : shaderBinaries) {
+					if (shader.binary.empty() || !createShaderFromBinary(shader.name, shader.binary, shader.stage))
+						Log_error("failed to load shader {} from binary file", shader.name);
+				}
+			}, { device, readShaders, compileShaders });
+
+			const auto uploadCanvas = startup.add("upload geometry", [&]() {
+				const float side = 1.0f;
+
+				std::vector<Mesh::Vertex> vertices = {
+					{{-side, side, 0.0f}},
+					{{side, side, 0.0f}},
+					{{side, -side, 0.0f}},
+					{{-side, -side, 0.0f}},
+				};
+
+				std::vector<Mesh::Index> indices = {
+					0, 1, 2, 2, 3, 0
+				};
+
+				geometry_ = std::make_unique<GeometryArena>(*device_, GEOMETRY_VERTICES, GEOMETRY_INDICES, GEOMETRY_COMMANDS);
+				canvas_ = geometry_->upload(vertices, indices);
+			}, { device });
+
+			const auto createSwapchain = startup.add("create swapchain", [&]() {
+				swapchain_ = std::make_unique<Swapchain>(*device_, framebufferExtent);
+			}, { device, window });
+
+			// after the canvas upload, the iteration budget clears its buffers on the queue
+			// the mesh files of the effects are mapped and streamed into the arena, they keep the queue busy in between
+			const auto loadMeshes = startup.add("load meshes", [&]() {
+				std::vector<std::string> filepaths;
+				if (settings.gallery.empty())
+					filepaths.push_back(settings.mesh);
+				for (const auto& effect : settings.gallery)
+					filepaths.push_back(effect.mesh);
+
+				for (const auto& filepath : filepaths) {
+					if (filepath.empty() || meshes_.count(filepath))
+						continue;
+
+					const auto begin = Trace::now();
+					try {
+						MeshFile file{ filepath };
+						meshes_.emplace(filepath, geometry_->upload(file.layout(), file.vertices(), file.vertexCount(), file.indexType(), file.indices(), file.indexCount(), file.bounds()));
+
+						const auto seconds = static_cast<double>(Trace::now() - begin) / 1e9;
+						Log_info("loaded mesh {} with {} vertices and {} triangles in {:.2f} ms, {:.1f} MB/s",
+								 filepath,
+								 file.vertexCount(),
+								 file.indexCount() / 3,
+								 seconds * 1e3,
+								 static_cast<double>(file.size()) / seconds / 1e6);
+					}
+					catch (const std::exception& ex) {
+						Log_error("failed to load mesh {}. the whole cell is drawn. error {}", filepath, ex.what());
+					}
+				}
+			}, { uploadCanvas });
+
+			const auto computePasses = startup.add("create compute passes", [&]() {
+				iterationBudget_ = std::make_unique<IterationBudget>(*device_, getShader("iteration_budget.comp"), swapchain_->extent());
+				iterationBudget_->enable(settings.adaptive);
+
+				supersampling_ = std::make_unique<AdaptiveSampling>(*device_,
+																	getShader("supersample_classify.comp"),
+																	getShader("supersample.comp"),
+																	*iterationBudget_,
+																	swapchain_->extent(),
+																	settings.supersampling,
+																	settings.edgeThreshold);
+
+				histogram_ = std::make_unique<IterationHistogram>(*device_,
+																  getShader("histogram.comp"),
+																  getShader("histogram+SUBGROUPS.comp"),
+																  getShader("histogram_scan.comp"),
+																  *iterationBudget_,
+																  swapchain_->extent(),
+																  settings.equalize);
+
+				coneMarcher_ = std::make_unique<ConeMarcher>(*device_,
+															 getShader("mandelbulb.cone.comp"),
+															 swapchain_->extent(),
+															 swapchain_->size(),
+															 settings.coneSteps,
+															 settings.coneMarching);
+
+				buddhabrot_ = std::make_unique<Buddhabrot>(*device_, getShader("buddhabrot.comp"), swapchain_->extent(), settings.samples);
+
+				prologues_ = std::make_unique<FramePrologue>(*device_, swapchain_->size());
+
+				descriptors_ = std::make_unique<Descriptors>(*device_, swapchain_->size());
+				textures_ = std::make_unique<TextureStreamer>(*device_, *jobs_, *descriptors_, swapchain_->size(), static_cast<vk::DeviceSize>(settings.textureBudget) << 20);
+				// reproducible clocks make textures resident at the same frame in every run
+				textures_->setBlocking(clock_->source() != Clock::Source::Wall || !settings.capture.empty());
+
+				if (settings.sliceBudget > 0.0f) {
+					if (swapchain_->imageUsage() & vk::ImageUsageFlagBits::eTransferDst)
+						tiles_ = std::make_unique<TileScheduler>(*device_, *swapchain_, settings.sliceTileSize, settings.sliceBudget);
+					else
+						Log_warn("swapchain images can not be copied into, time slicing is disabled");
+				}
+			}, { createShaders, createSwapchain, loadMeshes });
+
+			const auto pipelineLayout = startup.add("create pipeline layout", [&]() {
+				vk::PushConstantRange pushConstantRange{};
+				pushConstantRange.setOffset(0);
+				pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+				pushConstantRange.setSize(sizeof(GlobalConstant));
+
+				// set 0 iteration budget, set 1 buddhabrot, set 2 channel textures, set 3 supersampled shades,
+				// set 4 frame prologue records, set 5 bindless table, set 6 escape count distribution,
+				// set 7 cone depths
+				const std::array<vk::DescriptorSetLayout, 8> descriptorSetLayouts{ iterationBudget_->descriptorSetLayout(),
+																					buddhabrot_->descriptorSetLayout(),
+																					textures_->descriptorSetLayout(),
+																					supersampling_->descriptorSetLayout(),
+																					prologues_->descriptorSetLayout(),
+																					descriptors_->tableLayout(),
+																					histogram_->descriptorSetLayout(),
+																					coneMarcher_->descriptorSetLayout() };
+
+				vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+				pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+				pipelineLayoutCreateInfo.setSetLayouts(descriptorSetLayouts);
 
-			pipeline_ = std::make_unique<Pipeline>(*device_, std::vector<std::shared_ptr<Shader>>{vert, frag}, pipelineSettings);
+				try {
+					pipelineLayout_ = device_->logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+				}
+				catch (const vk::SystemError& err) {
+					Log_error("failed to create vulkan pipeline layout. error {}", err.what());
+					throw;
+				}
+			}, { computePasses });
+
+			// cells are laid out row by row and grouped by fragment shader and channels, every group becomes a batch
+			struct Group {
+				std::shared_ptr<Shader> frag;
+				// x.prologue.comp of x.frag, if there is one
+				std::shared_ptr<Shader> prologue;
+				TextureStreamer::Channels channels;
+				// mesh file drawn instead of the canvas, empty for the canvas
+				std::string mesh;
+				std::vector<Mesh::Instance> instances;
+			};
+			std::vector<Group> groups;
+
+			const auto layoutEffects = startup.add("layout effects", [&]() {
+				auto effects = settings.gallery;
+				if (effects.empty())
+					effects.push_back({ settings.shader, {}, settings.channels, settings.mesh });
+
+				const auto extent = swapchain_->extent();
+				const auto count = static_cast<uint32_t>(effects.size());
+				const auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+				const auto rows = (count + columns - 1) / columns;
+
+				for (uint32_t i = 0; i < count; ++i) {
+					const auto& effect = effects[i];
+
+					auto frag = getShader(effect.shader);
+					if (!frag) {
+						if (!effect.shader.empty())
+							Log_warn("shader {} is not loaded. skip to default", effect.shader);
+						frag = getShader("default.frag");
+					}
+					// effects with a BINDLESS variant read their channels from the bindless table
+					const std::filesystem::path shaderPath{ effect.shader };
+					if (device_->descriptorIndexing()) {
+						if (auto bindless = getShader(shaderPath.stem().string() + "+BINDLESS" + shaderPath.extension().string()))
+							frag = bindless;
+					}
 
-			commandBuffers_.resize(swapchain_->size());
+					const auto column = i % columns;
+					const auto row = i / columns;
+					const glm::vec2 size{ static_cast<float>(extent.width), static_cast<float>(extent.height) };
+					const glm::vec2 topLeft{ static_cast<float>(extent.width * column / columns), static_cast<float>(extent.height * row / rows) };
+					const glm::vec2 bottomRight{ static_cast<float>(extent.width * (column + 1) / columns), static_cast<float>(extent.height * (row + 1) / rows) };
+
+					Mesh::Instance instance{};
+					instance.rect = glm::vec4{ 2.0f * topLeft / size - 1.0f, 2.0f * bottomRight / size - 1.0f };
+					instance.cell = glm::vec4{ topLeft, bottomRight - topLeft };
+					for (size_t j = 0; j < std::min<size_t>(effect.parameters.size(), 4); ++j)
+						instance.parameters[static_cast<glm::length_t>(j)] = effect.parameters[j];
+
+					TextureStreamer::Channels channels{};
+					if (effect.channels.size() > TextureStreamer::CHANNEL_COUNT)
+						Log_warn("effect {} has {} channels, only the first {} are bound", effect.shader, effect.channels.size(), TextureStreamer::CHANNEL_COUNT);
+					for (size_t j = 0; j < std::min<size_t>(effect.channels.size(), TextureStreamer::CHANNEL_COUNT); ++j)
+						channels[j] = effect.channels[j];
+
+					auto group = std::find_if(groups.begin(), groups.end(), [&](const auto& g) { return g.frag == frag && g.channels == channels && g.mesh == effect.mesh; });
+					if (group == groups.end()) {
+						const auto prologue = getShader(shaderPath.stem().string() + ".prologue.comp");
+						group = groups.insert(groups.end(), Group{ frag, prologue, channels, effect.mesh, {} });
+					}
+					group->instances.push_back(instance);
+				}
+			}, { createShaders, createSwapchain });
+
+			const auto createPipelines = startup.add("create pipelines", [&]() {
+				// the histogram is only accumulated while an effect resolves it
+				const auto buddhabrotShader = getShader("buddhabrot.frag");
+				buddhabrot_->enable(std::any_of(groups.begin(), groups.end(), [&](const auto& group) { return group.frag == buddhabrotShader; }));
+
+				// only the cells of mandelbrot.frag are classified and supersampled
+				const auto mandelbrotShader = getShader("mandelbrot.frag");
+				std::vector<glm::vec4> mandelbrotCells;
+				for (const auto& group : groups) {
+					if (group.frag != mandelbrotShader)
+						continue;
+					for (const auto& instance : group.instances)
+						mandelbrotCells.push_back(instance.cell);
+				}
+				supersampling_->setCells(mandelbrotCells);
+				histogram_->setCells(mandelbrotCells);
+
+				// only the cells of mandelbulb.frag are cone marched
+				const auto mandelbulbShader = getShader("mandelbulb.frag");
+				std::vector<glm::vec4> mandelbulbCells;
+				for (const auto& group : groups) {
+					if (group.frag != mandelbulbShader)
+						continue;
+					for (const auto& instance : group.instances)
+						mandelbulbCells.push_back(instance.cell);
+				}
+				coneMarcher_->setCells(mandelbulbCells);
+
+				Pipeline::Settings pipelineSettings{};
+				Pipeline::defaultPipelineSettings(pipelineSettings);
+				pipelineSettings.pipelineLayout = *pipelineLayout_;
+				pipelineSettings.renderPass = swapchain_->renderPass();
+				pipelineSettings.bindingDescriptions = Mesh::Vertex::bindingDescriptions();
+				pipelineSettings.attributeDescriptions = Mesh::Vertex::attributeDescriptions();
+				for (const auto& description : Mesh::Instance::bindingDescriptions())
+					pipelineSettings.bindingDescriptions.push_back(description);
+				for (const auto& description : Mesh::Instance::attributeDescriptions(layouts::Position::attributeCount))
+					pipelineSettings.attributeDescriptions.push_back(description);
+
+				Pipeline::Specialization specialization{};
+				for (size_t i = 0; i < settings.constants.size(); ++i)
+					specialization.set(static_cast<uint32_t>(i), settings.constants[i]);
+				quality_ = settings.constants.empty() ? 0 : settings.constants[0];
+
+				// groups with a mesh fetch its positions in the layout of the mesh, the stride skips the
+				// other attributes. the instances dequantize the positions and fit them into the cells
+				std::vector<GeometryArena::Id> geometries(groups.size(), canvas_);
+				std::vector<Pipeline::Settings> groupSettings(groups.size(), pipelineSettings);
+				for (size_t i = 0; i < groups.size(); ++i) {
+					const auto mesh = meshes_.find(groups[i].mesh);
+					if (mesh == meshes_.end())
+						continue;
+
+					const auto& range = geometry_->range(mesh->second);
+					geometries[i] = mesh->second;
+					groupSettings[i].bindingDescriptions[0].setStride(layouts::stride(range.layout));
+					groupSettings[i].attributeDescriptions[0] = layouts::positionDescription(range.layout);
+					for (auto& instance : groups[i].instances)
+						geometry_->place(mesh->second, instance);
+				}
 
-			vk::CommandBufferAllocateInfo commandBufferAllocateInfo{};
-			commandBufferAllocateInfo.setCommandPool(device_->commandPool());
-			commandBufferAllocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
-			commandBufferAllocateInfo.setCommandBufferCount(static_cast<uint32_t>(commandBuffers_.size()));
+				// every batch compiles its pipeline in a job of its own
+				const auto vert = getShader("canvas.vert");
+				std::vector<std::unique_ptr<Pipeline>> pipelines(groups.size());
+				JobSystem::Counter created;
+				for (size_t i = 0; i < groups.size(); ++i) {
+					const auto frag = groups[i].frag;
+					jobs_->run(created, [&, i, frag]() {
+						Trace_zone("create pipeline");
+						pipelines[i] = std::make_unique<Pipeline>(*device_, *jobs_, std::vector<std::shared_ptr<Shader>>{vert, frag}, groupSettings[i], specialization);
+					});
+				}
+				jobs_->wait(created);
+
+				std::vector<Mesh::Instance> instances;
+				for (size_t i = 0; i < groups.size(); ++i) {
+					const auto& groupInstances = groups[i].instances;
+					Batch batch{};
+					batch.pipeline = std::move(pipelines[i]);
+					batch.firstInstance = static_cast<uint32_t>(instances.size());
+					batch.instanceCount = static_cast<uint32_t>(groupInstances.size());
+					glm::vec2 lower{ std::numeric_limits<float>::max() };
+					glm::vec2 upper{ 0.0f };
+					for (const auto& instance : groupInstances) {
+						lower = glm::min(lower, glm::vec2{ instance.cell });
+						upper = glm::max(upper, glm::vec2{ instance.cell } + glm::vec2{ instance.cell.z, instance.cell.w });
+					}
+					lower = glm::floor(lower);
+					upper = glm::ceil(upper);
+					batch.area.setOffset({ static_cast<int32_t>(lower.x), static_cast<int32_t>(lower.y) });
+					batch.area.setExtent({ static_cast<uint32_t>(upper.x - lower.x), static_cast<uint32_t>(upper.y - lower.y) });
+					batch.draws = geometry_->createList(1, geometry_->range(geometries[i]).indexType);
+					geometry_->write(batch.draws, { geometry_->command(geometries[i], batch.instanceCount, batch.firstInstance) });
+					batch.channels = textures_->addChannels(groups[i].channels);
+					prologues_->add(groups[i].prologue, batch.firstInstance, batch.instanceCount);
+					batches_.push_back(std::move(batch));
+					instances.insert(instances.end(), groupInstances.begin(), groupInstances.end());
+				}
 
-			try {
-				commandBuffers_ = device_->logical().allocateCommandBuffers(commandBufferAllocateInfo);
-			}
-			catch (const vk::SystemError& err) {
-				Log_error("failed to allocate vulkan command buffers. error {}", err.what());
-				return false;
+				instances_ = std::make_unique<Buffer>(*device_,
+													  sizeof(Mesh::Instance),
+													  instances.size(),
+													  vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+													  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+													  "instances");
+				instances_->write(instances);
+				prologues_->createDescriptors(instances_->buffer(), static_cast<uint32_t>(instances.size()));
+
+				Log_info("{} effects drawn with {} pipelines", instances.size(), batches_.size());
+
+				// effects that do not read the time only change with the view
+				animated_ = std::any_of(groups.begin(), groups.end(), [](const auto& group) {
+					return group.frag->readsPushConstant(offsetof(GlobalConstant, time)) ||
+						   (group.prologue && group.prologue->readsPushConstant(offsetof(FramePrologue::Constants, time)));
+				});
+				if (settings.onDemand)
+					Log_info("on-demand rendering, {}", animated_ ? "effects are animated" : "effects only change with the view");
+			}, { pipelineLayout, layoutEffects, loadMeshes });
+
+			// the last user of the device command pool
+			const auto commandBuffers = startup.add("allocate command buffers", [&]() {
+				commandBuffers_.resize(swapchain_->size());
+
+				vk::CommandBufferAllocateInfo commandBufferAllocateInfo{};
+				commandBufferAllocateInfo.setCommandPool(device_->commandPool());
+				commandBufferAllocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+				commandBufferAllocateInfo.setCommandBufferCount(static_cast<uint32_t>(commandBuffers_.size()));
+
+				try {
+					commandBuffers_ = device_->logical().allocateCommandBuffers(commandBufferAllocateInfo);
+				}
+				catch (const vk::SystemError& err) {
+					Log_error("failed to allocate vulkan command buffers. error {}", err.what());
+					throw;
+				}
+			}, { computePasses });
+
+			startup.add("create recorder", [&]() {
+				recorder_ = std::make_unique<CommandRecorder>(*device_, *jobs_, static_cast<uint32_t>(swapchain_->size()), settings.recordThreads);
+				if (settings.benchmark)
+					recorder_->setThreadCount(1);
+				Log_info("recording {} draws on up to {} threads", std::max(1u, settings.draws), recorder_->maxThreadCount());
+			}, { createSwapchain });
+
+			if (Trace::enabled()) {
+				startup.add("create gpu trace", [&]() {
+					try {
+						gpuTrace_ = std::make_unique<GpuTrace>(*device_, static_cast<uint32_t>(commandBuffers_.size()));
+					}
+					catch (const std::exception& ex) {
+						Log_warn("failed to create gpu trace, only cpu zones are recorded. error {}", ex.what());
+					}
+				}, { commandBuffers });
 			}
 
+			startup.run();
+
 			return true;
 		}
 		catch (const std::exception& ex) {
@@ -341,6 +806,11 @@ namespace fve {
 
 	bool Engine::unload() noexcept {
 		try {
+			if (device_)
+				device_->memory().log();
+
+			gpuTrace_.reset();
+
 			glfwDestroyWindow(window_);
 			glfwTerminate();
 
@@ -356,38 +826,162 @@ namespace fve {
 	}
 
 	void Engine::mainLoop() {
-		auto currentTime = std::chrono::high_resolution_clock::now();
+		const auto startTime = std::chrono::steady_clock::now();
+		const auto extent = swapchain_->extent();
 
 		glfwShowWindow(window_);
+		redrawFrames_ = SETTLE_FRAMES;
 		while (!glfwWindowShouldClose(window_)) {
-			auto newTime = std::chrono::high_resolution_clock::now();
-			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
-			currentTime = newTime;
+			{
+				Trace_zone("poll events");
+				glfwPollEvents();
+				if (glfwGetKey(window_, GLFW_KEY_ESCAPE))
+					glfwSetWindowShouldClose(window_, true);
+				updateView();
+			}
+
+			// nothing is presented while minimized, the clock does not advance either
+			if (!visible() || !needsRedraw()) {
+				Trace_zone("idle");
+				glfwWaitEventsTimeout(IDLE_TIMEOUT);
+				continue;
+			}
+
+			Trace_zone("frame");
+
+			Clock::Frame frame{};
+			if (!clock_->next(frame))
+				break;
+
+			if (clock_->replaying()) {
+				if (clock_->frameCount() == 1 && (frame.width != extent.width || frame.height != extent.height))
+					Log_warn("capture was recorded at {}x{}, replaying at {}x{}", frame.width, frame.height, extent.width, extent.height);
+				center_ = { frame.centerX, frame.centerY };
+				scale_ = frame.scale;
+				if (frame.quality != quality_)
+					setQuality(frame.quality);
+			}
+			else {
+				frame.width = extent.width;
+				frame.height = extent.height;
+				frame.centerX = center_.x;
+				frame.centerY = center_.y;
+				frame.scale = scale_;
+				frame.quality = quality_;
+			}
 
-			glfwPollEvents();
-			if (glfwGetKey(window_, GLFW_KEY_ESCAPE))
-				glfwSetWindowShouldClose(window_, true);
+			time_ = frame.time;
 
 			auto cb = beginFrame();
-			beginRenderPass(cb);
-			drawFrame(cb);
-			endRenderPass(cb);
+			descriptors_->beginFrame(currentImageIndex_);
+			if (tiles_) {
+				// a moved view starts over from the centre, the tiles of a pass share the view and the time.
+				// the tile count comes from gpu timings, replays draw the captured one to reproduce the work
+				tiles_->schedule(currentImageIndex_, center_ != previousCenter_ || scale_ != previousScale_, clock_->replaying() ? frame.tiles : 0);
+				if (tiles_->first())
+					sliceTime_ = time_;
+			}
+			frame.tiles = tiles_ ? tiles_->count() : 0;
+			clock_->record(frame);
+			{
+				Trace_zone("record");
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "buddhabrot");
+					buddhabrot_->setView(center_, scale_);
+					buddhabrot_->update(cb);
+				}
+				iterationBudget_->setView(center_, scale_);
+				iterationBudget_->prepare(cb);
+				// only the channels of batches this frame draws are in use, the others may be evicted
+				for (const auto& batch : batches_) {
+					bool drawn = !tiles_;
+					for (uint32_t i = 0; !drawn && i < tiles_->count(); ++i)
+						drawn = intersects(tiles_->tile(i), batch.area);
+					if (drawn)
+						textures_->use(batch.channels);
+				}
+				textures_->update(cb, currentImageIndex_);
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "frame prologues");
+					const glm::vec2 resolution{ static_cast<float>(extent.width), static_cast<float>(extent.height) };
+					prologues_->update(cb, currentImageIndex_, { resolution, static_cast<float>(tiles_ ? sliceTime_ : time_), frame_, 0 });
+				}
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "cone march");
+					coneMarcher_->update(cb, currentImageIndex_, center_, scale_, static_cast<float>(tiles_ ? sliceTime_ : time_));
+				}
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "render pass");
+					coneMarcher_->beginRenderPass(cb);
+					beginRenderPass(cb);
+					const auto recordBegin = Trace::now();
+					drawFrame(cb);
+					if (settings.benchmark)
+						benchmark(Trace::now() - recordBegin);
+					endRenderPass(cb);
+					coneMarcher_->endRenderPass(cb);
+				}
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "iteration budget");
+					iterationBudget_->update(cb);
+				}
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "supersampling");
+					supersampling_->setView(center_, scale_, quality_);
+					supersampling_->update(cb);
+				}
+				{
+					Trace_gpu_zone(gpuTrace_.get(), cb, "histogram");
+					histogram_->setSteps(quality_);
+					histogram_->update(cb);
+				}
+			}
 			endFrame(cb);
+			device_->memory().update();
 
 			glfwSwapBuffers(window_);
+
+			if (redrawFrames_ > 0)
+				--redrawFrames_;
 		}
 
 		device_->logical().waitIdle();
+
+		if (clock_->replaying()) {
+			const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			const auto frames = clock_->frameCount();
+			Log_info("replayed {} frames in {:.3f} s, {:.3f} ms per frame", frames, seconds, frames > 0 ? seconds * 1e3 / frames : 0.0);
+		}
+	}
+
+	bool Engine::sweep() noexcept {
+		std::vector<glm::vec2> parameters;
+		if (!JuliaSweep::parse(settings.sweep, parameters))
+			return false;
+
+		try {
+			JuliaSweep julia{ *device_, getShader(settings.sweepShader), settings.sweepSize, settings.sweepLayers, settings.constants.empty() ? 0 : settings.constants[0] };
+			return julia.run(parameters, settings.sweepOutput);
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to create julia sweep. error {}", ex.what());
+		}
+		return false;
 	}
 
 	vk::CommandBuffer Engine::beginFrame() noexcept {
-		if (swapchain_->acquireNextImage(currentImageIndex_) != vk::Result::eSuccess) {
-			Log_error("failed to acquire next image from the swapchain");
-			return {};
+		{
+			Trace_zone("acquire");
+			if (swapchain_->acquireNextImage(currentImageIndex_) != vk::Result::eSuccess) {
+				Log_error("failed to acquire next image from the swapchain");
+				return {};
+			}
 		}
 		auto cb = commandBuffers_[currentImageIndex_];
 		try {
 			cb.begin(vk::CommandBufferBeginInfo{});
+			if (gpuTrace_)
+				gpuTrace_->begin(cb, currentImageIndex_);
 			return cb;
 		}
 		catch (const vk::SystemError& err) {
@@ -403,6 +997,11 @@ namespace fve {
 	}
 
 	void Engine::beginRenderPass(vk::CommandBuffer commandBuffer) noexcept {
+		if (tiles_) {
+			tiles_->beginRenderPass(commandBuffer);
+			return;
+		}
+
 		vk::ClearValue clearColor = { std::array<float, 4>{ 0.1f, 0.1f, 0.1f, 1.0f } };
 
 		vk::RenderPassBeginInfo renderPassBeginInfo{};
@@ -412,15 +1011,20 @@ namespace fve {
 		renderPassBeginInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
 		renderPassBeginInfo.renderArea.extent = swapchain_->extent();
 
-		commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+		commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
 	}
 
 	void Engine::endRenderPass(vk::CommandBuffer commandBuffer) noexcept {
-		commandBuffer.endRenderPass();
+		if (tiles_)
+			tiles_->endRenderPass(commandBuffer, swapchain_->image(currentImageIndex_));
+		else
+			commandBuffer.endRenderPass();
 	}
 
 	void Engine::endFrame(vk::CommandBuffer commandBuffer) noexcept {
 		try {
+			if (gpuTrace_)
+				gpuTrace_->end(commandBuffer);
 			commandBuffer.end();
 		}
 		catch (const vk::SystemError& err) {
@@ -433,7 +1037,13 @@ namespace fve {
 	}
 
 	void Engine::drawFrame(vk::CommandBuffer commandBuffer) {
-		pipeline_->bind(commandBuffer);
+		// resolved once, the recording threads must not touch the variant selection
+		std::vector<vk::Pipeline> pipelines;
+		pipelines.reserve(batches_.size());
+		for (auto& batch : batches_) {
+			batch.drawnPipeline = batch.pipeline->selectedPipeline();
+			pipelines.push_back(batch.drawnPipeline);
+		}
 
 		vk::Viewport viewport{};
 		viewport.x = 0.0f;
@@ -443,18 +1053,187 @@ namespace fve {
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
 
-		vk::Rect2D scissor{ {0, 0}, swapchain_->extent() };
-		commandBuffer.setViewport(0, viewport);
-		commandBuffer.setScissor(0, scissor);
+		const auto extent = swapchain_->extent();
 
 		GlobalConstant global{};
 		global.resolution = { viewport.width, viewport.height };
-		global.time = static_cast<float>(glfwGetTime());
+		global.time = static_cast<float>(tiles_ ? sliceTime_ : time_);
+
+		global.scale = scale_;
+		global.center = center_;
+		global.previousCenter = previousCenter_;
+		// the iterations are only reprojected between passes drawn whole, the history of a sliced pass
+		// mixes views and the tiles of the current one would read what they wrote themselves
+		const bool whole = !tiles_ || tiles_->whole();
+		global.previousScale = historyValid_ && settings.reprojection && !sliced_ && whole ? previousScale_ : 0.0f;
+		global.frame = frame_++;
+		global.still = center_ == previousCenter_ && scale_ == previousScale_ ? 1u : 0u;
+
+		previousCenter_ = center_;
+		previousScale_ = scale_;
+		historyValid_ = true;
+		sliced_ = !whole;
+
+		vk::CommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.setRenderPass(tiles_ ? tiles_->renderPass() : swapchain_->renderPass());
+		inheritanceInfo.setSubpass(0);
+		inheritanceInfo.setFramebuffer(tiles_ ? tiles_->framebuffer() : swapchain_->framebuffer(currentImageIndex_));
+
+		// the scheduled tiles or the strips are the draws
+		const auto drawCount = tiles_ ? tiles_->count() : std::max(1u, settings.draws);
+		const auto instanceBuffer = instances_->buffer();
+		const vk::DeviceSize instanceOffset = 0;
+
+		recorder_->record(commandBuffer, currentImageIndex_, inheritanceInfo, drawCount, [&](vk::CommandBuffer secondary, uint32_t begin, uint32_t end) {
+			secondary.setViewport(0, viewport);
+			secondary.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eFragment, 0, sizeof(GlobalConstant), &global);
+			iterationBudget_->bind(secondary, *pipelineLayout_);
+			buddhabrot_->bind(secondary, *pipelineLayout_, 1);
+			supersampling_->bind(secondary, *pipelineLayout_, 3);
+			prologues_->bind(secondary, *pipelineLayout_, currentImageIndex_);
+			descriptors_->bind(secondary, vk::PipelineBindPoint::eGraphics, *pipelineLayout_);
+			histogram_->bind(secondary, *pipelineLayout_, 6);
+			coneMarcher_->bind(secondary, *pipelineLayout_, 7);
+			geometry_->bind(secondary);
+			secondary.bindVertexBuffers(1, instanceBuffer, instanceOffset);
+
+			// the push constants and the descriptor set stay bound across pipelines sharing the layout
+			for (size_t b = 0; b < batches_.size(); ++b) {
+				const auto& batch = batches_[b];
+				secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines[b]);
+				if (descriptors_->bindless())
+					secondary.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eFragment, offsetof(GlobalConstant, channels), sizeof(GlobalConstant::channels), textures_->handles(batch.channels).data());
+				else
+					textures_->bind(secondary, *pipelineLayout_, batch.channels);
+
+				// every draw covers its own strip or tile, the image does not depend on the draw count
+				for (uint32_t i = begin; i < end; ++i) {
+					const auto top = static_cast<uint32_t>(static_cast<uint64_t>(extent.height) * i / drawCount);
+					const auto bottom = static_cast<uint32_t>(static_cast<uint64_t>(extent.height) * (i + 1) / drawCount);
+					const auto scissor = tiles_ ? tiles_->tile(i) : vk::Rect2D{ { 0, static_cast<int32_t>(top) }, { extent.width, bottom - top } };
+					if (!intersects(scissor, batch.area))
+						continue;
+					secondary.setScissor(0, scissor);
+					geometry_->draw(secondary, batch.draws);
+				}
+			}
+		});
+	}
+
+	void Engine::benchmark(int64_t recordTime) {
+		benchmarkTime_ += recordTime;
+		if (++benchmarkFrames_ < BENCHMARK_FRAMES)
+			return;
+
+		const auto threadCount = recorder_->threadCount();
+		const auto milliseconds = static_cast<double>(benchmarkTime_) / benchmarkFrames_ / 1e6;
+		Log_info("recorded {} draws on {} threads in {:.3f} ms", std::max(1u, settings.draws), threadCount, milliseconds);
+
+		benchmarkFrames_ = 0;
+		benchmarkTime_ = 0;
+		recorder_->setThreadCount(threadCount == recorder_->maxThreadCount() ? 1 : threadCount * 2);
+	}
+
+	void Engine::onKey(int key, int action) {
+		if (action == GLFW_PRESS && key == GLFW_KEY_M && device_)
+			device_->memory().log();
+		if (action != GLFW_PRESS || clock_->replaying())
+			return;
 
-		commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eFragment, 0, sizeof(GlobalConstant), &global);
+		const bool increase = key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD;
+		const bool decrease = key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT;
+		if (!increase && !decrease)
+			return;
+
+		if (quality_ <= 0) {
+			Log_info("quality knob is not configured. set constant 0 in settings to enable it");
+			return;
+		}
+
+		setQuality(increase ? quality_ * 2 : std::max(1, quality_ / 2));
+	}
+
+	void Engine::setQuality(int32_t quality) {
+		quality_ = quality;
+
+		// the variants are created in the background, the current ones are used until they are ready.
+		// reproducible clocks wait instead, so every run switches at the same frame
+		const bool wait = clock_->source() != Clock::Source::Wall || !settings.capture.empty();
+		for (auto& batch : batches_) {
+			auto specialization = batch.pipeline->specialization();
+			specialization.set(0, quality_);
+			batch.pipeline->select(specialization);
+			if (wait)
+				batch.pipeline->wait();
+		}
+		// the variant switches at an unknown frame, the history may have been computed with either
+		historyValid_ = false;
+
+		Log_info("quality {}", quality_);
+	}
+
+	void Engine::onScroll(double offset) {
+		if (clock_->replaying())
+			return;
+
+		const auto extent = swapchain_->extent();
+		const glm::vec2 resolution{ static_cast<float>(extent.width), static_cast<float>(extent.height) };
+
+		// zoom around the point under the cursor
+		double x, y;
+		glfwGetCursorPos(window_, &x, &y);
+		const auto uv = (glm::vec2{ static_cast<float>(x), static_cast<float>(y) } - 0.5f * resolution) / resolution.y;
+		const auto point = center_ + scale_ * uv;
+
+		scale_ *= std::pow(ZOOM_STEP, static_cast<float>(offset));
+		center_ = point - scale_ * uv;
+	}
+
+	void Engine::updateView() {
+		if (clock_->replaying())
+			return;
+
+		glm::dvec2 cursor;
+		glfwGetCursorPos(window_, &cursor.x, &cursor.y);
+
+		const bool pressed = glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+		if (pressed && dragging_) {
+			const auto delta = glm::vec2{ cursor - cursor_ };
+			center_ -= delta / static_cast<float>(swapchain_->extent().height) * scale_;
+		}
+
+		dragging_ = pressed;
+		cursor_ = cursor;
+	}
+
+	void Engine::onRefresh() {
+		// the window contents were damaged, one frame restores them
+		redrawFrames_ = std::max(redrawFrames_, 1u);
+	}
+
+	bool Engine::visible() {
+		if (glfwGetWindowAttrib(window_, GLFW_ICONIFIED) || !glfwGetWindowAttrib(window_, GLFW_VISIBLE))
+			return false;
+		int w, h;
+		glfwGetFramebufferSize(window_, &w, &h);
+		return w > 0 && h > 0;
+	}
+
+	bool Engine::needsRedraw() {
+		if (!settings.onDemand || settings.benchmark || clock_->source() != Clock::Source::Wall)
+			return true;
 
-		canvas_->bind(commandBuffer);
-		canvas_->draw(commandBuffer);
+		bool changed = animated_ || !historyValid_ || center_ != previousCenter_ || scale_ != previousScale_;
+		for (auto& batch : batches_)
+			changed = changed || batch.pipeline->selectedPipeline() != batch.drawnPipeline;
+		// textures are only polled and uploaded by rendered frames
+		changed = changed || textures_->streaming();
+		// a sliced pass is drawn to its end
+		changed = changed || (tiles_ && !tiles_->finished());
+		if (changed)
+			redrawFrames_ = SETTLE_FRAMES;
+
+		return redrawFrames_ > 0 || buddhabrot_->accumulating();
 	}
 
 }
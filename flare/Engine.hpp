@@ -6,34 +6,134 @@
 #include <type_traits>
 #include <fstream>
 #include <memory>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
 #include <vulkan/vulkan.hpp>
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
 #include "Log.hpp"
+#include "GeometryArena.hpp"
 
 struct GLFWwindow;
 
 namespace fve {
 
 	class Device;
+	class Buffer;
 	class Shader;
 	class Swapchain;
 	class Pipeline;
 	class Mesh;
+	class GpuTrace;
+	class IterationBudget;
+	class AdaptiveSampling;
+	class IterationHistogram;
+	class ConeMarcher;
+	class FramePrologue;
+	class Buddhabrot;
+	class Clock;
+	class CommandRecorder;
+	class TextureStreamer;
+	class Descriptors;
+	class TileScheduler;
+	class JobSystem;
 	
 	class Engine final {
 	public:
 		struct Settings {
+			// a cell of the gallery
+			struct Effect {
+				std::string shader = "";
+				// passed to the fragment shader, up to four values
+				std::vector<float> parameters = {};
+				// images bound as iChannel0..3, an empty path leaves the channel black
+				std::vector<std::string> channels = {};
+				// mesh file fitted into the cell, the shader fills its silhouette. an empty path draws
+				// the whole cell, see flare --convert
+				std::string mesh = "";
+
+				NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Effect, shader, parameters, channels, mesh)
+			};
+
 			uint32_t width = 600;
 			uint32_t height = 600;
 			std::string shader = "";
+			// chrome trace json written on shutdown, empty disables tracing
+			std::string trace = "";
+			// specialization constants of the fragment shader indexed by constant_id. constant 0 is
+			// the quality knob (iteration or step count) of the bundled shaders
+			std::vector<int32_t> constants = {};
+			// per tile iteration budgets computed from the previous frame
+			bool adaptive = true;
+			// reuse the previous frame's iterations while panning and zooming
+			bool reprojection = true;
+			// samples per edge pixel of mandelbrot.frag once the view stands still, 4 to 64, 0 disables
+			uint32_t supersampling = 0;
+			// pixels whose 3x3 neighbourhood of iterations deviates by more than this are supersampled
+			float edgeThreshold = 1.0f;
+			// colour mandelbrot.frag by the distribution of the previous frame's escape counts
+			bool equalize = true;
+			// start the rays of mandelbulb.frag at the depths of a low resolution cone marching
+			// pre-pass, false marches every pixel from the camera
+			bool coneMarching = true;
+			// steps of a cone of the pre-pass, 0 keeps the default of mandelbulb.cone.comp
+			int32_t coneSteps = 0;
+			// the canvas is drawn as this many horizontal strips, recorded in parallel
+			uint32_t draws = 1;
+			// threads of the job system recording the draws, 0 uses all of them
+			uint32_t recordThreads = 0;
+			// cycles through the thread counts and logs the average recording time of each
+			bool benchmark = false;
+			// threads of the job system, 0 uses one per hardware thread. see flare --benchmark-jobs
+			uint32_t jobThreads = 0;
+			// effects drawn side by side in a grid, empty draws the shader above over the whole window
+			std::vector<Effect> gallery = {};
+			// orbits traced per frame by the buddhabrot effect, its only quality knob
+			uint32_t samples = 1 << 20;
+			// time source of the frames: wall, fixed or replay
+			std::string clock = "wall";
+			// seconds per frame of the fixed clock
+			double timeStep = 1.0 / 60.0;
+			// per-frame inputs are played back from this file by the replay clock and written to it otherwise
+			std::string capture = "";
+			// frames are only rendered while the output can change, the loop sleeps in between.
+			// the fixed and replay clocks and the benchmark always render every frame
+			bool onDemand = false;
+			// images bound as iChannel0..3 of the shader above
+			std::vector<std::string> channels = {};
+			// mesh file the shader above fills, an empty path draws the whole window
+			std::string mesh = "";
+			// megabytes of resident channel textures, the least recently used are evicted beyond it
+			uint32_t textureBudget = 256;
+			// milliseconds of gpu time the effects may take per refresh, 0 disables time slicing. frames
+			// that take longer are drawn tile by tile over several refreshes, see TileScheduler
+			float sliceBudget = 0.0f;
+			// side of the tiles in pixels
+			uint32_t sliceTileSize = 128;
+			// megabytes of device memory this instance may allocate, 0 is unlimited. press m for the
+			// allocations, they are also logged on shutdown
+			uint32_t memoryLimit = 0;
+			// file of julia c values, one per line. when set the images are rendered in batches into
+			// sweepOutput without showing the window, then flare exits. see JuliaSweep
+			std::string sweep = "";
+			std::string sweepOutput = "julia.bin";
+			// variant of julia_sweep.comp, like julia_sweep+BANDED.comp
+			std::string sweepShader = "julia_sweep.comp";
+			// side of every image and images rendered per submit
+			uint32_t sweepSize = 128;
+			uint32_t sweepLayers = 256;
 
+			// keys missing from the file keep their defaults. a file that fails to parse leaves the
+			// settings untouched
 			inline static void read(std::istream& is, Settings& settings) {
 				nlohmann::json json;
 				is >> json;
-				from_json(json, settings);
+				settings = json.get<Settings>();
 			}
 
 			inline static void write(std::ostream& os, const Settings& settings) {
@@ -80,7 +180,7 @@ namespace fve {
 				return false;
 			}
 
-			NLOHMANN_DEFINE_TYPE_INTRUSIVE(Settings, width, height, shader)
+			NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Settings, width, height, shader, trace, constants, adaptive, reprojection, supersampling, edgeThreshold, equalize, coneMarching, coneSteps, draws, recordThreads, benchmark, jobThreads, gallery, samples, clock, timeStep, capture, onDemand, channels, mesh, textureBudget, sliceBudget, sliceTileSize, memoryLimit, sweep, sweepOutput, sweepShader, sweepSize, sweepLayers)
 		};
 
 		explicit Engine(int argc, char** argv);
@@ -106,6 +206,9 @@ namespace fve {
 													   const std::string& shaderSource,
 													   vk::ShaderStageFlagBits shaderStage) noexcept;
 
+		// cpu work of the engine and its modules is scheduled here, created by load()
+		inline JobSystem& jobs() noexcept { return *jobs_; }
+
 		std::vector<uint32_t> compileShaderSource(const std::string& shaderSource,
 												  const std::string& shaderName,
 												  vk::ShaderStageFlagBits shaderStage,
@@ -116,6 +219,7 @@ namespace fve {
 		bool unload() noexcept;
 
 		void mainLoop();
+		bool sweep() noexcept;
 
 		vk::CommandBuffer beginFrame() noexcept;
 		void beginRenderPass(vk::CommandBuffer commandBuffer) noexcept;
@@ -123,16 +227,83 @@ namespace fve {
 		void endFrame(vk::CommandBuffer commandBuffer) noexcept;
 		void drawFrame(vk::CommandBuffer commandBuffer);
 
+		void onKey(int key, int action);
+		void setQuality(int32_t quality);
+		void onScroll(double offset);
+		void updateView();
+		void onRefresh();
+		bool visible();
+		bool needsRedraw();
+		void benchmark(int64_t recordTime);
+
+		// declared first, so it is destroyed last and the members still log while they go
+		Log::Guard logGuard_;
+		std::vector<std::string> arguments_;
 		GLFWwindow* window_ = nullptr;
+		// declared before its users, so it is destroyed after them
+		std::unique_ptr<JobSystem> jobs_ = nullptr;
 		std::unique_ptr<Device> device_ = nullptr;
-		std::unique_ptr<Mesh> canvas_ = nullptr;
+		std::unique_ptr<GeometryArena> geometry_ = nullptr;
+		GeometryArena::Id canvas_ = 0;
+		// the mesh files of the effects by path
+		std::unordered_map<std::string, GeometryArena::Id> meshes_;
 		std::unordered_map<std::string, std::shared_ptr<Shader>> shaders_;
 		// renderer
 		vk::UniquePipelineLayout pipelineLayout_;
 		std::unique_ptr<Swapchain> swapchain_ = nullptr;
-		std::unique_ptr<Pipeline> pipeline_ = nullptr;
+		std::unique_ptr<IterationBudget> iterationBudget_ = nullptr;
+		std::unique_ptr<AdaptiveSampling> supersampling_ = nullptr;
+		std::unique_ptr<IterationHistogram> histogram_ = nullptr;
+		std::unique_ptr<ConeMarcher> coneMarcher_ = nullptr;
+		std::unique_ptr<Buddhabrot> buddhabrot_ = nullptr;
+		std::unique_ptr<Descriptors> descriptors_ = nullptr;
+		std::unique_ptr<TextureStreamer> textures_ = nullptr;
+		std::unique_ptr<FramePrologue> prologues_ = nullptr;
+		std::unique_ptr<TileScheduler> tiles_ = nullptr;
+		// instances sharing a fragment shader, drawn with one pipeline bind and one instanced draw
+		struct Batch {
+			std::unique_ptr<Pipeline> pipeline;
+			uint32_t firstInstance = 0;
+			uint32_t instanceCount = 0;
+			GeometryArena::DrawList draws{};
+			// framebuffer pixels covered by the cells of the batch, draws of tiles and strips outside
+			// it are skipped
+			vk::Rect2D area{};
+			// the iChannel textures of the batch, see TextureStreamer::addChannels
+			uint32_t channels = 0;
+			// the variant of the last frame, a newly created variant has to be shown
+			vk::Pipeline drawnPipeline{};
+		};
+
+		std::unique_ptr<Buffer> instances_ = nullptr;
+		std::vector<Batch> batches_;
+		int32_t quality_ = 0;
+		// view of the complex plane, scale is the visible height
+		glm::vec2 center_{ -0.5f, 0.0f };
+		float scale_ = 2.3f;
+		glm::vec2 previousCenter_{ -0.5f, 0.0f };
+		float previousScale_ = 2.3f;
+		// false until a frame has been rendered with the current shader variant
+		bool historyValid_ = false;
+		// the last refresh drew part of a pass, the iterations of the other tiles are stale
+		bool sliced_ = false;
+		// time of the pass being drawn, every tile of a pass is drawn at the same time
+		double sliceTime_ = 0.0;
+		glm::dvec2 cursor_{ 0.0, 0.0 };
+		bool dragging_ = false;
+		uint32_t frame_ = 0;
+		// whether any effect reads the time, such effects are redrawn every frame
+		bool animated_ = true;
+		// frames still rendered after the last change, so progressive effects can settle
+		uint32_t redrawFrames_ = 0;
 		std::vector<vk::CommandBuffer> commandBuffers_;
+		std::unique_ptr<CommandRecorder> recorder_ = nullptr;
+		uint32_t benchmarkFrames_ = 0;
+		int64_t benchmarkTime_ = 0;
 		uint32_t currentImageIndex_ = 0;
+		std::unique_ptr<Clock> clock_ = nullptr;
+		double time_ = 0.0;
+		std::unique_ptr<GpuTrace> gpuTrace_ = nullptr;
 
 	};
 
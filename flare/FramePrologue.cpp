@@ -0,0 +1,157 @@
+#include "FramePrologue.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Log.hpp"
+
+#include <array>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+}
+
+namespace fve {
+
+	FramePrologue::FramePrologue(Device& device, uint32_t slotCount) : device_{ device }, slotCount_{ slotCount } {
+		// 0 records, 1 instances
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment);
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(Constants));
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+			pipelineLayoutCreateInfo.setSetLayouts(*descriptorSetLayout_);
+			pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create frame prologue layouts. error {}", err.what());
+			throw;
+		}
+	}
+
+	FramePrologue::~FramePrologue() noexcept {
+	}
+
+	uint32_t FramePrologue::add(std::shared_ptr<Shader> shader, uint32_t firstInstance, uint32_t instanceCount) {
+		if (!shader)
+			return NONE;
+
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+
+		vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+		computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+		computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+		try {
+			prologues_.push_back({ device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo), firstInstance, instanceCount });
+			return static_cast<uint32_t>(prologues_.size() - 1);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create frame prologue pipeline. error {}", err.what());
+		}
+		return NONE;
+	}
+
+	void FramePrologue::createDescriptors(vk::Buffer instances, uint32_t instanceCount) {
+		if (prologues_.empty())
+			return;
+
+		vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, 2 * slotCount_ };
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(slotCount_);
+		descriptorPoolCreateInfo.setPoolSizes(poolSize);
+
+		try {
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			const std::vector<vk::DescriptorSetLayout> setLayouts(slotCount_, *descriptorSetLayout_);
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(setLayouts);
+
+			descriptorSets_ = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create frame prologue descriptors. error {}", err.what());
+			throw;
+		}
+
+		for (uint32_t slot = 0; slot < slotCount_; ++slot) {
+			records_.push_back(std::make_unique<Buffer>(device_,
+														RECORD_SIZE,
+														instanceCount,
+														vk::BufferUsageFlagBits::eStorageBuffer,
+														vk::MemoryPropertyFlagBits::eDeviceLocal,
+														"prologue records"));
+
+			vk::DescriptorBufferInfo recordsInfo{ records_.back()->buffer(), 0, VK_WHOLE_SIZE };
+			vk::DescriptorBufferInfo instancesInfo{ instances, 0, VK_WHOLE_SIZE };
+
+			std::array<vk::WriteDescriptorSet, 2> writes{};
+			writes[0].setBufferInfo(recordsInfo);
+			writes[1].setBufferInfo(instancesInfo);
+			for (uint32_t binding = 0; binding < writes.size(); ++binding) {
+				writes[binding].setDstSet(descriptorSets_[slot]);
+				writes[binding].setDstBinding(binding);
+				writes[binding].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			}
+
+			device_.logical().updateDescriptorSets(writes, nullptr);
+		}
+
+		Log_info("{} frame prologues", prologues_.size());
+	}
+
+	void FramePrologue::update(vk::CommandBuffer commandBuffer, uint32_t slot, Constants constants) {
+		if (prologues_.empty())
+			return;
+
+		// the records of the slot were last read by the render pass of the slot's previous frame
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+		}
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, descriptorSets_[slot], nullptr);
+		for (const auto& prologue : prologues_) {
+			constants.firstInstance = prologue.firstInstance;
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *prologue.pipeline);
+			commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants), &constants);
+			commandBuffer.dispatch(prologue.instanceCount, 1, 1);
+		}
+
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, memoryBarrier, nullptr, nullptr);
+	}
+
+	void FramePrologue::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t slot, uint32_t set) {
+		if (!descriptorSets_.empty())
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSets_[slot], nullptr);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+
+	// per-frame work hoisted out of the fragment shaders. a shader x.frag can come with a compute
+	// shader x.prologue.comp that runs once per frame and instance before the render pass, one
+	// workgroup per instance. it writes a record the fragment shader reads instead of recomputing
+	// the same values for every pixel. see shaders/cardioid.prologue.comp
+	//
+	// records are RECORD_SIZE bytes and indexed by the instance index, in both stages bound at set 4:
+	// binding 0 the records, binding 1 the instances. records are kept per swapchain image so frames
+	// in flight keep theirs
+	class FramePrologue final {
+	public:
+		static constexpr vk::DeviceSize RECORD_SIZE = 4096;
+		static constexpr uint32_t NONE = ~0u;
+
+		// the push constant of the prologues
+		struct Constants {
+			glm::vec2 resolution;
+			float time;
+			uint32_t frame;
+			uint32_t firstInstance;
+		};
+
+		explicit FramePrologue(Device& device, uint32_t slotCount);
+
+		~FramePrologue() noexcept;
+
+		FramePrologue(const FramePrologue&) = delete;
+		FramePrologue& operator=(const FramePrologue&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+
+		// returns NONE when there is no prologue or its pipeline failed
+		uint32_t add(std::shared_ptr<Shader> shader, uint32_t firstInstance, uint32_t instanceCount);
+		// the instances are those of every batch, after the last add()
+		void createDescriptors(vk::Buffer instances, uint32_t instanceCount);
+
+		// runs every prologue for the slot, before the render pass
+		void update(vk::CommandBuffer commandBuffer, uint32_t slot, Constants constants);
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t slot, uint32_t set = 4);
+
+	private:
+		struct Prologue {
+			vk::UniquePipeline pipeline;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+		};
+
+		Device& device_;
+		uint32_t slotCount_;
+		std::vector<Prologue> prologues_;
+		std::vector<std::unique_ptr<Buffer>> records_;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		std::vector<vk::DescriptorSet> descriptorSets_;
+		vk::UniquePipelineLayout pipelineLayout_;
+	};
+
+}
\ No newline at end of file
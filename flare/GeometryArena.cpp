@@ -0,0 +1,312 @@
+#include "GeometryArena.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+	// bytes copied per transfer, uploads of any size go through this much host memory
+	static constexpr vk::DeviceSize STAGING_SIZE = 16 << 20;
+}
+
+namespace fve {
+
+	GeometryArena::GeometryArena(Device& device, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t commandCapacity) :
+		device_{ device },
+		vertexRanges_{ vertexCapacity * static_cast<uint32_t>(sizeof(Mesh::Vertex)) },
+		indexRanges_{ indexCapacity * static_cast<uint32_t>(sizeof(Mesh::Index)) },
+		commandCapacity_{ commandCapacity }
+	{
+		// layouts of any stride share the vertices, the ranges count bytes
+		vertexBuffer_ = std::make_unique<Buffer>(device_,
+												 sizeof(Mesh::Vertex),
+												 vertexCapacity,
+												 vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+												 vk::MemoryPropertyFlagBits::eDeviceLocal,
+												 "geometry vertices");
+
+		indexBuffer_ = std::make_unique<Buffer>(device_,
+												sizeof(Mesh::Index),
+												indexCapacity,
+												vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+												vk::MemoryPropertyFlagBits::eDeviceLocal,
+												"geometry indices");
+
+		commandBuffer_ = std::make_unique<Buffer>(device_,
+												  sizeof(vk::DrawIndexedIndirectCommand),
+												  commandCapacity,
+												  vk::BufferUsageFlagBits::eIndirectBuffer,
+												  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+												  "geometry commands");
+
+		// one count per list, lists take at least one command each
+		countBuffer_ = std::make_unique<Buffer>(device_,
+												sizeof(uint32_t),
+												commandCapacity,
+												vk::BufferUsageFlagBits::eIndirectBuffer,
+												vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+												"geometry counts");
+
+		// a non zero first instance in an indirect command needs drawIndirectFirstInstance, devices
+		// without it get the commands recorded one by one from the host copy
+		const auto& features = device_.features();
+		drawIndirect_ = features.drawIndirectFirstInstance;
+		multiDrawIndirect_ = drawIndirect_ && features.multiDrawIndirect;
+		drawIndirectCount_ = multiDrawIndirect_ && device_.extensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+		Log_info("geometry arena of {} vertices and {} indices, drawn with {}",
+				 vertexCapacity,
+				 indexCapacity,
+				 drawIndirectCount_ ? "draw indirect count" : multiDrawIndirect_ ? "multi draw indirect" : drawIndirect_ ? "draw indirect" : "direct draws");
+	}
+
+	GeometryArena::~GeometryArena() noexcept {
+	}
+
+	GeometryArena::Id GeometryArena::upload(const std::vector<Mesh::Vertex>& vertices, const std::vector<Mesh::Index>& indices) {
+		layouts::Bounds bounds{};
+		if (!vertices.empty()) {
+			bounds.min = bounds.max = vertices.front().get<0>();
+			for (const auto& vertex : vertices) {
+				bounds.min = glm::min(bounds.min, vertex.get<0>());
+				bounds.max = glm::max(bounds.max, vertex.get<0>());
+			}
+		}
+
+		const auto vertexCount = static_cast<uint32_t>(vertices.size());
+		const auto indexCount = static_cast<uint32_t>(indices.size());
+		if (vertices.size() <= 0x10000) {
+			const std::vector<uint16_t> narrow(indices.begin(), indices.end());
+			return upload(layouts::Id::Position, vertices.data(), vertexCount, vk::IndexType::eUint16, narrow.data(), indexCount, bounds);
+		}
+		return upload(layouts::Id::Position, vertices.data(), vertexCount, vk::IndexType::eUint32, indices.data(), indexCount, bounds);
+	}
+
+	GeometryArena::Id GeometryArena::upload(layouts::Id layout, const void* vertices, uint32_t vertexCount, vk::IndexType indexType, const void* indices, uint32_t indexCount, const layouts::Bounds& bounds) {
+		if (indexType != vk::IndexType::eUint16 && indexType != vk::IndexType::eUint32)
+			throw std::runtime_error{ "failed to upload mesh. unsupported index type" };
+
+		const uint32_t stride = layouts::stride(layout);
+		const uint32_t indexSize = indexType == vk::IndexType::eUint16 ? 2 : 4;
+		const auto vertexBytes = static_cast<uint64_t>(vertexCount) * stride;
+		const auto indexBytes = static_cast<uint64_t>(indexCount) * indexSize;
+		if (vertexBytes > std::numeric_limits<uint32_t>::max() || indexBytes > std::numeric_limits<uint32_t>::max())
+			throw std::runtime_error{ "failed to upload mesh. mesh is too large" };
+
+		uint32_t vertexOffset = 0;
+		uint32_t indexOffset = 0;
+		if (!vertexRanges_.allocate(static_cast<uint32_t>(vertexBytes), stride, vertexOffset))
+			throw std::runtime_error{ "failed to upload mesh. geometry arena is out of vertices" };
+		if (!indexRanges_.allocate(static_cast<uint32_t>(indexBytes), indexSize, indexOffset)) {
+			vertexRanges_.release(vertexOffset, static_cast<uint32_t>(vertexBytes));
+			throw std::runtime_error{ "failed to upload mesh. geometry arena is out of indices" };
+		}
+
+		Range range{};
+		range.firstVertex = vertexOffset / stride;
+		range.vertexCount = vertexCount;
+		range.firstIndex = indexOffset / indexSize;
+		range.indexCount = indexCount;
+		range.layout = layout;
+		range.indexType = indexType;
+		range.bounds = bounds;
+
+		stream(vertices, vertexBytes, *vertexBuffer_, vertexOffset);
+		stream(indices, indexBytes, *indexBuffer_, indexOffset);
+
+		if (!releasedIds_.empty()) {
+			const auto id = releasedIds_.back();
+			releasedIds_.pop_back();
+			meshes_[id] = range;
+			return id;
+		}
+		meshes_.push_back(range);
+		return static_cast<Id>(meshes_.size() - 1);
+	}
+
+	void GeometryArena::release(Id id) {
+		auto& range = meshes_[id];
+		const auto stride = layouts::stride(range.layout);
+		const uint32_t indexSize = range.indexType == vk::IndexType::eUint16 ? 2 : 4;
+		vertexRanges_.release(range.firstVertex * stride, range.vertexCount * stride);
+		indexRanges_.release(range.firstIndex * indexSize, range.indexCount * indexSize);
+		range = {};
+		releasedIds_.push_back(id);
+	}
+
+	vk::DrawIndexedIndirectCommand GeometryArena::command(Id id, uint32_t instanceCount, uint32_t firstInstance) const noexcept {
+		const auto& range = meshes_[id];
+		// indices stay relative to the mesh, the vertex offset moves them into its range
+		return vk::DrawIndexedIndirectCommand{ range.indexCount, instanceCount, range.firstIndex, static_cast<int32_t>(range.firstVertex), firstInstance };
+	}
+
+	void GeometryArena::place(Id id, MeshInstance& instance) const noexcept {
+		const auto& range = meshes_[id];
+		const auto center = range.bounds.center();
+		const auto extent = range.bounds.extent();
+		// the longest axis spans the cell, y and z are flipped into framebuffer and depth direction
+		const auto radius = std::max({ extent.x, extent.y, extent.z });
+		const glm::vec3 flip{ 1.0f / radius, -1.0f / radius, -0.5f / radius };
+
+		if (layouts::quantized(range.layout)) {
+			// snorm positions are already relative to the bounds, scaling them by the extent dequantizes them
+			instance.scale = glm::vec4{ extent * flip, 1.0f };
+			instance.offset = glm::vec4{ 0.0f, 0.0f, 0.5f, 0.0f };
+		}
+		else {
+			instance.scale = glm::vec4{ flip, 1.0f };
+			instance.offset = glm::vec4{ -center * flip + glm::vec3{ 0.0f, 0.0f, 0.5f }, 0.0f };
+		}
+	}
+
+	GeometryArena::DrawList GeometryArena::createList(uint32_t maxCount, vk::IndexType indexType) {
+		maxCount = std::max(1u, maxCount);
+		if (commandCount_ + maxCount > commandCapacity_)
+			throw std::runtime_error{ "failed to create draw list. geometry arena is out of commands" };
+
+		DrawList list{};
+		list.firstCommand = commandCount_;
+		list.maxCount = maxCount;
+		list.index = static_cast<uint32_t>(counts_.size());
+		list.indexType = indexType;
+
+		commandCount_ += maxCount;
+		commands_.resize(commandCount_);
+		counts_.push_back(0);
+		return list;
+	}
+
+	void GeometryArena::write(const DrawList& list, const std::vector<vk::DrawIndexedIndirectCommand>& commands) {
+		if (commands.size() > list.maxCount)
+			throw std::runtime_error{ "failed to write draw list. too many commands" };
+
+		const auto count = static_cast<uint32_t>(commands.size());
+		std::copy(commands.begin(), commands.end(), commands_.begin() + list.firstCommand);
+		counts_[list.index] = count;
+
+		commandBuffer_->write(commands, static_cast<vk::DeviceSize>(list.firstCommand) * sizeof(vk::DrawIndexedIndirectCommand));
+		countBuffer_->write(std::vector<uint32_t>{ count }, static_cast<vk::DeviceSize>(list.index) * sizeof(uint32_t));
+	}
+
+	void GeometryArena::bind(vk::CommandBuffer commandBuffer) {
+		const auto vertexBuffer = vertexBuffer_->buffer();
+		const vk::DeviceSize offset = 0;
+
+		commandBuffer.bindVertexBuffers(0, vertexBuffer, offset);
+	}
+
+	void GeometryArena::draw(vk::CommandBuffer commandBuffer, const DrawList& list) {
+		constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+		const vk::DeviceSize offset = static_cast<vk::DeviceSize>(list.firstCommand) * stride;
+		const auto count = counts_[list.index];
+
+		commandBuffer.bindIndexBuffer(indexBuffer_->buffer(), 0, list.indexType);
+
+		if (drawIndirectCount_) {
+			commandBuffer.drawIndexedIndirectCountKHR(commandBuffer_->buffer(),
+													  offset,
+													  countBuffer_->buffer(),
+													  static_cast<vk::DeviceSize>(list.index) * sizeof(uint32_t),
+													  list.maxCount,
+													  stride);
+		}
+		else if (multiDrawIndirect_) {
+			if (count > 0)
+				commandBuffer.drawIndexedIndirect(commandBuffer_->buffer(), offset, count, stride);
+		}
+		else if (drawIndirect_) {
+			for (uint32_t i = 0; i < count; ++i)
+				commandBuffer.drawIndexedIndirect(commandBuffer_->buffer(), offset + static_cast<vk::DeviceSize>(i) * stride, 1, stride);
+		}
+		else {
+			for (uint32_t i = 0; i < count; ++i) {
+				const auto& command = commands_[list.firstCommand + i];
+				commandBuffer.drawIndexed(command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+			}
+		}
+	}
+
+	void GeometryArena::stream(const void* data, vk::DeviceSize size, Buffer& buffer, vk::DeviceSize offset) {
+		if (size == 0)
+			return;
+
+		if (!stagingBuffer_) {
+			stagingBuffer_ = std::make_unique<Buffer>(device_,
+													  1,
+													  STAGING_SIZE,
+													  vk::BufferUsageFlagBits::eTransferSrc,
+													  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+													  "geometry staging");
+		}
+
+		// every copy waits for the queue, so the staging memory can be refilled right after
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		for (vk::DeviceSize done = 0; done < size;) {
+			const auto chunk = std::min(STAGING_SIZE, size - done);
+			stagingBuffer_->write(bytes + done, chunk, 0);
+			if (!device_.copyBuffer(stagingBuffer_->buffer(), buffer.buffer(), chunk, offset + done))
+				throw std::runtime_error{ "failed to upload mesh. copy failed" };
+			done += chunk;
+		}
+	}
+
+	GeometryArena::Ranges::Ranges(uint32_t capacity) {
+		if (capacity > 0)
+			free_.push_back({ 0, capacity });
+	}
+
+	bool GeometryArena::Ranges::allocate(uint32_t count, uint32_t alignment, uint32_t& offset) {
+		if (count == 0) {
+			offset = 0;
+			return true;
+		}
+
+		for (auto it = free_.begin(); it != free_.end(); ++it) {
+			// the bytes skipped to align the offset stay free
+			const auto padding = (alignment - it->offset % alignment) % alignment;
+			if (it->count < padding || it->count - padding < count)
+				continue;
+			offset = it->offset + padding;
+			const Free after{ offset + count, it->count - padding - count };
+			if (padding > 0) {
+				it->count = padding;
+				if (after.count > 0)
+					free_.insert(std::next(it), after);
+			}
+			else if (after.count > 0) {
+				*it = after;
+			}
+			else {
+				free_.erase(it);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void GeometryArena::Ranges::release(uint32_t offset, uint32_t count) {
+		if (count == 0)
+			return;
+
+		auto next = std::find_if(free_.begin(), free_.end(), [=](const Free& range) { return range.offset > offset; });
+		auto it = free_.insert(next, { offset, count });
+
+		// merge with the neighbours so large meshes still find room later
+		if (auto following = std::next(it); following != free_.end() && it->offset + it->count == following->offset) {
+			it->count += following->count;
+			free_.erase(following);
+		}
+		if (it != free_.begin()) {
+			auto previous = std::prev(it);
+			if (previous->offset + previous->count == it->offset) {
+				previous->count += it->count;
+				free_.erase(it);
+			}
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Mesh.hpp"
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+
+	// one vertex buffer and one index buffer shared by every mesh. meshes are sub-allocated ranges of
+	// them and draws are indirect commands, so a frame binds the geometry once and issues a whole
+	// list of meshes with a single drawIndexedIndirect, or drawIndexedIndirectCount when supported.
+	// meshes keep the vertex layout and index width they were uploaded with, ranges are aligned to
+	// their stride so the vertex offset of a draw addresses them in any layout
+	class GeometryArena final {
+	public:
+		using Id = uint32_t;
+
+		// where a mesh lives in the shared buffers, in vertices and indices of its own format
+		struct Range {
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			uint32_t firstVertex = 0;
+			uint32_t vertexCount = 0;
+			layouts::Id layout = layouts::Id::Position;
+			vk::IndexType indexType = vk::IndexType::eUint32;
+			layouts::Bounds bounds{};
+		};
+
+		// consecutive commands of the indirect buffer with their own draw count. the meshes of a list
+		// share its index type
+		struct DrawList {
+			uint32_t firstCommand = 0;
+			uint32_t maxCount = 0;
+			uint32_t index = 0;
+			vk::IndexType indexType = vk::IndexType::eUint32;
+		};
+
+		// the capacities are counted in float position vertices and 32 bit indices, quantized
+		// vertices and 16 bit indices take less of them
+		explicit GeometryArena(Device& device, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t commandCapacity);
+
+		~GeometryArena() noexcept;
+
+		GeometryArena(const GeometryArena&) = delete;
+		GeometryArena& operator=(const GeometryArena&) = delete;
+
+		// copies the mesh into free ranges of the buffers. uses the graphics queue. indices are stored
+		// as 16 bit whenever every vertex can be addressed with them
+		Id upload(const std::vector<Mesh::Vertex>& vertices, const std::vector<Mesh::Index>& indices);
+		// vertices of the layout and indices of the index type, quantized positions are relative to the
+		// bounds. the data is streamed through a fixed size staging buffer, it can point into a mapped file
+		Id upload(layouts::Id layout, const void* vertices, uint32_t vertexCount, vk::IndexType indexType, const void* indices, uint32_t indexCount, const layouts::Bounds& bounds);
+		// the ranges are reused by later uploads, draws still referring to them must be done
+		void release(Id id);
+
+		inline const Range& range(Id id) const noexcept { return meshes_[id]; }
+
+		vk::DrawIndexedIndirectCommand command(Id id, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const noexcept;
+		// sets the scale and offset of the instance, they dequantize the positions of the mesh and fit
+		// its bounds into the rect of the instance keeping the aspect, z lands in [0, 1]. y and z
+		// point up and towards the viewer
+		void place(Id id, MeshInstance& instance) const noexcept;
+
+		// reserves room for up to maxCount commands of meshes with the index type
+		DrawList createList(uint32_t maxCount, vk::IndexType indexType = vk::IndexType::eUint32);
+		// replaces the commands of the list. the indirect buffer is host visible, lists read by
+		// frames in flight must not be written
+		void write(const DrawList& list, const std::vector<vk::DrawIndexedIndirectCommand>& commands);
+
+		// binds the vertices, the pipeline decides their layout
+		void bind(vk::CommandBuffer commandBuffer);
+		// binds the indices with the index type of the list
+		void draw(vk::CommandBuffer commandBuffer, const DrawList& list);
+
+	private:
+		// first fit over a sorted list of free ranges
+		class Ranges final {
+		public:
+			explicit Ranges(uint32_t capacity);
+
+			// the offset is a multiple of the alignment
+			bool allocate(uint32_t count, uint32_t alignment, uint32_t& offset);
+			void release(uint32_t offset, uint32_t count);
+
+		private:
+			struct Free {
+				uint32_t offset;
+				uint32_t count;
+			};
+
+			std::vector<Free> free_;
+		};
+
+		void stream(const void* data, vk::DeviceSize size, Buffer& buffer, vk::DeviceSize offset);
+
+		Device& device_;
+		// in bytes
+		Ranges vertexRanges_;
+		Ranges indexRanges_;
+		uint32_t commandCapacity_;
+		uint32_t commandCount_ = 0;
+		std::unique_ptr<Buffer> vertexBuffer_ = nullptr;
+		std::unique_ptr<Buffer> indexBuffer_ = nullptr;
+		std::unique_ptr<Buffer> commandBuffer_ = nullptr;
+		std::unique_ptr<Buffer> countBuffer_ = nullptr;
+		std::unique_ptr<Buffer> stagingBuffer_ = nullptr;
+		std::vector<Range> meshes_;
+		std::vector<Id> releasedIds_;
+		// host copies, the draw count of every list and the commands for devices drawing them one by one
+		std::vector<uint32_t> counts_;
+		std::vector<vk::DrawIndexedIndirectCommand> commands_;
+		bool drawIndirectCount_ = false;
+		bool multiDrawIndirect_ = false;
+		bool drawIndirect_ = false;
+	};
+
+}
\ No newline at end of file
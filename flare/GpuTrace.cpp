@@ -0,0 +1,161 @@
+#include "GpuTrace.hpp"
+#include "Device.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+	static constexpr uint32_t INVALID_QUERY = std::numeric_limits<uint32_t>::max();
+}
+
+namespace fve {
+
+	GpuTrace::GpuTrace(Device& device, uint32_t slotCount) : device_{ device }, slots_(slotCount) {
+		auto indices = Device::QueueFamilyIndices::findQueueFamilyIndices(device_.physical(), device_.surface());
+		const auto timestampValidBits = device_.physical().getQueueFamilyProperties()[indices.graphicsFamily.value()].timestampValidBits;
+		if (timestampValidBits == 0)
+			throw std::runtime_error{ "failed to create gpu trace. graphics queue does not support timestamps" };
+		if (timestampValidBits < 64)
+			timestampMask_ = (1ull << timestampValidBits) - 1;
+		timestampPeriod_ = static_cast<double>(device_.physical().getProperties().limits.timestampPeriod);
+
+		vk::QueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.setQueryType(vk::QueryType::eTimestamp);
+		queryPoolCreateInfo.setQueryCount(slotCount * MAX_QUERIES);
+
+		try {
+			queryPool_ = device_.logical().createQueryPoolUnique(queryPoolCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create vulkan query pool. error {}", err.what());
+			throw;
+		}
+
+		if (device_.extensionEnabled(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+			const auto& timeDomains = device_.physical().getCalibrateableTimeDomainsEXT();
+			calibratedTimestamps_ = std::find(timeDomains.begin(), timeDomains.end(), vk::TimeDomainEXT::eDevice) != timeDomains.end();
+		}
+
+		if (calibratedTimestamps_)
+			calibrate();
+		else
+			Log_warn("calibrated timestamps are not supported, gpu track is aligned to the command buffer recording time");
+	}
+
+	GpuTrace::~GpuTrace() noexcept {
+	}
+
+	void GpuTrace::begin(vk::CommandBuffer commandBuffer, uint32_t slot) {
+		if (calibratedTimestamps_ && ++framesSinceCalibration_ >= CALIBRATION_INTERVAL)
+			calibrate();
+
+		currentSlot_ = slot;
+		auto& s = slots_[slot];
+		collect(s, slot);
+
+		s.entries.clear();
+		s.stack.clear();
+		s.queryCount = 0;
+		s.recordTime = Trace::now();
+
+		commandBuffer.resetQueryPool(*queryPool_, slot * MAX_QUERIES, MAX_QUERIES);
+		beginZone(commandBuffer, "gpu frame");
+	}
+
+	void GpuTrace::end(vk::CommandBuffer commandBuffer) {
+		auto& s = slots_[currentSlot_];
+		while (!s.stack.empty())
+			endZone(commandBuffer);
+	}
+
+	void GpuTrace::beginZone(vk::CommandBuffer commandBuffer, const char* name) {
+		auto& s = slots_[currentSlot_];
+		Entry entry{ name, INVALID_QUERY, INVALID_QUERY };
+		// every zone needs two queries, zones that do not fit are dropped. the end queries of the
+		// zones still open are kept free, so every zone that got its begin also gets its end
+		if (s.queryCount + 2 + s.stack.size() <= MAX_QUERIES) {
+			entry.beginQuery = s.queryCount++;
+			commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *queryPool_, currentSlot_ * MAX_QUERIES + entry.beginQuery);
+		}
+		s.stack.push_back(s.entries.size());
+		s.entries.push_back(entry);
+	}
+
+	void GpuTrace::endZone(vk::CommandBuffer commandBuffer) {
+		auto& s = slots_[currentSlot_];
+		if (s.stack.empty())
+			return;
+		auto& entry = s.entries[s.stack.back()];
+		s.stack.pop_back();
+		if (entry.beginQuery != INVALID_QUERY) {
+			entry.endQuery = s.queryCount++;
+			commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *queryPool_, currentSlot_ * MAX_QUERIES + entry.endQuery);
+		}
+	}
+
+	void GpuTrace::collect(Slot& slot, uint32_t slotIndex) {
+		if (slot.queryCount == 0)
+			return;
+
+		std::vector<uint64_t> timestamps(slot.queryCount, 0);
+		const auto result = device_.logical().getQueryPoolResults(*queryPool_,
+																  slotIndex * MAX_QUERIES,
+																  slot.queryCount,
+																  timestamps.size() * sizeof(uint64_t),
+																  timestamps.data(),
+																  sizeof(uint64_t),
+																  vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess)
+			return;
+
+		if (!calibrated_) {
+			// without calibrated timestamps assume the first zone started when recording started
+			calibrationTimestamp_ = timestamps[0] & timestampMask_;
+			calibrationTime_ = slot.recordTime;
+			calibrated_ = true;
+		}
+
+		for (const auto& entry : slot.entries) {
+			if (entry.beginQuery == INVALID_QUERY || entry.endQuery == INVALID_QUERY)
+				continue;
+			Trace::gpuEvent(entry.name, toCpuTime(timestamps[entry.beginQuery]), toCpuTime(timestamps[entry.endQuery]));
+		}
+	}
+
+	void GpuTrace::calibrate() {
+		framesSinceCalibration_ = 0;
+
+		vk::CalibratedTimestampInfoEXT calibratedTimestampInfo{};
+		calibratedTimestampInfo.setTimeDomain(vk::TimeDomainEXT::eDevice);
+
+		uint64_t timestamp = 0;
+		uint64_t maxDeviation = 0;
+
+		// the host clock is read around the query instead of through a host time domain, this way
+		// the result is in the Trace time base on every platform
+		const auto before = Trace::now();
+		const auto result = device_.logical().getCalibratedTimestampsEXT(1, &calibratedTimestampInfo, &timestamp, &maxDeviation);
+		const auto after = Trace::now();
+
+		if (result != vk::Result::eSuccess) {
+			Log_warn("failed to get calibrated timestamps. error {}", vk::to_string(result));
+			return;
+		}
+
+		calibrationTimestamp_ = timestamp & timestampMask_;
+		calibrationTime_ = before + (after - before) / 2;
+		calibrated_ = true;
+	}
+
+	int64_t GpuTrace::toCpuTime(uint64_t timestamp) const noexcept {
+		const auto ticks = ((timestamp & timestampMask_) - calibrationTimestamp_) & timestampMask_;
+		// timestamps taken before the calibration wrap around into the upper half of the range
+		const auto signedTicks = ticks > (timestampMask_ >> 1)
+			? static_cast<int64_t>(ticks) - static_cast<int64_t>(timestampMask_) - 1
+			: static_cast<int64_t>(ticks);
+		return calibrationTime_ + static_cast<int64_t>(static_cast<double>(signedTicks) * timestampPeriod_);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+#include "Trace.hpp"
+
+#define Trace_gpu_zone(gpuTrace, commandBuffer, name) fve::GpuTrace::Zone Trace_concat(gpuTraceZone, __LINE__){ gpuTrace, commandBuffer, name }
+
+namespace fve {
+
+	class Device;
+
+	// records gpu timestamps into a query pool slice per command buffer and forwards the resolved
+	// zones to the gpu track of Trace. gpu ticks are mapped onto the cpu time base through
+	// VK_EXT_calibrated_timestamps, or aligned to the time of recording when it is not supported
+	class GpuTrace final {
+	public:
+		class Zone final {
+		public:
+			explicit Zone(GpuTrace* gpuTrace, vk::CommandBuffer commandBuffer, const char* name) : gpuTrace_{ gpuTrace }, commandBuffer_{ commandBuffer } {
+				if (gpuTrace_)
+					gpuTrace_->beginZone(commandBuffer_, name);
+			}
+
+			~Zone() {
+				if (gpuTrace_)
+					gpuTrace_->endZone(commandBuffer_);
+			}
+
+			Zone(const Zone&) = delete;
+			Zone& operator=(const Zone&) = delete;
+
+		private:
+			GpuTrace* gpuTrace_;
+			vk::CommandBuffer commandBuffer_;
+		};
+
+		static constexpr uint32_t MAX_QUERIES = 64;
+		// calibration is repeated periodically to compensate for drift between the clocks
+		static constexpr uint32_t CALIBRATION_INTERVAL = 256;
+
+		explicit GpuTrace(Device& device, uint32_t slotCount);
+
+		~GpuTrace() noexcept;
+
+		GpuTrace(const GpuTrace&) = delete;
+		GpuTrace& operator=(const GpuTrace&) = delete;
+
+		// must be called right after the command buffer has been begun. the previous submission of
+		// the slot has to be complete, its timestamps are resolved before the queries are reset
+		void begin(vk::CommandBuffer commandBuffer, uint32_t slot);
+		// must be called right before the command buffer is ended
+		void end(vk::CommandBuffer commandBuffer);
+
+		void beginZone(vk::CommandBuffer commandBuffer, const char* name);
+		void endZone(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct Entry {
+			const char* name;
+			uint32_t beginQuery;
+			uint32_t endQuery;
+		};
+
+		struct Slot {
+			std::vector<Entry> entries;
+			std::vector<size_t> stack;
+			uint32_t queryCount = 0;
+			int64_t recordTime = 0;
+		};
+
+		void collect(Slot& slot, uint32_t slotIndex);
+		void calibrate();
+		int64_t toCpuTime(uint64_t timestamp) const noexcept;
+
+		Device& device_;
+		vk::UniqueQueryPool queryPool_;
+		std::vector<Slot> slots_;
+		uint32_t currentSlot_ = 0;
+		double timestampPeriod_ = 1.0;
+		uint64_t timestampMask_ = ~0ull;
+		bool calibratedTimestamps_ = false;
+		bool calibrated_ = false;
+		uint32_t framesSinceCalibration_ = 0;
+		// a pair of simultaneous readings of both clocks
+		uint64_t calibrationTimestamp_ = 0;
+		int64_t calibrationTime_ = 0;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "IterationBudget.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+	// budget value that makes the shader use its full iteration count
+	static constexpr uint32_t BUDGET_FULL = 0xffffffff;
+}
+
+namespace fve {
+
+	IterationBudget::IterationBudget(Device& device, std::shared_ptr<Shader> shader, vk::Extent2D extent) : device_{ device }, extent_{ extent } {
+		tilesX_ = (extent_.width + TILE_SIZE - 1) / TILE_SIZE;
+		tilesY_ = (extent_.height + TILE_SIZE - 1) / TILE_SIZE;
+
+		createBuffers();
+		createDescriptors();
+		createComputePipeline(shader);
+		resetBudgets();
+
+		if (!device_.features().fragmentStoresAndAtomics)
+			Log_warn("fragment stores are not supported, shaders that write iterations will fail to build");
+	}
+
+	IterationBudget::~IterationBudget() noexcept {
+	}
+
+	void IterationBudget::enable(bool enabled) noexcept {
+		if (enabled_ && !enabled)
+			reset_ = true;
+		enabled_ = enabled;
+	}
+
+	void IterationBudget::setView(const glm::vec2& center, float scale) noexcept {
+		if (center == center_ && scale == scale_)
+			return;
+		center_ = center;
+		scale_ = scale;
+		reset_ = true;
+	}
+
+	void IterationBudget::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSets_[current_], nullptr);
+	}
+
+	vk::Buffer IterationBudget::iterations(uint32_t index) const noexcept {
+		return iterations_[index]->buffer();
+	}
+
+	void IterationBudget::prepare(vk::CommandBuffer commandBuffer) {
+		current_ = 1 - current_;
+
+		if (reset_) {
+			// the previous render pass may still be reading the budgets
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+										  vk::PipelineStageFlagBits::eTransfer,
+										  {},
+										  memoryBarrier,
+										  nullptr,
+										  nullptr);
+
+			commandBuffer.fillBuffer(tiles_->buffer(), 0, VK_WHOLE_SIZE, BUDGET_FULL);
+			reset_ = false;
+		}
+
+		// budgets written by the previous frame's compute pass (or the fill above) and the history are
+		// read by the fragment shader, which also overwrites the iterations of two frames ago. the
+		// previous fragment shader wrote the history and read the buffer written now, without the
+		// compute pass in between when adaptive budgets are off
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+									  vk::PipelineStageFlagBits::eFragmentShader,
+									  {},
+									  memoryBarrier,
+									  nullptr,
+									  nullptr);
+	}
+
+	void IterationBudget::update(vk::CommandBuffer commandBuffer) {
+		if (!enabled())
+			return;
+
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+									  vk::PipelineStageFlagBits::eComputeShader,
+									  {},
+									  memoryBarrier,
+									  nullptr,
+									  nullptr);
+
+		PushConstant pushConstant{ extent_.width, extent_.height, frame_++ };
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline_);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, descriptorSets_[current_], nullptr);
+		commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+		commandBuffer.dispatch(tilesX_, tilesY_, 1);
+	}
+
+	void IterationBudget::createBuffers() {
+		tiles_ = std::make_unique<Buffer>(device_,
+										  sizeof(Tile),
+										  static_cast<vk::DeviceSize>(tilesX_) * tilesY_,
+										  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+										  vk::MemoryPropertyFlagBits::eDeviceLocal,
+										  "iteration budget tiles");
+
+		for (auto& iterations : iterations_) {
+			// cleared to zero, pixels without history are evaluated anyway
+			iterations = std::make_unique<Buffer>(device_,
+												  sizeof(uint32_t),
+												  static_cast<vk::DeviceSize>(extent_.width) * extent_.height,
+												  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+												  vk::MemoryPropertyFlagBits::eDeviceLocal,
+												  "iteration budget iterations");
+		}
+	}
+
+	void IterationBudget::createDescriptors() {
+		const auto stageFlags = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+
+		// 0 tiles, 1 iterations of the current frame, 2 iterations of the previous frame
+		std::array<vk::DescriptorSetLayoutBinding, 3> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].setBinding(i);
+			bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			bindings[i].setDescriptorCount(1);
+			bindings[i].setStageFlags(stageFlags);
+		}
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+
+		vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(bindings.size() * descriptorSets_.size()) };
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(static_cast<uint32_t>(descriptorSets_.size()));
+		descriptorPoolCreateInfo.setPoolSizes(poolSize);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			std::array<vk::DescriptorSetLayout, 2> setLayouts{ *descriptorSetLayout_, *descriptorSetLayout_ };
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(setLayouts);
+
+			const auto descriptorSets = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo);
+			std::copy(descriptorSets.begin(), descriptorSets.end(), descriptorSets_.begin());
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create iteration budget descriptors. error {}", err.what());
+			throw;
+		}
+
+		for (size_t i = 0; i < descriptorSets_.size(); ++i) {
+			vk::DescriptorBufferInfo tilesInfo{ tiles_->buffer(), 0, VK_WHOLE_SIZE };
+			vk::DescriptorBufferInfo iterationsInfo{ iterations_[i]->buffer(), 0, VK_WHOLE_SIZE };
+			vk::DescriptorBufferInfo historyInfo{ iterations_[1 - i]->buffer(), 0, VK_WHOLE_SIZE };
+
+			std::array<vk::WriteDescriptorSet, 3> writes{};
+			writes[0].setBufferInfo(tilesInfo);
+			writes[1].setBufferInfo(iterationsInfo);
+			writes[2].setBufferInfo(historyInfo);
+			for (uint32_t binding = 0; binding < writes.size(); ++binding) {
+				writes[binding].setDstSet(descriptorSets_[i]);
+				writes[binding].setDstBinding(binding);
+				writes[binding].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			}
+
+			device_.logical().updateDescriptorSets(writes, nullptr);
+		}
+	}
+
+	void IterationBudget::createComputePipeline(std::shared_ptr<Shader> shader) {
+		if (!shader) {
+			Log_warn("iteration budget shader is not loaded, every tile uses the full iteration count");
+			return;
+		}
+
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(PushConstant));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.setSetLayouts(*descriptorSetLayout_);
+		pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+
+		try {
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+			vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+			computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+			computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+			computePipeline_ = device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create iteration budget pipeline. error {}", err.what());
+			computePipeline_.reset();
+		}
+	}
+
+	void IterationBudget::resetBudgets() {
+		auto commandBuffer = device_.beginSingleTimeCommandBuffer();
+		commandBuffer.fillBuffer(tiles_->buffer(), 0, VK_WHOLE_SIZE, BUDGET_FULL);
+		for (const auto& iterations : iterations_)
+			commandBuffer.fillBuffer(iterations->buffer(), 0, VK_WHOLE_SIZE, 0);
+		device_.endSingleTimeCommandBuffer(commandBuffer);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <memory>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+
+	// feedback loop that gives every screen tile just enough iterations. the fragment shader writes
+	// the iterations each pixel used, after the render pass a compute pass reduces them per tile and
+	// stores the budget the tile gets in the next frame. see shaders/iteration_budget.comp
+	//
+	// the iterations are double buffered, the previous frame's field is bound as history so the
+	// fragment shader can reproject it instead of evaluating every pixel again
+	class IterationBudget final {
+	public:
+		static constexpr uint32_t TILE_SIZE = 16;
+
+		// per tile state shared with the shaders
+		struct Tile {
+			uint32_t budget;
+			uint32_t maxEscape;
+			uint32_t interior;
+			uint32_t pixels;
+		};
+
+		explicit IterationBudget(Device& device, std::shared_ptr<Shader> shader, vk::Extent2D extent);
+
+		~IterationBudget() noexcept;
+
+		IterationBudget(const IterationBudget&) = delete;
+		IterationBudget& operator=(const IterationBudget&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+		inline bool enabled() const noexcept { return enabled_ && computePipeline_; }
+		// when disabled every tile keeps the full iteration count
+		void enable(bool enabled) noexcept;
+		// the budgets belong to the view they were measured in, a moved view starts over at the full
+		// iteration count
+		void setView(const glm::vec2& center, float scale) noexcept;
+
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set = 0);
+
+		// iteration buffer 0 or 1, current() is the one this frame's render pass writes
+		vk::Buffer iterations(uint32_t index) const noexcept;
+		inline uint32_t current() const noexcept { return current_; }
+
+		// must be recorded before the render pass that reads the budgets. swaps the iteration
+		// buffers, the field written in the previous frame becomes the history
+		void prepare(vk::CommandBuffer commandBuffer);
+		// must be recorded after the render pass that writes the iterations
+		void update(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct PushConstant {
+			uint32_t width;
+			uint32_t height;
+			uint32_t frame;
+		};
+
+		void createBuffers();
+		void createDescriptors();
+		void createComputePipeline(std::shared_ptr<Shader> shader);
+		void resetBudgets();
+
+		Device& device_;
+		vk::Extent2D extent_;
+		uint32_t tilesX_ = 0;
+		uint32_t tilesY_ = 0;
+		uint32_t frame_ = 0;
+		bool enabled_ = true;
+		bool reset_ = false;
+		glm::vec2 center_{ 0.0f, 0.0f };
+		float scale_ = 0.0f;
+		std::unique_ptr<Buffer> tiles_ = nullptr;
+		uint32_t current_ = 0;
+		std::array<std::unique_ptr<Buffer>, 2> iterations_;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		// set i writes iterations_[i] and reads iterations_[1 - i] as history
+		std::array<vk::DescriptorSet, 2> descriptorSets_;
+		vk::UniquePipelineLayout pipelineLayout_;
+		vk::UniquePipeline computePipeline_;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "IterationHistogram.hpp"
+#include "IterationBudget.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+}
+
+namespace fve {
+
+	IterationHistogram::IterationHistogram(Device& device,
+										   std::shared_ptr<Shader> histogramShader,
+										   std::shared_ptr<Shader> subgroupShader,
+										   std::shared_ptr<Shader> scanShader,
+										   const IterationBudget& iterationBudget,
+										   vk::Extent2D extent,
+										   bool enabled)
+		:
+		device_{ device },
+		iterationBudget_{ iterationBudget },
+		extent_{ extent },
+		enabled_{ enabled }
+	{
+		createBuffers();
+		createDescriptors();
+
+		// the shaders colour linearly until the first distribution is written
+		auto commandBuffer = device_.beginSingleTimeCommandBuffer();
+		commandBuffer.fillBuffer(distribution_->buffer(), 0, VK_WHOLE_SIZE, 0);
+		device_.endSingleTimeCommandBuffer(commandBuffer);
+
+		if (!enabled_)
+			return;
+
+		const auto chain = device_.physical().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+		const auto& subgroup = chain.get<vk::PhysicalDeviceSubgroupProperties>();
+		const auto operations = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eVote | vk::SubgroupFeatureFlagBits::eBallot;
+		const bool subgroups = subgroupShader && (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) && (subgroup.supportedOperations & operations) == operations;
+		if (subgroups)
+			histogramShader = subgroupShader;
+
+		if (!histogramShader || !scanShader) {
+			Log_warn("histogram shaders are not loaded, escape counts are coloured linearly");
+			return;
+		}
+
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(PushConstant));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.setSetLayouts(*computeSetLayout_);
+		pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+
+		try {
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create histogram pipeline layout. error {}", err.what());
+			throw;
+		}
+
+		histogramPipeline_ = createComputePipeline(histogramShader);
+		scanPipeline_ = createComputePipeline(scanShader);
+		Log_info("histogram equalized colouring{}", subgroups ? " with subgroup operations" : "");
+	}
+
+	IterationHistogram::~IterationHistogram() noexcept {
+	}
+
+	void IterationHistogram::setCells(const std::vector<glm::vec4>& cells) {
+		if (cells.size() > MAX_CELLS)
+			Log_warn("{} mandelbrot cells, only the first {} are counted by the histogram", cells.size(), MAX_CELLS);
+		cellCount_ = static_cast<uint32_t>(std::min<size_t>(cells.size(), MAX_CELLS));
+		if (cellCount_ > 0)
+			cells_->write(cells.data(), cellCount_ * sizeof(glm::vec4), 0);
+	}
+
+	void IterationHistogram::setSteps(int32_t steps) noexcept {
+		steps_ = steps > 0 ? steps : DEFAULT_STEPS;
+	}
+
+	void IterationHistogram::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSet_, nullptr);
+	}
+
+	void IterationHistogram::update(vk::CommandBuffer commandBuffer) {
+		if (!enabled())
+			return;
+
+		// the render pass is done with the iterations and the distribution, the previous scan with the bins
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+										  vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+										  {},
+										  memoryBarrier,
+										  nullptr,
+										  nullptr);
+		}
+
+		commandBuffer.fillBuffer(bins_->buffer(), 0, VK_WHOLE_SIZE, 0);
+
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+		}
+
+		const PushConstant pushConstant{ extent_.width, extent_.height, cellCount_, static_cast<uint32_t>(steps_) };
+		const auto computeSet = computeSets_[iterationBudget_.current()];
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, computeSet, nullptr);
+		commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *histogramPipeline_);
+		commandBuffer.dispatch((extent_.width + BLOCK_SIZE - 1) / BLOCK_SIZE, (extent_.height + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+
+		{
+			vk::MemoryBarrier memoryBarrier{};
+			memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+			memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, nullptr, nullptr);
+		}
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *scanPipeline_);
+		commandBuffer.dispatch(1, 1, 1);
+
+		// read by the next frame's render pass
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, memoryBarrier, nullptr, nullptr);
+	}
+
+	void IterationHistogram::createBuffers() {
+		bins_ = std::make_unique<Buffer>(device_,
+										 sizeof(uint32_t),
+										 BINS,
+										 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+										 vk::MemoryPropertyFlagBits::eDeviceLocal,
+										 "histogram bins");
+
+		distribution_ = std::make_unique<Buffer>(device_,
+												 sizeof(uint32_t),
+												 BINS + 1,
+												 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+												 vk::MemoryPropertyFlagBits::eDeviceLocal,
+												 "histogram distribution");
+
+		cells_ = std::make_unique<Buffer>(device_,
+										  sizeof(glm::vec4),
+										  MAX_CELLS,
+										  vk::BufferUsageFlagBits::eStorageBuffer,
+										  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+										  "histogram cells");
+	}
+
+	void IterationHistogram::createDescriptors() {
+		// the render pass only reads the distribution
+		vk::DescriptorSetLayoutBinding distributionBinding{};
+		distributionBinding.setBinding(0);
+		distributionBinding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		distributionBinding.setDescriptorCount(1);
+		distributionBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+		// 0 iterations, 1 bins, 2 distribution, 3 cells
+		std::array<vk::DescriptorSetLayoutBinding, 4> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].setBinding(i);
+			bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			bindings[i].setDescriptorCount(1);
+			bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		}
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(distributionBinding);
+
+		vk::DescriptorSetLayoutCreateInfo computeSetLayoutCreateInfo{};
+		computeSetLayoutCreateInfo.setBindings(bindings);
+
+		const auto setCount = static_cast<uint32_t>(computeSets_.size()) + 1;
+		vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(bindings.size() * computeSets_.size()) + 1 };
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(setCount);
+		descriptorPoolCreateInfo.setPoolSizes(poolSize);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			computeSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(computeSetLayoutCreateInfo);
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			std::array<vk::DescriptorSetLayout, 3> setLayouts{ *descriptorSetLayout_, *computeSetLayout_, *computeSetLayout_ };
+
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(setLayouts);
+
+			const auto descriptorSets = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo);
+			descriptorSet_ = descriptorSets[0];
+			std::copy(descriptorSets.begin() + 1, descriptorSets.end(), computeSets_.begin());
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create histogram descriptors. error {}", err.what());
+			throw;
+		}
+
+		vk::DescriptorBufferInfo distributionInfo{ distribution_->buffer(), 0, VK_WHOLE_SIZE };
+		vk::WriteDescriptorSet distributionWrite{};
+		distributionWrite.setDstSet(descriptorSet_);
+		distributionWrite.setDstBinding(0);
+		distributionWrite.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		distributionWrite.setBufferInfo(distributionInfo);
+		device_.logical().updateDescriptorSets(distributionWrite, nullptr);
+
+		for (uint32_t i = 0; i < computeSets_.size(); ++i) {
+			std::array<vk::DescriptorBufferInfo, 4> infos{
+				vk::DescriptorBufferInfo{ iterationBudget_.iterations(i), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ bins_->buffer(), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ distribution_->buffer(), 0, VK_WHOLE_SIZE },
+				vk::DescriptorBufferInfo{ cells_->buffer(), 0, VK_WHOLE_SIZE }
+			};
+
+			std::array<vk::WriteDescriptorSet, 4> writes{};
+			for (uint32_t binding = 0; binding < writes.size(); ++binding) {
+				writes[binding].setDstSet(computeSets_[i]);
+				writes[binding].setDstBinding(binding);
+				writes[binding].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+				writes[binding].setBufferInfo(infos[binding]);
+			}
+
+			device_.logical().updateDescriptorSets(writes, nullptr);
+		}
+	}
+
+	vk::UniquePipeline IterationHistogram::createComputePipeline(std::shared_ptr<Shader> shader) {
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+
+		vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+		computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+		computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+		try {
+			return device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create histogram pipeline. error {}", err.what());
+		}
+		return {};
+	}
+
+}
\ No newline at end of file
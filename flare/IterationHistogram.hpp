@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+	class IterationBudget;
+
+	// histogram equalized colouring of mandelbrot.frag. after the render pass a compute pass counts
+	// the escape counts of the mandelbrot cells per bin, in shared memory per workgroup and with one
+	// atomic per subgroup where the pixels of a subgroup share their bin. a single workgroup then
+	// scans the bins into the share of the escaped pixels at or below every bin, which
+	// mandelbrot.frag maps the escape counts through. see shaders/histogram.comp and
+	// shaders/histogram_scan.comp
+	//
+	// like the iteration budget this is a feedback loop, a frame is coloured by the distribution of
+	// the frame before. until there is one the escape counts are scaled linearly
+	class IterationHistogram final {
+	public:
+		// HISTOGRAM_BINS of shaders/include/histogram.glsl
+		static constexpr uint32_t BINS = 2048;
+		// pixels per side counted by a workgroup
+		static constexpr uint32_t BLOCK_SIZE = 64;
+		// mandelbrot cells of a gallery beyond this are left out of the histogram
+		static constexpr uint32_t MAX_CELLS = 64;
+		// MAX_STEPS of mandelbrot.frag when the quality constant is not set
+		static constexpr int32_t DEFAULT_STEPS = 256;
+
+		// the subgroup variant is used when the device supports ballots and votes in compute shaders
+		explicit IterationHistogram(Device& device,
+									std::shared_ptr<Shader> histogramShader,
+									std::shared_ptr<Shader> subgroupShader,
+									std::shared_ptr<Shader> scanShader,
+									const IterationBudget& iterationBudget,
+									vk::Extent2D extent,
+									bool enabled);
+
+		~IterationHistogram() noexcept;
+
+		IterationHistogram(const IterationHistogram&) = delete;
+		IterationHistogram& operator=(const IterationHistogram&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+		inline bool enabled() const noexcept { return enabled_ && cellCount_ > 0 && histogramPipeline_ && scanPipeline_; }
+
+		// framebuffer areas drawn by mandelbrot.frag as offset xy and size zw, nothing else is counted
+		void setCells(const std::vector<glm::vec4>& cells);
+		// the step count of the frame the passes are recorded for
+		void setSteps(int32_t steps) noexcept;
+
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t set);
+
+		// must be recorded after the render pass, the iterations of this frame are counted
+		void update(vk::CommandBuffer commandBuffer);
+
+	private:
+		struct PushConstant {
+			uint32_t width;
+			uint32_t height;
+			uint32_t cellCount;
+			uint32_t steps;
+		};
+
+		void createBuffers();
+		void createDescriptors();
+		vk::UniquePipeline createComputePipeline(std::shared_ptr<Shader> shader);
+
+		Device& device_;
+		const IterationBudget& iterationBudget_;
+		vk::Extent2D extent_;
+		bool enabled_ = true;
+		uint32_t cellCount_ = 0;
+		int32_t steps_ = DEFAULT_STEPS;
+		std::unique_ptr<Buffer> bins_ = nullptr;
+		// count of the escaped pixels followed by the share at or below every bin
+		std::unique_ptr<Buffer> distribution_ = nullptr;
+		std::unique_ptr<Buffer> cells_ = nullptr;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorSetLayout computeSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		vk::DescriptorSet descriptorSet_;
+		// set i counts the iteration buffer i of the iteration budget
+		std::array<vk::DescriptorSet, 2> computeSets_;
+		vk::UniquePipelineLayout pipelineLayout_;
+		vk::UniquePipeline histogramPipeline_;
+		vk::UniquePipeline scanPipeline_;
+	};
+
+}
\ No newline at end of file
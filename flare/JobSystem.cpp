@@ -0,0 +1,304 @@
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+namespace {
+	// size and iterations of the mandelbrot rendered by the benchmark, rows per job and runs per
+	// thread count, the fastest run counts
+	static constexpr uint32_t BENCHMARK_SIZE = 1024;
+	static constexpr uint32_t BENCHMARK_ITERATIONS = 256;
+	static constexpr uint32_t BENCHMARK_GRAIN = 4;
+	static constexpr uint32_t BENCHMARK_RUNS = 3;
+
+	// the pool and the deque of the calling thread, set on workers only
+	thread_local const fve::JobSystem* currentJobSystem = nullptr;
+	thread_local uint32_t currentQueue = 0;
+
+	// escape-time iterations of every pixel of the row, summed
+	uint64_t mandelbrotRow(uint32_t row) noexcept {
+		const double y = (row + 0.5) / BENCHMARK_SIZE * 3.0 - 1.5;
+		uint64_t sum = 0;
+		for (uint32_t column = 0; column < BENCHMARK_SIZE; ++column) {
+			const double x = (column + 0.5) / BENCHMARK_SIZE * 3.0 - 2.25;
+			double zx = 0.0;
+			double zy = 0.0;
+			uint32_t i = 0;
+			for (; i < BENCHMARK_ITERATIONS && zx * zx + zy * zy <= 4.0; ++i) {
+				const double t = zx * zx - zy * zy + x;
+				zy = 2.0 * zx * zy + y;
+				zx = t;
+			}
+			sum += i;
+		}
+		return sum;
+	}
+}
+
+namespace fve {
+
+	JobSystem::JobSystem(uint32_t threadCount) {
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency();
+		// jobs that nobody waits for, like pipeline variants and texture decodes, need a worker
+		threadCount = std::max(2u, threadCount);
+
+		queues_.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; ++i)
+			queues_.push_back(std::make_unique<Queue>());
+
+		// deque 0 belongs to the calling thread
+		workers_.reserve(threadCount - 1);
+		for (uint32_t queue = 1; queue < threadCount; ++queue)
+			workers_.emplace_back(&JobSystem::work, this, queue);
+	}
+
+	JobSystem::~JobSystem() noexcept {
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto& worker : workers_)
+			worker.join();
+	}
+
+	void JobSystem::run(Counter& counter, Job job) {
+		{
+			std::lock_guard<std::mutex> lock{ counter.mutex_ };
+			counter.pending_.fetch_add(1, std::memory_order_relaxed);
+		}
+		schedule([this, &counter, job = std::move(job)]() { execute(counter, job); });
+	}
+
+	void JobSystem::then(Counter& after, Counter& counter, Job job) {
+		{
+			std::lock_guard<std::mutex> lock{ counter.mutex_ };
+			counter.pending_.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Job continuation = [this, &counter, job = std::move(job)]() { execute(counter, job); };
+		{
+			std::lock_guard<std::mutex> lock{ after.mutex_ };
+			if (after.pending_.load(std::memory_order_relaxed) != 0) {
+				after.continuations_.push_back(std::move(continuation));
+				return;
+			}
+		}
+		schedule(std::move(continuation));
+	}
+
+	void JobSystem::wait(Counter& counter) {
+		Trace_zone("wait jobs");
+
+		const auto queue = queueIndex();
+		while (!counter.done()) {
+			Job job;
+			if (take(queue, job))
+				job();
+			else
+				std::this_thread::yield();
+		}
+
+		// the last job may still hold the lock while the counter is already done
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock{ counter.mutex_ };
+			error = std::exchange(counter.error_, nullptr);
+		}
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	void JobSystem::parallelFor(uint32_t count, uint32_t grain, const Range& range) {
+		if (count == 0)
+			return;
+
+		Counter counter;
+		try {
+			split(counter, 0, count, std::max(1u, grain), range);
+		}
+		catch (...) {
+			fail(counter, std::current_exception());
+		}
+		wait(counter);
+	}
+
+	bool JobSystem::benchmark(uint32_t maxThreadCount) noexcept {
+		Trace_zone("benchmark jobs");
+
+		try {
+			if (maxThreadCount == 0)
+				maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+			std::vector<uint32_t> threadCounts;
+			for (uint32_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+				threadCounts.push_back(threadCount);
+			threadCounts.push_back(maxThreadCount);
+
+			double baseline = 0.0;
+			uint64_t expected = 0;
+			for (auto threadCount : threadCounts) {
+				// the baseline runs on the calling thread alone, a job system always has a worker
+				std::unique_ptr<JobSystem> jobs;
+				if (threadCount > 1)
+					jobs = std::make_unique<JobSystem>(threadCount);
+
+				double best = 0.0;
+				for (uint32_t run = 0; run < BENCHMARK_RUNS; ++run) {
+					std::vector<uint64_t> rows(BENCHMARK_SIZE);
+					const auto range = [&](uint32_t first, uint32_t last) {
+						for (uint32_t row = first; row < last; ++row)
+							rows[row] = mandelbrotRow(row);
+					};
+					const auto begin = Trace::now();
+					if (jobs)
+						jobs->parallelFor(BENCHMARK_SIZE, BENCHMARK_GRAIN, range);
+					else
+						range(0, BENCHMARK_SIZE);
+					const auto milliseconds = static_cast<double>(Trace::now() - begin) / 1e6;
+					best = run == 0 ? milliseconds : std::min(best, milliseconds);
+
+					// every thread count has to produce the same image
+					uint64_t sum = 0;
+					for (auto row : rows)
+						sum += row;
+					if (threadCount == 1 && run == 0) {
+						expected = sum;
+					}
+					else if (sum != expected) {
+						Log_error("failed to benchmark jobs. {} threads rendered a different image", threadCount);
+						return false;
+					}
+				}
+
+				if (threadCount == 1)
+					baseline = best;
+				const auto speedup = baseline / best;
+				Log_info("jobs benchmark {} threads {:.2f} ms, speedup {:.2f}, efficiency {:.0f}%",
+						 threadCount,
+						 best,
+						 speedup,
+						 speedup / threadCount * 100.0);
+			}
+			return true;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to benchmark jobs. error {}", ex.what());
+		}
+		return false;
+	}
+
+	void JobSystem::schedule(Job job) {
+		auto& queue = *queues_[queueIndex()];
+		{
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			queue.jobs.push_back(std::move(job));
+		}
+		queued_.fetch_add(1, std::memory_order_release);
+
+		// taking the lock orders the push before the check of a worker about to sleep
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+		}
+		wake_.notify_one();
+	}
+
+	bool JobSystem::take(uint32_t queue, Job& job) {
+		if (queued_.load(std::memory_order_acquire) == 0)
+			return false;
+
+		const auto queueCount = static_cast<uint32_t>(queues_.size());
+		for (uint32_t i = 0; i < queueCount; ++i) {
+			auto& victim = *queues_[(queue + i) % queueCount];
+			std::lock_guard<std::mutex> lock{ victim.mutex };
+			if (victim.jobs.empty())
+				continue;
+
+			// the own deque is used as a stack, the others as queues
+			if (i == 0) {
+				job = std::move(victim.jobs.back());
+				victim.jobs.pop_back();
+			}
+			else {
+				job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+			}
+			queued_.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	uint32_t JobSystem::queueIndex() const noexcept {
+		return currentJobSystem == this ? currentQueue : 0;
+	}
+
+	void JobSystem::execute(Counter& counter, const Job& job) noexcept {
+		try {
+			job();
+		}
+		catch (...) {
+			fail(counter, std::current_exception());
+		}
+
+		try {
+			finish(counter);
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to schedule job continuations. error {}", ex.what());
+		}
+	}
+
+	void JobSystem::finish(Counter& counter) {
+		std::vector<Job> continuations;
+		{
+			std::lock_guard<std::mutex> lock{ counter.mutex_ };
+			if (counter.pending_.load(std::memory_order_relaxed) == 1)
+				continuations.swap(counter.continuations_);
+			counter.pending_.fetch_sub(1, std::memory_order_release);
+		}
+		// the counter may be gone by now
+		for (auto& continuation : continuations)
+			schedule(std::move(continuation));
+	}
+
+	void JobSystem::split(Counter& counter, uint32_t begin, uint32_t end, uint32_t grain, const Range& range) {
+		// the upper halves are forked, the lowest one is processed right away
+		while (end - begin > grain) {
+			const auto middle = begin + (end - begin) / 2;
+			run(counter, [this, &counter, middle, end, grain, &range]() { split(counter, middle, end, grain, range); });
+			end = middle;
+		}
+		range(begin, end);
+	}
+
+	void JobSystem::fail(Counter& counter, std::exception_ptr error) noexcept {
+		std::lock_guard<std::mutex> lock{ counter.mutex_ };
+		if (!counter.error_)
+			counter.error_ = std::move(error);
+	}
+
+	void JobSystem::work(uint32_t queue) {
+		Trace::setThreadName("job " + std::to_string(queue));
+		currentJobSystem = this;
+		currentQueue = queue;
+
+		for (;;) {
+			Job job;
+			if (take(queue, job)) {
+				job();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			wake_.wait(lock, [this]() { return stop_ || queued_.load(std::memory_order_acquire) > 0; });
+			if (stop_ && queued_.load(std::memory_order_acquire) == 0)
+				return;
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace fve {
+
+	// work-stealing thread pool for the cpu work of the engine: shader compilation, pipeline creation,
+	// asset decoding and cpu fractal kernels. every thread has its own deque of jobs. a worker pushes
+	// and pops the jobs it forks at the back of its deque, so forked work stays on the thread whose
+	// cache holds its data, and steals from the front of the others once it runs dry. threads that are
+	// not workers schedule into the first deque and help out with any job while they wait.
+	// jobs are grouped by counters, which can be waited on (fork/join) or continued from (then).
+	// there is always at least one worker, so background jobs progress while nobody waits for them
+	class JobSystem final {
+	public:
+		using Job = std::function<void()>;
+		// processes [begin, end) of a parallel loop
+		using Range = std::function<void(uint32_t begin, uint32_t end)>;
+
+		// outstanding jobs of a group and the first error one of them threw. a counter has to outlive
+		// its jobs, which wait() guarantees
+		class Counter final {
+		public:
+			Counter() = default;
+
+			Counter(const Counter&) = delete;
+			Counter& operator=(const Counter&) = delete;
+
+			inline bool done() const noexcept { return pending_.load(std::memory_order_acquire) == 0; }
+
+		private:
+			friend class JobSystem;
+
+			std::atomic<uint32_t> pending_{ 0 };
+			std::mutex mutex_;
+			// scheduled once pending_ drops to zero
+			std::vector<Job> continuations_;
+			std::exception_ptr error_;
+		};
+
+		// threadCount 0 uses one thread per hardware thread. the calling thread counts as one of them,
+		// at least one worker is started whatever the count
+		explicit JobSystem(uint32_t threadCount = 0);
+
+		~JobSystem() noexcept;
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		inline uint32_t threadCount() const noexcept { return static_cast<uint32_t>(workers_.size()) + 1; }
+		// of the calling thread in [0, threadCount()), workers count from 1 and the threads that are not
+		// workers share 0. for per-thread resources of the jobs
+		inline uint32_t threadIndex() const noexcept { return queueIndex(); }
+
+		// counts the job on the counter until it returns
+		void run(Counter& counter, Job job);
+		// runs the job once every job of after is done, whether they failed or not. the job is
+		// counted on counter from now on
+		void then(Counter& after, Counter& counter, Job job);
+		// runs other jobs until the counter is done, then rethrows the first error of its jobs
+		void wait(Counter& counter);
+		// halves [0, count) until the halves are at most grain long, forking one of them every time
+		void parallelFor(uint32_t count, uint32_t grain, const Range& range);
+
+		// the result or the error of the function is left in the future. the job is counted on the
+		// counter, waiting for it with wait() runs other jobs meanwhile instead of blocking on the
+		// future. the owner of whatever the job uses has to wait before destroying it
+		template<typename Function>
+		std::future<std::invoke_result_t<Function>> async(Counter& counter, Function function) {
+			using Result = std::invoke_result_t<Function>;
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+			auto future = task->get_future();
+			run(counter, [task]() { (*task)(); });
+			return future;
+		}
+
+		// renders a mandelbrot on the cpu with 1 to maxThreadCount threads and logs the speedup of
+		// every thread count. 0 goes up to one thread per hardware thread
+		static bool benchmark(uint32_t maxThreadCount = 0) noexcept;
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		void schedule(Job job);
+		// pops the newest job of the own deque or steals the oldest of another
+		bool take(uint32_t queue, Job& job);
+		// deque of the calling thread, 0 for threads that are not workers
+		uint32_t queueIndex() const noexcept;
+		void execute(Counter& counter, const Job& job) noexcept;
+		void finish(Counter& counter);
+		void split(Counter& counter, uint32_t begin, uint32_t end, uint32_t grain, const Range& range);
+		static void fail(Counter& counter, std::exception_ptr error) noexcept;
+		void work(uint32_t queue);
+
+		// one per thread, the first one is shared by the threads that are not workers
+		std::vector<std::unique_ptr<Queue>> queues_;
+		// jobs in any deque, idle workers sleep while there are none
+		std::atomic<uint32_t> queued_{ 0 };
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		bool stop_ = false;
+		// joined in the destructor
+		std::vector<std::thread> workers_;
+	};
+
+}
\ No newline at end of file
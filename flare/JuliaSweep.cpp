@@ -0,0 +1,350 @@
+#include "JuliaSweep.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Shader.hpp"
+#include "Pipeline.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+	static constexpr const char* SHADER_ENTRY_POINT = "main";
+	static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Unorm;
+	// quality knob of julia_sweep.comp, like the bundled fragment shaders
+	static constexpr uint32_t STEPS_CONSTANT = 0;
+}
+
+namespace fve {
+
+	JuliaSweep::JuliaSweep(Device& device, std::shared_ptr<Shader> shader, uint32_t size, uint32_t layers, int32_t steps)
+		:
+		device_{ device },
+		size_{ std::max(1u, size) },
+		layers_{ std::clamp(layers, 1u, device.physical().getProperties().limits.maxImageArrayLayers) },
+		layerSize_{ static_cast<vk::DeviceSize>(size_) * size_ * 4 }
+	{
+		if (!shader)
+			throw std::runtime_error{ "failed to create julia sweep. the sweep shader is not loaded" };
+
+		createBatches();
+		createDescriptors();
+		createComputePipeline(shader, steps);
+	}
+
+	JuliaSweep::~JuliaSweep() noexcept {
+		for (auto& batch : batches_) {
+			const auto fence = *batch.fence;
+			if (batch.submitted)
+				(void)device_.logical().waitForFences(1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			if (batch.commandBuffer)
+				device_.logical().freeCommandBuffers(device_.commandPool(), batch.commandBuffer);
+			device_.logical().destroyImageView(batch.view);
+			device_.logical().destroyImage(batch.image);
+			device_.freeMemory(batch.memory);
+		}
+	}
+
+	bool JuliaSweep::parse(const std::string& filepath, std::vector<glm::vec2>& parameters) noexcept {
+		try {
+			std::ifstream file{ filepath };
+			if (!file.is_open()) {
+				Log_error("failed to open parameters {} for reading", filepath);
+				return false;
+			}
+
+			std::string line;
+			for (size_t number = 1; std::getline(file, line); ++number) {
+				if (line.empty() || line[0] == '#')
+					continue;
+				std::istringstream stream{ line };
+				glm::vec2 c{};
+				if (!(stream >> c.x >> c.y)) {
+					Log_warn("skip line {} of parameters {}, expected two numbers", number, filepath);
+					continue;
+				}
+				parameters.push_back(c);
+			}
+			return true;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to read parameters {}. error {}", filepath, ex.what());
+		}
+		return false;
+	}
+
+	bool JuliaSweep::run(const std::vector<glm::vec2>& parameters, const std::string& filepath) noexcept {
+		Trace_zone("julia sweep");
+
+		try {
+			std::ofstream file{ filepath, std::ios::out | std::ios::binary | std::ios::trunc };
+			if (!file.is_open()) {
+				Log_error("failed to open sweep {} for writing", filepath);
+				return false;
+			}
+
+			const auto count = static_cast<uint32_t>(parameters.size());
+			const Header header{ MAGIC, VERSION, size_, count };
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(reinterpret_cast<const char*>(parameters.data()), parameters.size() * sizeof(glm::vec2));
+
+			const auto begin = Trace::now();
+			std::vector<char> pixels(layers_ * layerSize_);
+			uint32_t next = 0;
+			uint32_t submits = 0;
+			// batches are reused round robin, which keeps the images in the order of the parameters
+			for (size_t slot = 0; next < count || std::any_of(batches_.begin(), batches_.end(), [](const auto& b) { return b.submitted; }); slot = (slot + 1) % BATCHES_IN_FLIGHT) {
+				auto& batch = batches_[slot];
+				const auto fence = *batch.fence;
+				if (batch.submitted) {
+					Trace_zone("read back");
+					if (device_.logical().waitForFences(1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+						throw std::runtime_error{ "failed to wait for fence" };
+					batch.submitted = false;
+
+					const auto size = batch.count * layerSize_;
+					if (!batch.readback->read(pixels.data(), size, 0))
+						return false;
+					file.write(pixels.data(), static_cast<std::streamsize>(size));
+				}
+
+				if (next == count)
+					continue;
+
+				batch.first = next;
+				batch.count = std::min(layers_, count - next);
+				if (!batch.parameters->write(parameters.data() + next, batch.count * sizeof(glm::vec2), 0))
+					return false;
+				record(batch);
+
+				vk::SubmitInfo submitInfo{};
+				submitInfo.setCommandBuffers(batch.commandBuffer);
+				if (device_.logical().resetFences(1, &fence) != vk::Result::eSuccess)
+					throw std::runtime_error{ "failed to reset fence" };
+				device_.graphicsQueue().submit(submitInfo, fence);
+				batch.submitted = true;
+				next += batch.count;
+				++submits;
+			}
+
+			if (!file)
+				throw std::runtime_error{ "failed to write the images" };
+
+			const auto seconds = static_cast<double>(Trace::now() - begin) / 1e9;
+			Log_info("julia sweep rendered {} images of {}x{} in {} submits, {:.3f} s, {:.0f} images/s",
+					 count,
+					 size_,
+					 size_,
+					 submits,
+					 seconds,
+					 seconds > 0.0 ? count / seconds : 0.0);
+			return true;
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to run julia sweep. error {}", err.what());
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to run julia sweep. error {}", ex.what());
+		}
+		return false;
+	}
+
+	void JuliaSweep::createBatches() {
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.setImageType(vk::ImageType::e2D);
+		imageCreateInfo.setFormat(FORMAT);
+		imageCreateInfo.setExtent({ size_, size_, 1 });
+		imageCreateInfo.setMipLevels(1);
+		imageCreateInfo.setArrayLayers(layers_);
+		imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+		imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+		imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc);
+		imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+
+		vk::CommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.setCommandPool(device_.commandPool());
+		commandBufferAllocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+		commandBufferAllocateInfo.setCommandBufferCount(1);
+
+		for (auto& batch : batches_) {
+			std::tie(batch.image, batch.memory) = device_.createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, "julia sweep images");
+			if (!batch.image)
+				throw std::runtime_error{ "failed to create julia sweep image" };
+
+			vk::ImageViewCreateInfo imageViewCreateInfo{};
+			imageViewCreateInfo.setImage(batch.image);
+			imageViewCreateInfo.setViewType(vk::ImageViewType::e2DArray);
+			imageViewCreateInfo.setFormat(FORMAT);
+			imageViewCreateInfo.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, layers_ });
+
+			batch.parameters = std::make_unique<Buffer>(device_,
+														sizeof(glm::vec2),
+														layers_,
+														vk::BufferUsageFlagBits::eStorageBuffer,
+														vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+														"julia sweep parameters");
+			batch.readback = std::make_unique<Buffer>(device_,
+													  layerSize_,
+													  layers_,
+													  vk::BufferUsageFlagBits::eTransferDst,
+													  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+													  "julia sweep readback");
+
+			try {
+				batch.view = device_.logical().createImageView(imageViewCreateInfo);
+				batch.commandBuffer = device_.logical().allocateCommandBuffers(commandBufferAllocateInfo).front();
+				batch.fence = device_.logical().createFenceUnique({});
+			}
+			catch (const vk::SystemError& err) {
+				Log_error("failed to create julia sweep batch. error {}", err.what());
+				throw;
+			}
+		}
+	}
+
+	void JuliaSweep::createDescriptors() {
+		// 0 images, 1 parameters
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eStorageImage);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+
+		const std::array<vk::DescriptorPoolSize, 2> poolSizes{
+			vk::DescriptorPoolSize{ vk::DescriptorType::eStorageImage, BATCHES_IN_FLIGHT },
+			vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, BATCHES_IN_FLIGHT }
+		};
+
+		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.setMaxSets(BATCHES_IN_FLIGHT);
+		descriptorPoolCreateInfo.setPoolSizes(poolSizes);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+			descriptorPool_ = device_.logical().createDescriptorPoolUnique(descriptorPoolCreateInfo);
+
+			const std::array<vk::DescriptorSetLayout, BATCHES_IN_FLIGHT> layouts{ *descriptorSetLayout_, *descriptorSetLayout_ };
+			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+			descriptorSetAllocateInfo.setDescriptorPool(*descriptorPool_);
+			descriptorSetAllocateInfo.setSetLayouts(layouts);
+
+			const auto descriptorSets = device_.logical().allocateDescriptorSets(descriptorSetAllocateInfo);
+			for (size_t i = 0; i < batches_.size(); ++i)
+				batches_[i].descriptorSet = descriptorSets[i];
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create julia sweep descriptors. error {}", err.what());
+			throw;
+		}
+
+		for (const auto& batch : batches_) {
+			vk::DescriptorImageInfo imageInfo{ nullptr, batch.view, vk::ImageLayout::eGeneral };
+			vk::DescriptorBufferInfo parametersInfo{ batch.parameters->buffer(), 0, VK_WHOLE_SIZE };
+
+			std::array<vk::WriteDescriptorSet, 2> writes{};
+			writes[0].setDstSet(batch.descriptorSet);
+			writes[0].setDstBinding(0);
+			writes[0].setDescriptorType(vk::DescriptorType::eStorageImage);
+			writes[0].setImageInfo(imageInfo);
+			writes[1].setDstSet(batch.descriptorSet);
+			writes[1].setDstBinding(1);
+			writes[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			writes[1].setBufferInfo(parametersInfo);
+
+			device_.logical().updateDescriptorSets(writes, nullptr);
+		}
+	}
+
+	void JuliaSweep::createComputePipeline(std::shared_ptr<Shader> shader, int32_t steps) {
+		vk::PushConstantRange pushConstantRange{};
+		pushConstantRange.setOffset(0);
+		pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstantRange.setSize(sizeof(PushConstant));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+		pipelineLayoutCreateInfo.setSetLayouts(*descriptorSetLayout_);
+		pipelineLayoutCreateInfo.setPushConstantRanges(pushConstantRange);
+
+		Pipeline::Specialization specialization{};
+		if (steps > 0)
+			specialization.set(STEPS_CONSTANT, steps);
+		const auto specializationInfo = specialization.info();
+
+		vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
+		shaderStageCreateInfo.setModule(shader->shaderModule());
+		shaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+		shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+		shaderStageCreateInfo.setPSpecializationInfo(&specializationInfo);
+
+		try {
+			pipelineLayout_ = device_.logical().createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+			vk::ComputePipelineCreateInfo computePipelineCreateInfo{};
+			computePipelineCreateInfo.setStage(shaderStageCreateInfo);
+			computePipelineCreateInfo.setLayout(*pipelineLayout_);
+
+			computePipeline_ = device_.logical().createComputePipelineUnique(nullptr, computePipelineCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create julia sweep pipeline. error {}", err.what());
+			throw;
+		}
+	}
+
+	void JuliaSweep::record(Batch& batch) {
+		auto commandBuffer = batch.commandBuffer;
+		commandBuffer.reset();
+
+		vk::CommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		commandBuffer.begin(commandBufferBeginInfo);
+
+		// the previous contents were copied out before the fence signaled
+		vk::ImageMemoryBarrier barrier{};
+		barrier.setImage(batch.image);
+		barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, batch.count });
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eGeneral);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, barrier);
+
+		const PushConstant pushConstant{ size_, batch.count, VIEW_SCALE };
+		const auto groups = (size_ + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline_);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout_, 0, batch.descriptorSet, nullptr);
+		commandBuffer.pushConstants(*pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+		commandBuffer.dispatch(groups, groups, batch.count);
+
+		barrier.setOldLayout(vk::ImageLayout::eGeneral);
+		barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+		// every layer lands tightly packed after the previous one
+		vk::BufferImageCopy region{};
+		region.setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, batch.count });
+		region.setImageExtent({ size_, size_, 1 });
+		commandBuffer.copyImageToBuffer(batch.image, vk::ImageLayout::eTransferSrcOptimal, batch.readback->buffer(), region);
+
+		vk::MemoryBarrier memoryBarrier{};
+		memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, memoryBarrier, nullptr, nullptr);
+
+		commandBuffer.end();
+	}
+
+}
\ No newline at end of file
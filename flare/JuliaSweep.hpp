@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+	class Shader;
+
+	// renders julia sets for long lists of c values without a window. every submit renders a batch
+	// of small images into the layers of a 2d array image, one layer per c taken from a storage
+	// buffer, and copies the whole array into a readback buffer. two batches are in flight, so the
+	// gpu renders the next one while the previous is written to disk. see shaders/julia_sweep.comp
+	//
+	// the output is a header, the c values as float pairs and the rgba8 images in the same order
+	class JuliaSweep final {
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 8;
+		static constexpr uint32_t BATCHES_IN_FLIGHT = 2;
+		// half the side of the square of the plane every image covers
+		static constexpr float VIEW_SCALE = 1.6f;
+
+		// 'FLRJ'
+		static constexpr uint32_t MAGIC = 0x4a524c46;
+		static constexpr uint32_t VERSION = 1;
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t size;
+			uint32_t count;
+		};
+
+		// steps of 0 keep the default of the shader
+		explicit JuliaSweep(Device& device, std::shared_ptr<Shader> shader, uint32_t size, uint32_t layers, int32_t steps = 0);
+
+		~JuliaSweep() noexcept;
+
+		JuliaSweep(const JuliaSweep&) = delete;
+		JuliaSweep& operator=(const JuliaSweep&) = delete;
+
+		// one c per line as real and imaginary part, lines starting with # are skipped
+		static bool parse(const std::string& filepath, std::vector<glm::vec2>& parameters) noexcept;
+
+		bool run(const std::vector<glm::vec2>& parameters, const std::string& filepath) noexcept;
+
+	private:
+		struct PushConstant {
+			uint32_t size;
+			uint32_t count;
+			float scale;
+		};
+
+		struct Batch {
+			vk::Image image;
+			vk::DeviceMemory memory;
+			vk::ImageView view;
+			std::unique_ptr<Buffer> parameters;
+			std::unique_ptr<Buffer> readback;
+			vk::DescriptorSet descriptorSet;
+			vk::CommandBuffer commandBuffer;
+			vk::UniqueFence fence;
+			uint32_t first = 0;
+			uint32_t count = 0;
+			bool submitted = false;
+		};
+
+		void createBatches();
+		void createDescriptors();
+		void createComputePipeline(std::shared_ptr<Shader> shader, int32_t steps);
+		void record(Batch& batch);
+
+		Device& device_;
+		uint32_t size_;
+		uint32_t layers_;
+		vk::DeviceSize layerSize_;
+		std::array<Batch, BATCHES_IN_FLIGHT> batches_;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		vk::UniqueDescriptorPool descriptorPool_;
+		vk::UniquePipelineLayout pipelineLayout_;
+		vk::UniquePipeline computePipeline_;
+	};
+
+}
\ No newline at end of file
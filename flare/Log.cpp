@@ -1,5 +1,6 @@
 #include "Log.hpp"
 
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/daily_file_sink.h>
 
@@ -7,6 +8,7 @@ namespace fve {
 
 	std::mutex Log::mutex_;
 	std::unordered_map<std::string, std::shared_ptr<spdlog::logger>> Log::loggers_;
+	std::shared_ptr<spdlog::details::thread_pool> Log::threadPool_;
 
 	std::shared_ptr<spdlog::logger> Log::get(const std::string& name) {
 		{
@@ -18,25 +20,27 @@ namespace fve {
 	}
 
 	std::shared_ptr<spdlog::logger> Log::create(const std::string& name) {
-		{
-			std::lock_guard<std::mutex> lock{ mutex_ };
-			if (auto it = loggers_.find(name); it != loggers_.end())
-				return it->second;
-		}
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		if (auto it = loggers_.find(name); it != loggers_.end())
+			return it->second;
+		// all loggers share a single worker thread, the sinks are only touched from it
+		if (!threadPool_)
+			threadPool_ = std::make_shared<spdlog::details::thread_pool>(QUEUE_SIZE, THREAD_COUNT);
 		const std::string pattern = "%^[%Y-%m-%d %H:%M:%S.%e][thread %t][%n][%l]: %v%$";
-		auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+		auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_st>();
 		console_sink->set_color_mode(spdlog::color_mode::always);
 		console_sink->set_level(spdlog::level::trace);
 		console_sink->set_pattern(pattern);
-		auto file_sink = std::make_shared<spdlog::sinks::daily_file_sink_mt>("flare.log", 23, 59);
+		auto file_sink = std::make_shared<spdlog::sinks::daily_file_sink_st>("flare.log", 23, 59);
 		file_sink->set_level(spdlog::level::trace);
 		file_sink->set_pattern(pattern);
-		auto logger = std::shared_ptr<spdlog::logger>(new spdlog::logger{ name, { console_sink, file_sink } });
-		logger->set_level(spdlog::level::trace);
-		{
-			std::lock_guard<std::mutex> lock{ mutex_ };
-			loggers_.insert({ name, logger });
-		}
+		auto logger = std::make_shared<spdlog::async_logger>(name,
+															 spdlog::sinks_init_list{ console_sink, file_sink },
+															 threadPool_,
+															 spdlog::async_overflow_policy::overrun_oldest);
+		logger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+		logger->flush_on(spdlog::level::err);
+		loggers_.insert({ name, logger });
 		return logger;
 	}
 
@@ -46,4 +50,13 @@ namespace fve {
 			loggers_.erase(it);
 	}
 
+	void Log::shutdown() noexcept {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (auto& [name, logger] : loggers_)
+			logger->flush();
+		// the pool joins its worker after draining the queue. call sites keep their cached handles,
+		// anything logged after this point is reported by spdlog's error handler and dropped
+		threadPool_.reset();
+	}
+
 }
\ No newline at end of file
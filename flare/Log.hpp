@@ -7,21 +7,52 @@
 #include <string>
 #include <unordered_map>
 
-#define Log_info(format, ...) { fve::Log::log("flare", fve::Log::Level::Info, format, __VA_ARGS__); }
-#define Log_warn(format, ...) { fve::Log::log("flare", fve::Log::Level::Warn, format, __VA_ARGS__); }
-#define Log_error(format, ...) { fve::Log::log("flare", fve::Log::Level::Error, format, __VA_ARGS__); }
-#define Log_debug(format, ...) { fve::Log::log("flare", fve::Log::Level::Debug, format, __VA_ARGS__); }
+namespace spdlog::details {
+	class thread_pool;
+}
+
+// every call site caches its own logger handle in a function local static, so the registry is only
+// touched once per call site. format strings are checked at compile time and the arguments are not
+// evaluated at all when the level is disabled. levels below SPDLOG_ACTIVE_LEVEL compile to nothing
+#define Log_call(level, format, ...) \
+	do { \
+		static const auto callSiteLogger = fve::Log::get("flare"); \
+		if (callSiteLogger->should_log(level)) \
+			callSiteLogger->log(level, FMT_STRING(format), ##__VA_ARGS__); \
+	} while (false)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define Log_debug(format, ...) Log_call(spdlog::level::debug, format, ##__VA_ARGS__)
+#else
+#define Log_debug(format, ...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define Log_info(format, ...) Log_call(spdlog::level::info, format, ##__VA_ARGS__)
+#else
+#define Log_info(format, ...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define Log_warn(format, ...) Log_call(spdlog::level::warn, format, ##__VA_ARGS__)
+#else
+#define Log_warn(format, ...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define Log_error(format, ...) Log_call(spdlog::level::err, format, ##__VA_ARGS__)
+#else
+#define Log_error(format, ...) (void)0
+#endif
 
 namespace fve {
 
 	class Log {
 	public:
-		enum class Level : uint8_t {
-			Debug,
-			Info,
-			Warn,
-			Error
-		};
+		// bounded queue of the async thread pool. when it is full the oldest message is dropped
+		// instead of blocking the caller, the frame loop must never wait for the sinks
+		static constexpr size_t QUEUE_SIZE = 8192;
+		static constexpr size_t THREAD_COUNT = 1;
 
 		Log() = delete;
 		~Log() = delete;
@@ -33,32 +64,24 @@ namespace fve {
 		static std::shared_ptr<spdlog::logger> create(const std::string& name);
 		static void destroy(const std::string& name);
 
-		template<typename ... Args>
-		static void log(const std::string& name, Level level, const std::string& format, Args&& ... args) {
-			switch (level) {
-			case Level::Debug: {
-#ifdef _DEBUG
-				get(name)->debug(format, std::forward<Args>(args)...);
-#else
-				// doing nothing
-#endif
-				break;
-			}
-			case Level::Info:
-				get(name)->info(format, std::forward<Args>(args)...);
-				break;
-			case Level::Warn:
-				get(name)->warn(format, std::forward<Args>(args)...);
-				break;
-			case Level::Error:
-				get(name)->error(format, std::forward<Args>(args)...);
-				break;
-			}
-		}
+		// flushes pending messages and stops the async thread pool
+		static void shutdown() noexcept;
+
+		// shuts the log down when destroyed. an owner declares it before everything that may log
+		// from its destructor, so those messages are still written
+		class Guard final {
+		public:
+			Guard() = default;
+			~Guard() noexcept { shutdown(); }
+
+			Guard(const Guard&) = delete;
+			Guard& operator=(const Guard&) = delete;
+		};
 
 	private:
 		static std::mutex mutex_;
 		static std::unordered_map<std::string, std::shared_ptr<spdlog::logger>> loggers_;
+		static std::shared_ptr<spdlog::details::thread_pool> threadPool_;
 
 	};
 
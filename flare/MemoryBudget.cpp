@@ -0,0 +1,172 @@
+#include "MemoryBudget.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
+namespace {
+	// the warning of a heap is rearmed once its usage falls this far below the threshold
+	static constexpr double WARNING_HYSTERESIS = 0.05;
+
+	double megabytes(vk::DeviceSize bytes) noexcept {
+		return static_cast<double>(bytes) / (1 << 20);
+	}
+}
+
+namespace fve {
+
+	MemoryBudget::MemoryBudget(vk::PhysicalDevice physical, bool extension) : physical_{ physical }, extension_{ extension } {
+		const auto properties = physical_.getMemoryProperties();
+		for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
+			typeHeaps_.push_back(properties.memoryTypes[i].heapIndex);
+
+		heaps_.resize(properties.memoryHeapCount);
+		for (uint32_t i = 0; i < properties.memoryHeapCount; ++i) {
+			heaps_[i].size = properties.memoryHeaps[i].size;
+			heaps_[i].budget = properties.memoryHeaps[i].size;
+			heaps_[i].deviceLocal = static_cast<bool>(properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+		}
+
+		if (!extension_)
+			Log_info("{} is not supported, memory budgets are the heap sizes", VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		update();
+	}
+
+	MemoryBudget::~MemoryBudget() noexcept {
+	}
+
+	bool MemoryBudget::add(vk::DeviceMemory memory, const char* tag, vk::DeviceSize size, uint32_t memoryTypeIndex) {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		if (limit_ != 0 && allocated_ + size > limit_) {
+			Log_error("failed to allocate {:.1f} MB for {}. the limit of {:.1f} MB would be exceeded, {:.1f} MB are allocated",
+					  megabytes(size),
+					  tag,
+					  megabytes(limit_),
+					  megabytes(allocated_));
+			return false;
+		}
+
+		const auto heapIndex = typeHeaps_.at(memoryTypeIndex);
+		allocations_[static_cast<VkDeviceMemory>(memory)] = { tag, size, heapIndex };
+
+		auto& heap = heaps_[heapIndex];
+		heap.allocated += size;
+		heap.peak = std::max(heap.peak, heap.allocated);
+		allocated_ += size;
+		peak_ = std::max(peak_, allocated_);
+		return true;
+	}
+
+	void MemoryBudget::remove(vk::DeviceMemory memory) noexcept {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const auto it = allocations_.find(static_cast<VkDeviceMemory>(memory));
+		if (it == allocations_.end())
+			return;
+
+		heaps_[it->second.heap].allocated -= it->second.size;
+		allocated_ -= it->second.size;
+		allocations_.erase(it);
+	}
+
+	void MemoryBudget::update() {
+		Trace_zone("memory budget");
+
+		if (!extension_) {
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (uint32_t i = 0; i < heaps_.size(); ++i)
+				check(heaps_[i], i, heaps_[i].allocated, heaps_[i].size);
+		}
+		else {
+			const auto chain = physical_.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+			const auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (uint32_t i = 0; i < heaps_.size(); ++i)
+				check(heaps_[i], i, budget.heapUsage[i], budget.heapBudget[i]);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		if (limit_ == 0)
+			return;
+		const auto used = static_cast<double>(allocated_) / limit_;
+		if (!limitWarned_ && used > WARNING_THRESHOLD)
+			Log_warn("device memory at {:.1f} of the {:.1f} MB limit", megabytes(allocated_), megabytes(limit_));
+		if (used > WARNING_THRESHOLD)
+			limitWarned_ = true;
+		else if (used < WARNING_THRESHOLD - WARNING_HYSTERESIS)
+			limitWarned_ = false;
+	}
+
+	std::vector<MemoryBudget::Heap> MemoryBudget::heaps() const {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return heaps_;
+	}
+
+	vk::DeviceSize MemoryBudget::allocated() const noexcept {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return allocated_;
+	}
+
+	void MemoryBudget::log() const {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+
+		Log_info("device memory {:.1f} MB in {} allocations, peak {:.1f} MB, limit {}",
+				 megabytes(allocated_),
+				 allocations_.size(),
+				 megabytes(peak_),
+				 limit_ != 0 ? fmt::format("{:.1f} MB", megabytes(limit_)) : "none");
+
+		for (uint32_t i = 0; i < heaps_.size(); ++i) {
+			const auto& heap = heaps_[i];
+			Log_info("heap {}{} {:.1f} MB allocated, peak {:.1f} MB, process uses {:.1f} of {:.1f} MB budget, {:.1f} MB heap",
+					 i,
+					 heap.deviceLocal ? " device local" : "",
+					 megabytes(heap.allocated),
+					 megabytes(heap.peak),
+					 megabytes(heap.usage),
+					 megabytes(heap.budget),
+					 megabytes(heap.size));
+		}
+
+		struct Tag {
+			std::string name;
+			uint32_t heap;
+			size_t count = 0;
+			vk::DeviceSize size = 0;
+		};
+		std::vector<Tag> tags;
+		for (const auto& [memory, allocation] : allocations_) {
+			auto it = std::find_if(tags.begin(), tags.end(), [&](const Tag& tag) {
+				return tag.name == allocation.tag && tag.heap == allocation.heap;
+			});
+			if (it == tags.end())
+				it = tags.insert(tags.end(), Tag{ allocation.tag, allocation.heap });
+			++it->count;
+			it->size += allocation.size;
+		}
+		std::sort(tags.begin(), tags.end(), [](const Tag& a, const Tag& b) { return a.size > b.size; });
+		for (const auto& tag : tags)
+			Log_info("  {} on heap {}, {} allocations {:.2f} MB", tag.name, tag.heap, tag.count, megabytes(tag.size));
+	}
+
+	void MemoryBudget::check(Heap& heap, uint32_t index, vk::DeviceSize usage, vk::DeviceSize budget) noexcept {
+		heap.usage = usage;
+		heap.budget = budget;
+		if (budget == 0)
+			return;
+
+		const auto used = static_cast<double>(usage) / budget;
+		if (!heap.warned && used > WARNING_THRESHOLD) {
+			Log_warn("memory heap {} at {:.1f} of its {:.1f} MB budget, flare allocated {:.1f} MB",
+					 index,
+					 megabytes(usage),
+					 megabytes(budget),
+					 megabytes(heap.allocated));
+		}
+		if (used > WARNING_THRESHOLD)
+			heap.warned = true;
+		else if (used < WARNING_THRESHOLD - WARNING_HYSTERESIS)
+			heap.warned = false;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fve {
+
+	// registry of every device memory allocation of flare, with its tag, size and heap, next to the
+	// budget of every memory heap. the budget and the usage of the process come from
+	// VK_EXT_memory_budget when it is supported, otherwise the heap size stands in for the budget and
+	// only the allocations of flare count as usage. an optional limit caps the memory of this
+	// instance, allocations beyond it fail. allocations are registered from any thread
+	class MemoryBudget final {
+	public:
+		struct Heap {
+			vk::DeviceSize size = 0;
+			vk::DeviceSize budget = 0;
+			// of the whole process, drivers and other apis included
+			vk::DeviceSize usage = 0;
+			// registered by flare
+			vk::DeviceSize allocated = 0;
+			vk::DeviceSize peak = 0;
+			bool deviceLocal = false;
+			// set above the warning threshold, cleared a little below it
+			bool warned = false;
+		};
+
+		// fraction of the budget or the limit above which a warning is logged
+		static constexpr double WARNING_THRESHOLD = 0.9;
+
+		explicit MemoryBudget(vk::PhysicalDevice physical, bool extension);
+
+		~MemoryBudget() noexcept;
+
+		MemoryBudget(const MemoryBudget&) = delete;
+		MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+		inline bool extension() const noexcept { return extension_; }
+		// bytes of all registered allocations, 0 disables the limit
+		inline void setLimit(vk::DeviceSize limit) noexcept { limit_ = limit; }
+		inline vk::DeviceSize limit() const noexcept { return limit_; }
+
+		// false, and nothing is registered, when the allocation would exceed the limit
+		bool add(vk::DeviceMemory memory, const char* tag, vk::DeviceSize size, uint32_t memoryTypeIndex);
+		void remove(vk::DeviceMemory memory) noexcept;
+
+		// queries the budget of every heap, called once per frame. warns once a heap nears its
+		// budget or the instance nears the limit
+		void update();
+
+		std::vector<Heap> heaps() const;
+		vk::DeviceSize allocated() const noexcept;
+
+		// logs the heaps and the allocations summed per tag, largest first
+		void log() const;
+
+	private:
+		struct Allocation {
+			std::string tag;
+			vk::DeviceSize size;
+			uint32_t heap;
+		};
+
+		void check(Heap& heap, uint32_t index, vk::DeviceSize usage, vk::DeviceSize budget) noexcept;
+
+		vk::PhysicalDevice physical_;
+		bool extension_;
+		vk::DeviceSize limit_ = 0;
+		// heap of every memory type
+		std::vector<uint32_t> typeHeaps_;
+
+		mutable std::mutex mutex_;
+		std::vector<Heap> heaps_;
+		std::unordered_map<VkDeviceMemory, Allocation> allocations_;
+		vk::DeviceSize allocated_ = 0;
+		vk::DeviceSize peak_ = 0;
+		bool limitWarned_ = false;
+	};
+
+}
\ No newline at end of file
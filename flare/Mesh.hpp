@@ -11,47 +11,89 @@
 #include <memory>
 
 #include "Buffer.hpp"
+#include "Device.hpp"
+#include "VertexLayout.hpp"
 
 namespace fve {
 
-	class Mesh final {
+	// per instance placement of the mesh, read from vertex binding 1
+	struct MeshInstance {
+		// normalized device coordinates the unit quad is stretched to, min xy and max xy
+		glm::vec4 rect;
+		// the same area in framebuffer pixels, offset xy and size zw
+		glm::vec4 cell;
+		// free for the fragment shader
+		glm::vec4 parameters;
+		// applied to the vertex positions before the rect, xyz * scale + offset. meshes use it to
+		// dequantize their positions and fit their bounds into the cell, see GeometryArena::place
+		glm::vec4 scale{ 1.0f };
+		glm::vec4 offset{ 0.0f };
+
+		inline static std::vector<vk::VertexInputBindingDescription> bindingDescriptions() noexcept {
+			std::vector<vk::VertexInputBindingDescription> bindingDescriptions{};
+			bindingDescriptions.push_back({ 1, sizeof(MeshInstance), vk::VertexInputRate::eInstance });
+			return bindingDescriptions;
+		}
+
+		// the locations follow the ones of the vertex layout
+		inline static std::vector<vk::VertexInputAttributeDescription> attributeDescriptions(uint32_t firstLocation = 1) noexcept {
+			std::vector<vk::VertexInputAttributeDescription> attributeDescriptions{};
+			attributeDescriptions.push_back({ firstLocation, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(MeshInstance, rect) });
+			attributeDescriptions.push_back({ firstLocation + 1, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(MeshInstance, cell) });
+			attributeDescriptions.push_back({ firstLocation + 2, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(MeshInstance, parameters) });
+			attributeDescriptions.push_back({ firstLocation + 3, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(MeshInstance, scale) });
+			attributeDescriptions.push_back({ firstLocation + 4, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(MeshInstance, offset) });
+			return attributeDescriptions;
+		}
+	};
+
+	// a mesh with its own vertex and index buffers. the layout decides the vertex format, indices
+	// are stored as 16 bit whenever every vertex can be addressed with them
+	template<typename Layout>
+	class BasicMesh final {
 	public:
+		using Vertex = typename Layout::Vertex;
 		using Index = uint32_t;
+		using Instance = MeshInstance;
 
-		struct Vertex {
-			Vertex() = default;
-			Vertex(glm::vec3 p) : position{ std::move(p) } {
-			}
-
-			glm::vec3 position;
+		explicit BasicMesh(Device& device, const std::vector<Vertex>& vertices, const std::vector<Index>& indices = {}) : device_{ device } {
+			vertexBuffer_ = createBuffer(vk::BufferUsageFlagBits::eVertexBuffer, vertices);
+			if (indices.empty())
+				return;
 
-			inline static std::vector<vk::VertexInputBindingDescription> bindingDescriptions() noexcept {
-				std::vector<vk::VertexInputBindingDescription> bindingDescriptions{};
-				bindingDescriptions.push_back({ 0, sizeof(Vertex), vk::VertexInputRate::eVertex });
-				return bindingDescriptions;
+			if (vertices.size() <= 0x10000) {
+				indexType_ = vk::IndexType::eUint16;
+				const std::vector<uint16_t> narrow(indices.begin(), indices.end());
+				indexBuffer_ = createBuffer(vk::BufferUsageFlagBits::eIndexBuffer, narrow);
 			}
-
-			inline static std::vector<vk::VertexInputAttributeDescription> attributeDescriptions() noexcept {
-				std::vector<vk::VertexInputAttributeDescription> attributeDescriptions{};
-				attributeDescriptions.push_back({ 0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, position) });
-				return attributeDescriptions;
+			else {
+				indexType_ = vk::IndexType::eUint32;
+				indexBuffer_ = createBuffer(vk::BufferUsageFlagBits::eIndexBuffer, indices);
 			}
+		}
 
-			inline bool operator==(const Vertex& other) const noexcept {
-				return position == other.position;
-			}
+		BasicMesh(const BasicMesh&) = delete;
+		BasicMesh& operator=(const BasicMesh&) = delete;
 
-		};
+		~BasicMesh() noexcept = default;
 
-		explicit Mesh(Device& device, const std::vector<Vertex>& vertices, const std::vector<Index>& indices = {});
+		inline vk::IndexType indexType() const noexcept { return indexType_; }
 
-		Mesh(const Mesh&) = delete;
-		Mesh& operator=(const Mesh&) = delete;
+		void bind(vk::CommandBuffer commandBuffer) {
+			const auto vertexBuffer = vertexBuffer_->buffer();
+			const vk::DeviceSize offset = 0;
 
-		~Mesh() noexcept = default;
+			commandBuffer.bindVertexBuffers(0, vertexBuffer, offset);
+			if (indexBuffer_)
+				commandBuffer.bindIndexBuffer(indexBuffer_->buffer(), 0, indexType_);
+		}
 
-		void bind(vk::CommandBuffer commandBuffer);
-		void draw(vk::CommandBuffer commandBuffer);
+		void draw(vk::CommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0) {
+			if (indexBuffer_)
+				commandBuffer.drawIndexed(static_cast<uint32_t>(indexBuffer_->instanceCount()), instanceCount, 0, 0, firstInstance);
+			else
+				commandBuffer.draw(static_cast<uint32_t>(vertexBuffer_->instanceCount()), instanceCount, 0, firstInstance);
+		}
 
 	private:
 		template<typename T>
@@ -81,9 +123,13 @@ namespace fve {
 		Device& device_;
 		std::unique_ptr<Buffer> indexBuffer_ = nullptr;
 		std::unique_ptr<Buffer> vertexBuffer_ = nullptr;
+		vk::IndexType indexType_ = vk::IndexType::eUint32;
 
 	};
 
+	// the bundled layout is instantiated once in Mesh.cpp
+	extern template class BasicMesh<layouts::Position>;
 
+	using Mesh = BasicMesh<layouts::Position>;
 
 }
\ No newline at end of file
@@ -0,0 +1,474 @@
+#include "MeshConverter.hpp"
+#include "MeshFile.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+	// modelled cache of the vertex cache optimisation and the weights of its vertex scores
+	static constexpr int32_t CACHE_SIZE = 32;
+	static constexpr float CACHE_DECAY_POWER = 1.5f;
+	static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	static constexpr uint32_t GLB_MAGIC = 0x46546c67;
+	static constexpr uint32_t GLB_CHUNK_JSON = 0x4e4f534a;
+	static constexpr uint32_t GLB_CHUNK_BIN = 0x004e4942;
+	static constexpr uint32_t GLTF_FLOAT = 5126;
+	static constexpr uint32_t GLTF_UNSIGNED_BYTE = 5121;
+	static constexpr uint32_t GLTF_UNSIGNED_SHORT = 5123;
+	static constexpr uint32_t GLTF_UNSIGNED_INT = 5125;
+	static constexpr uint32_t GLTF_TRIANGLES = 4;
+
+	float vertexScore(int32_t cachePosition, uint32_t remaining) noexcept {
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			// the triangle just emitted gets a fixed score so the next one does not simply reuse it
+			if (cachePosition < 3)
+				score = LAST_TRIANGLE_SCORE;
+			else
+				score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		// vertices with few triangles left are finished first, so they leave the cache for good
+		return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining), -VALENCE_BOOST_POWER);
+	}
+
+	std::vector<uint8_t> readBytes(const std::filesystem::path& filepath) {
+		std::ifstream file{ filepath, std::ios::in | std::ios::binary };
+		if (!file.is_open())
+			throw std::runtime_error{ "failed to open " + filepath.string() };
+		return { std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+	}
+
+	std::vector<uint8_t> decodeBase64(const std::string& text) {
+		auto value = [](char c) -> int32_t {
+			if (c >= 'A' && c <= 'Z')
+				return c - 'A';
+			if (c >= 'a' && c <= 'z')
+				return c - 'a' + 26;
+			if (c >= '0' && c <= '9')
+				return c - '0' + 52;
+			if (c == '+')
+				return 62;
+			if (c == '/')
+				return 63;
+			return -1;
+		};
+
+		std::vector<uint8_t> bytes;
+		bytes.reserve(text.size() * 3 / 4);
+		uint32_t bits = 0;
+		int32_t bitCount = 0;
+		for (char c : text) {
+			const auto v = value(c);
+			if (v < 0)
+				continue;
+			bits = bits << 6 | static_cast<uint32_t>(v);
+			bitCount += 6;
+			if (bitCount >= 8) {
+				bitCount -= 8;
+				bytes.push_back(static_cast<uint8_t>(bits >> bitCount));
+			}
+		}
+		return bytes;
+	}
+}
+
+namespace fve {
+
+	bool MeshConverter::convert(const std::string& input, const std::string& output, layouts::Id layout) noexcept {
+		try {
+			const auto begin = Trace::now();
+
+			auto extension = std::filesystem::path{ input }.extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+			std::vector<Mesh::Vertex> vertices;
+			std::vector<Mesh::Index> indices;
+			if (extension == ".obj") {
+				loadObj(input, vertices, indices);
+			}
+			else if (extension == ".gltf" || extension == ".glb") {
+				loadGltf(input, vertices, indices);
+			}
+			else {
+				Log_error("failed to convert mesh {}. unsupported format {}", input, extension);
+				return false;
+			}
+
+			const auto before = acmr(indices, vertices.size());
+			optimizeVertexCache(indices, vertices.size());
+			optimizeVertexFetch(vertices, indices);
+			const auto after = acmr(indices, vertices.size());
+
+			layouts::Bounds bounds{};
+			if (!vertices.empty()) {
+				bounds.min = bounds.max = vertices.front().get<0>();
+				for (const auto& vertex : vertices) {
+					bounds.min = glm::min(bounds.min, vertex.get<0>());
+					bounds.max = glm::max(bounds.max, vertex.get<0>());
+				}
+			}
+
+			const auto bytes = encode(vertices, layout, bounds);
+			if (!MeshFile::write(output, layout, bytes, indices, bounds))
+				return false;
+
+			Log_info("converted {} into {} with {} vertices and {} triangles in {:.2f} ms, acmr {:.3f} -> {:.3f}, {} bytes per vertex, {} bit indices",
+					 input,
+					 output,
+					 vertices.size(),
+					 indices.size() / 3,
+					 static_cast<double>(Trace::now() - begin) / 1e6,
+					 before,
+					 after,
+					 layouts::stride(layout),
+					 vertices.size() <= 0x10000 ? 16 : 32);
+			return true;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to convert mesh {}. error {}", input, ex.what());
+		}
+		catch (...) {
+			Log_error("failed to convert mesh {}. unknown error", input);
+		}
+		return false;
+	}
+
+	void MeshConverter::loadObj(const std::string& filepath, std::vector<Mesh::Vertex>& vertices, std::vector<Mesh::Index>& indices) {
+		std::ifstream file{ filepath, std::ios::in };
+		if (!file.is_open())
+			throw std::runtime_error{ "failed to open " + filepath };
+
+		std::vector<Mesh::Index> polygon;
+		std::string line;
+		while (std::getline(file, line)) {
+			const char* cursor = line.c_str();
+			if (cursor[0] == 'v' && cursor[1] == ' ') {
+				char* end = nullptr;
+				glm::vec3 position{};
+				position.x = std::strtof(cursor + 2, &end);
+				position.y = std::strtof(end, &end);
+				position.z = std::strtof(end, &end);
+				vertices.emplace_back(position);
+			}
+			else if (cursor[0] == 'f' && cursor[1] == ' ') {
+				polygon.clear();
+				cursor += 2;
+				for (;;) {
+					char* end = nullptr;
+					const auto index = std::strtol(cursor, &end, 10);
+					if (end == cursor)
+						break;
+					// one based, negative indices count back from the last vertex read
+					const auto resolved = index < 0 ? static_cast<long>(vertices.size()) + index : index - 1;
+					if (resolved < 0 || resolved >= static_cast<long>(vertices.size()))
+						throw std::runtime_error{ "failed to load " + filepath + ". face refers to a missing vertex" };
+					polygon.push_back(static_cast<Mesh::Index>(resolved));
+
+					// texture coordinates and normals are skipped, the vertices only hold positions
+					cursor = end;
+					while (*cursor && *cursor != ' ' && *cursor != '\t')
+						++cursor;
+				}
+
+				for (size_t i = 2; i < polygon.size(); ++i) {
+					indices.push_back(polygon[0]);
+					indices.push_back(polygon[i - 1]);
+					indices.push_back(polygon[i]);
+				}
+			}
+		}
+	}
+
+	void MeshConverter::loadGltf(const std::string& filepath, std::vector<Mesh::Vertex>& vertices, std::vector<Mesh::Index>& indices) {
+		const auto bytes = readBytes(filepath);
+		const auto directory = std::filesystem::path{ filepath }.parent_path();
+
+		auto read32 = [&](size_t offset) {
+			if (offset + 4 > bytes.size())
+				throw std::runtime_error{ "failed to load " + filepath + ". truncated file" };
+			uint32_t value;
+			std::memcpy(&value, bytes.data() + offset, sizeof(value));
+			return value;
+		};
+
+		nlohmann::json json;
+		std::vector<uint8_t> binaryChunk;
+		if (bytes.size() >= 12 && read32(0) == GLB_MAGIC) {
+			// 12 byte header, then chunks of length, type and data
+			for (size_t offset = 12; offset + 8 <= bytes.size();) {
+				const auto length = read32(offset);
+				const auto type = read32(offset + 4);
+				if (offset + 8 + length > bytes.size())
+					throw std::runtime_error{ "failed to load " + filepath + ". truncated chunk" };
+				const auto* data = bytes.data() + offset + 8;
+				if (type == GLB_CHUNK_JSON)
+					json = nlohmann::json::parse(data, data + length);
+				else if (type == GLB_CHUNK_BIN && binaryChunk.empty())
+					binaryChunk.assign(data, data + length);
+				offset += 8 + length;
+			}
+		}
+		else {
+			json = nlohmann::json::parse(bytes.begin(), bytes.end());
+		}
+
+		std::vector<std::vector<uint8_t>> buffers;
+		for (const auto& buffer : json.value("buffers", nlohmann::json::array())) {
+			if (!buffer.contains("uri")) {
+				buffers.push_back(binaryChunk);
+				continue;
+			}
+			const auto uri = buffer["uri"].get<std::string>();
+			if (uri.rfind("data:", 0) == 0)
+				buffers.push_back(decodeBase64(uri.substr(uri.find(',') + 1)));
+			else
+				buffers.push_back(readBytes(directory / uri));
+		}
+
+		struct View {
+			const uint8_t* data;
+			size_t stride;
+			size_t count;
+			uint32_t componentType;
+		};
+
+		auto accessor = [&](size_t index, size_t elementSize) {
+			const auto& a = json.at("accessors").at(index);
+			const auto& bufferView = json.at("bufferViews").at(a.at("bufferView").get<size_t>());
+			const auto& buffer = buffers.at(bufferView.at("buffer").get<size_t>());
+
+			View view{};
+			view.componentType = a.at("componentType").get<uint32_t>();
+			view.count = a.at("count").get<size_t>();
+			view.stride = bufferView.value("byteStride", elementSize);
+
+			const auto offset = bufferView.value("byteOffset", size_t{ 0 }) + a.value("byteOffset", size_t{ 0 });
+			if (view.count > 0 && offset + (view.count - 1) * view.stride + elementSize > buffer.size())
+				throw std::runtime_error{ "failed to load " + filepath + ". accessor is out of its buffer" };
+			view.data = buffer.data() + offset;
+			return view;
+		};
+
+		for (const auto& mesh : json.value("meshes", nlohmann::json::array())) {
+			for (const auto& primitive : mesh.at("primitives")) {
+				if (primitive.value("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES || !primitive.at("attributes").contains("POSITION")) {
+					Log_warn("skip a primitive of {} that is not made of triangles", filepath);
+					continue;
+				}
+
+				const auto positions = accessor(primitive["attributes"]["POSITION"].get<size_t>(), sizeof(glm::vec3));
+				if (positions.componentType != GLTF_FLOAT)
+					throw std::runtime_error{ "failed to load " + filepath + ". positions are not floats" };
+
+				const auto base = static_cast<Mesh::Index>(vertices.size());
+				for (size_t i = 0; i < positions.count; ++i) {
+					glm::vec3 position;
+					std::memcpy(&position, positions.data + i * positions.stride, sizeof(position));
+					vertices.emplace_back(position);
+				}
+
+				if (!primitive.contains("indices")) {
+					for (size_t i = 0; i < positions.count; ++i)
+						indices.push_back(base + static_cast<Mesh::Index>(i));
+					continue;
+				}
+
+				const auto& indexAccessor = json.at("accessors").at(primitive["indices"].get<size_t>());
+				const auto componentType = indexAccessor.at("componentType").get<uint32_t>();
+				const size_t indexSize = componentType == GLTF_UNSIGNED_BYTE ? 1 : componentType == GLTF_UNSIGNED_SHORT ? 2 : componentType == GLTF_UNSIGNED_INT ? 4 : 0;
+				if (indexSize == 0)
+					throw std::runtime_error{ "failed to load " + filepath + ". unsupported index type" };
+
+				const auto view = accessor(primitive["indices"].get<size_t>(), indexSize);
+				for (size_t i = 0; i < view.count; ++i) {
+					uint32_t index = 0;
+					std::memcpy(&index, view.data + i * view.stride, indexSize);
+					if (index >= positions.count)
+						throw std::runtime_error{ "failed to load " + filepath + ". index refers to a missing vertex" };
+					indices.push_back(base + index);
+				}
+			}
+		}
+	}
+
+	void MeshConverter::optimizeVertexCache(std::vector<Mesh::Index>& indices, size_t vertexCount) {
+		Trace_zone("optimize vertex cache");
+
+		const auto triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// triangles of every vertex, the first remaining ones of each range are not emitted yet
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			++remaining[indices[i]];
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			offsets[v + 1] = offsets[v] + remaining[v];
+		std::vector<uint32_t> adjacency(offsets.back());
+		{
+			auto cursor = offsets;
+			for (size_t t = 0; t < triangleCount; ++t) {
+				for (size_t k = 0; k < 3; ++k)
+					adjacency[cursor[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+			}
+		}
+
+		std::vector<int32_t> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			vertexScores[v] = vertexScore(-1, remaining[v]);
+
+		std::vector<float> triangleScores(triangleCount);
+		for (size_t t = 0; t < triangleCount; ++t)
+			triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<Mesh::Index> output;
+		output.reserve(triangleCount * 3);
+
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> nextCache;
+		cache.reserve(CACHE_SIZE + 3);
+		nextCache.reserve(CACHE_SIZE + 3);
+
+		auto best = static_cast<size_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+		size_t scan = 0;
+
+		while (output.size() < triangleCount * 3) {
+			if (best == triangleCount) {
+				// nothing in the cache has triangles left, continue with the next one in input order
+				while (emitted[scan])
+					++scan;
+				best = scan;
+			}
+
+			const auto t = best;
+			emitted[t] = true;
+
+			nextCache.clear();
+			for (size_t k = 0; k < 3; ++k) {
+				const auto v = indices[t * 3 + k];
+				output.push_back(v);
+				nextCache.push_back(v);
+
+				auto begin = adjacency.begin() + offsets[v];
+				auto end = begin + remaining[v];
+				std::iter_swap(std::find(begin, end, static_cast<uint32_t>(t)), end - 1);
+				--remaining[v];
+			}
+
+			for (auto v : cache) {
+				if (v != indices[t * 3] && v != indices[t * 3 + 1] && v != indices[t * 3 + 2])
+					nextCache.push_back(v);
+			}
+
+			for (size_t i = 0; i < nextCache.size(); ++i) {
+				const auto v = nextCache[i];
+				cachePositions[v] = i < static_cast<size_t>(CACHE_SIZE) ? static_cast<int32_t>(i) : -1;
+				vertexScores[v] = vertexScore(cachePositions[v], remaining[v]);
+			}
+
+			// only the triangles around the touched vertices changed their score
+			best = triangleCount;
+			float bestScore = -1.0f;
+			for (auto v : nextCache) {
+				for (uint32_t i = 0; i < remaining[v]; ++i) {
+					const auto neighbour = adjacency[offsets[v] + i];
+					const auto score = vertexScores[indices[neighbour * 3]] + vertexScores[indices[neighbour * 3 + 1]] + vertexScores[indices[neighbour * 3 + 2]];
+					triangleScores[neighbour] = score;
+					if (score > bestScore) {
+						bestScore = score;
+						best = neighbour;
+					}
+				}
+			}
+
+			if (nextCache.size() > static_cast<size_t>(CACHE_SIZE))
+				nextCache.resize(CACHE_SIZE);
+			cache.swap(nextCache);
+		}
+
+		indices.resize(output.size());
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	void MeshConverter::optimizeVertexFetch(std::vector<Mesh::Vertex>& vertices, std::vector<Mesh::Index>& indices) {
+		Trace_zone("optimize vertex fetch");
+
+		constexpr auto unused = ~Mesh::Index{ 0 };
+		std::vector<Mesh::Index> remap(vertices.size(), unused);
+		std::vector<Mesh::Vertex> ordered;
+		ordered.reserve(vertices.size());
+
+		for (auto& index : indices) {
+			if (remap[index] == unused) {
+				remap[index] = static_cast<Mesh::Index>(ordered.size());
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices.swap(ordered);
+	}
+
+	std::vector<uint8_t> MeshConverter::encode(const std::vector<Mesh::Vertex>& vertices, layouts::Id layout, const layouts::Bounds& bounds) {
+		std::vector<uint8_t> bytes;
+		if (layout == layouts::Id::Position) {
+			bytes.resize(vertices.size() * sizeof(Mesh::Vertex));
+			std::memcpy(bytes.data(), vertices.data(), bytes.size());
+		}
+		else if (layout == layouts::Id::CompactPosition) {
+			using Vertex = layouts::CompactPosition::Vertex;
+			const auto center = bounds.center();
+			const auto extent = bounds.extent();
+
+			bytes.resize(vertices.size() * sizeof(Vertex));
+			for (size_t i = 0; i < vertices.size(); ++i) {
+				const Vertex vertex{ glm::vec4{ (vertices[i].get<0>() - center) / extent, 0.0f } };
+				std::memcpy(bytes.data() + i * sizeof(Vertex), &vertex, sizeof(Vertex));
+			}
+		}
+		else {
+			throw std::runtime_error{ "meshes are only converted into position layouts" };
+		}
+		return bytes;
+	}
+
+	float MeshConverter::acmr(const std::vector<Mesh::Index>& indices, size_t vertexCount, uint32_t cacheSize) {
+		const auto triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return 0.0f;
+
+		// a vertex is cached while fewer than cacheSize misses happened since it was loaded
+		std::vector<uint32_t> loaded(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		uint32_t misses = 0;
+		for (size_t i = 0; i < triangleCount * 3; ++i) {
+			const auto v = indices[i];
+			if (time - loaded[v] > cacheSize) {
+				loaded[v] = time++;
+				++misses;
+			}
+		}
+		return static_cast<float>(misses) / static_cast<float>(triangleCount);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Mesh.hpp"
+
+namespace fve {
+
+	// offline conversion of obj and gltf meshes into mesh files. the indices are reordered for the
+	// post-transform vertex cache and the vertices for fetch locality, so loading is a plain copy
+	class MeshConverter final {
+	public:
+		// "flare --convert <input.obj|.gltf|.glb> <output.flm> [--float]". positions are stored as
+		// snorm16 relative to the bounds of the mesh, or as floats with --float
+		static bool convert(const std::string& input, const std::string& output, layouts::Id layout = layouts::Id::CompactPosition) noexcept;
+
+		// positions of every face, polygons are triangulated as fans
+		static void loadObj(const std::string& filepath, std::vector<Mesh::Vertex>& vertices, std::vector<Mesh::Index>& indices);
+		// positions of every triangle primitive of every mesh, node transforms are not applied
+		static void loadGltf(const std::string& filepath, std::vector<Mesh::Vertex>& vertices, std::vector<Mesh::Index>& indices);
+
+		// orders the triangles so consecutive ones share vertices (Forsyth, linear-speed vertex cache optimisation)
+		static void optimizeVertexCache(std::vector<Mesh::Index>& indices, size_t vertexCount);
+		// renumbers the vertices in the order the indices first use them, unused vertices are dropped
+		static void optimizeVertexFetch(std::vector<Mesh::Vertex>& vertices, std::vector<Mesh::Index>& indices);
+		// the vertices in the layout, position only layouts are supported
+		static std::vector<uint8_t> encode(const std::vector<Mesh::Vertex>& vertices, layouts::Id layout, const layouts::Bounds& bounds);
+		// average vertex shader invocations per triangle with a fifo cache of the given size
+		static float acmr(const std::vector<Mesh::Index>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+	};
+
+}
\ No newline at end of file
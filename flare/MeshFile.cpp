@@ -0,0 +1,133 @@
+#include "MeshFile.hpp"
+#include "Log.hpp"
+
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fve {
+
+	static_assert(sizeof(MeshFile::Header) == 64, "the header is part of the file format");
+	static_assert(sizeof(MeshFile::Header) % alignof(Mesh::Vertex) == 0, "vertices are read in place after the header");
+
+	MeshFile::MeshFile(const std::string& filepath) {
+#ifdef _WIN32
+		file_ = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE) {
+			file_ = nullptr;
+			throw std::runtime_error{ "failed to open mesh file " + filepath };
+		}
+
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file_, &size);
+		size_ = static_cast<size_t>(size.QuadPart);
+
+		if (size_ >= sizeof(Header)) {
+			mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping_)
+				data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+		}
+#else
+		file_ = open(filepath.c_str(), O_RDONLY);
+		if (file_ < 0)
+			throw std::runtime_error{ "failed to open mesh file " + filepath };
+
+		struct stat status {};
+		fstat(file_, &status);
+		size_ = static_cast<size_t>(status.st_size);
+
+		if (size_ >= sizeof(Header)) {
+			auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+			if (data != MAP_FAILED) {
+				// the upload reads the file front to back once
+				madvise(data, size_, MADV_SEQUENTIAL);
+				madvise(data, size_, MADV_WILLNEED);
+				data_ = static_cast<const uint8_t*>(data);
+			}
+		}
+#endif
+
+		if (!data_) {
+			close();
+			throw std::runtime_error{ "failed to map mesh file " + filepath };
+		}
+
+		const auto& h = header();
+		const auto expected = sizeof(Header) + h.vertexCount * h.vertexSize + h.indexCount * h.indexSize;
+		if (h.magic != MAGIC || h.version != VERSION || !layouts::valid(h.layout) || h.vertexSize != layouts::stride(layout()) || (h.indexSize != 2 && h.indexSize != 4) ||
+			h.vertexCount > std::numeric_limits<uint32_t>::max() || h.indexCount > std::numeric_limits<uint32_t>::max() || expected != size_) {
+			close();
+			throw std::runtime_error{ "failed to load mesh file " + filepath + ". unsupported format" };
+		}
+	}
+
+	MeshFile::~MeshFile() noexcept {
+		close();
+	}
+
+	void MeshFile::close() noexcept {
+#ifdef _WIN32
+		if (data_)
+			UnmapViewOfFile(data_);
+		if (mapping_)
+			CloseHandle(mapping_);
+		if (file_)
+			CloseHandle(file_);
+		mapping_ = nullptr;
+		file_ = nullptr;
+#else
+		if (data_)
+			munmap(const_cast<uint8_t*>(data_), size_);
+		if (file_ >= 0)
+			::close(file_);
+		file_ = -1;
+#endif
+		data_ = nullptr;
+	}
+
+	bool MeshFile::write(const std::string& filepath,
+						 layouts::Id layout,
+						 const std::vector<uint8_t>& vertices,
+						 const std::vector<Mesh::Index>& indices,
+						 const layouts::Bounds& bounds) noexcept {
+		try {
+			std::ofstream file{ filepath, std::ios::out | std::ios::binary | std::ios::trunc };
+			if (!file.is_open()) {
+				Log_error("failed to open mesh file {} for writing", filepath);
+				return false;
+			}
+
+			const auto stride = layouts::stride(layout);
+			const auto vertexCount = vertices.size() / stride;
+			const uint32_t indexSize = vertexCount <= 0x10000 ? 2 : 4;
+
+			const Header header{ MAGIC, VERSION, static_cast<uint32_t>(layout), stride, indexSize, 0, vertexCount, indices.size(), bounds.min, bounds.max };
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(reinterpret_cast<const char*>(vertices.data()), static_cast<std::streamsize>(vertexCount * stride));
+			if (indexSize == 2) {
+				const std::vector<uint16_t> narrow(indices.begin(), indices.end());
+				file.write(reinterpret_cast<const char*>(narrow.data()), static_cast<std::streamsize>(narrow.size() * sizeof(uint16_t)));
+			}
+			else {
+				file.write(reinterpret_cast<const char*>(indices.data()), static_cast<std::streamsize>(indices.size() * sizeof(Mesh::Index)));
+			}
+			return static_cast<bool>(file);
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to write mesh file {}. error {}", filepath, ex.what());
+		}
+		return false;
+	}
+
+}
\ No newline at end of file
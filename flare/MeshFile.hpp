@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Mesh.hpp"
+
+namespace fve {
+
+	// compact binary mesh, a header followed by the vertices and the indices exactly as the geometry
+	// arena stores them. the file is memory mapped, so the arena streams it into staging memory
+	// straight from the page cache without building vectors first. the header names the vertex
+	// layout and the index width, quantized positions are relative to the bounds it holds
+	class MeshFile final {
+	public:
+		// 'FLRM'
+		static constexpr uint32_t MAGIC = 0x4d524c46;
+		static constexpr uint32_t VERSION = 2;
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			// layouts::Id
+			uint32_t layout;
+			uint32_t vertexSize;
+			// 2 or 4 bytes
+			uint32_t indexSize;
+			uint32_t reserved;
+			uint64_t vertexCount;
+			uint64_t indexCount;
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+
+		explicit MeshFile(const std::string& filepath);
+
+		~MeshFile() noexcept;
+
+		MeshFile(const MeshFile&) = delete;
+		MeshFile& operator=(const MeshFile&) = delete;
+
+		inline const void* vertices() const noexcept { return data_ + sizeof(Header); }
+		inline const void* indices() const noexcept { return data_ + sizeof(Header) + header().vertexCount * header().vertexSize; }
+		inline uint32_t vertexCount() const noexcept { return static_cast<uint32_t>(header().vertexCount); }
+		inline uint32_t indexCount() const noexcept { return static_cast<uint32_t>(header().indexCount); }
+		inline layouts::Id layout() const noexcept { return static_cast<layouts::Id>(header().layout); }
+		inline vk::IndexType indexType() const noexcept { return header().indexSize == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32; }
+		inline layouts::Bounds bounds() const noexcept { return { header().min, header().max }; }
+		inline size_t size() const noexcept { return size_; }
+
+		// the vertices are vertexCount vertices of the layout. indices are written as 16 bit whenever
+		// every vertex can be addressed with them
+		static bool write(const std::string& filepath,
+						  layouts::Id layout,
+						  const std::vector<uint8_t>& vertices,
+						  const std::vector<Mesh::Index>& indices,
+						  const layouts::Bounds& bounds) noexcept;
+
+	private:
+		void close() noexcept;
+
+		inline const Header& header() const noexcept { return *reinterpret_cast<const Header*>(data_); }
+
+		const uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+#ifdef _WIN32
+		void* file_ = nullptr;
+		void* mapping_ = nullptr;
+#else
+		int file_ = -1;
+#endif
+	};
+
+}
\ No newline at end of file
@@ -1,24 +1,186 @@
 #include "Pipeline.hpp"
 #include "Device.hpp"
 #include "Shader.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
 #include "Log.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
 namespace {
 	static constexpr const char* SHADER_ENTRY_POINT = "main";
 }
 
 namespace fve {
 
-	Pipeline::Pipeline(Device& device, const std::vector<std::shared_ptr<Shader>>& shaders, const Settings& settings) {
+	Pipeline::Specialization& Pipeline::Specialization::set(uint32_t constantId, int32_t value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return setRaw(constantId, bits);
+	}
+
+	Pipeline::Specialization& Pipeline::Specialization::set(uint32_t constantId, uint32_t value) {
+		return setRaw(constantId, value);
+	}
+
+	Pipeline::Specialization& Pipeline::Specialization::set(uint32_t constantId, float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return setRaw(constantId, bits);
+	}
+
+	const uint32_t* Pipeline::Specialization::get(uint32_t constantId) const noexcept {
+		for (size_t i = 0; i < entries_.size(); ++i) {
+			if (entries_[i].constantID == constantId)
+				return &data_[i];
+		}
+		return nullptr;
+	}
+
+	vk::SpecializationInfo Pipeline::Specialization::info() const noexcept {
+		vk::SpecializationInfo specializationInfo{};
+		specializationInfo.setMapEntryCount(static_cast<uint32_t>(entries_.size()));
+		specializationInfo.setPMapEntries(entries_.data());
+		specializationInfo.setDataSize(data_.size() * sizeof(uint32_t));
+		specializationInfo.setPData(data_.data());
+		return specializationInfo;
+	}
+
+	size_t Pipeline::Specialization::hash() const noexcept {
+		size_t seed = entries_.size();
+		auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+		for (size_t i = 0; i < entries_.size(); ++i) {
+			combine(entries_[i].constantID);
+			combine(data_[i]);
+		}
+		return seed;
+	}
+
+	bool Pipeline::Specialization::operator==(const Specialization& other) const noexcept {
+		if (data_ != other.data_ || entries_.size() != other.entries_.size())
+			return false;
+		for (size_t i = 0; i < entries_.size(); ++i) {
+			if (entries_[i].constantID != other.entries_[i].constantID)
+				return false;
+		}
+		return true;
+	}
+
+	Pipeline::Specialization& Pipeline::Specialization::setRaw(uint32_t constantId, uint32_t bits) {
+		auto it = std::lower_bound(entries_.begin(), entries_.end(), constantId, [](const vk::SpecializationMapEntry& entry, uint32_t id) {
+			return entry.constantID < id;
+		});
+		const auto index = static_cast<size_t>(std::distance(entries_.begin(), it));
+		if (it != entries_.end() && it->constantID == constantId) {
+			data_[index] = bits;
+			return *this;
+		}
+		entries_.insert(it, vk::SpecializationMapEntry{ constantId, 0, sizeof(uint32_t) });
+		data_.insert(data_.begin() + index, bits);
+		for (size_t i = 0; i < entries_.size(); ++i)
+			entries_[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+		return *this;
+	}
+
+	Pipeline::Pipeline(Device& device,
+					   JobSystem& jobs,
+					   const std::vector<std::shared_ptr<Shader>>& shaders,
+					   const Settings& settings,
+					   const Specialization& specialization)
+		:
+		device_{ device },
+		jobs_{ jobs },
+		shaders_{ shaders },
+		settings_{ settings },
+		specialization_{ specialization }
+	{
+		try {
+			pipelineCache_ = device_.logical().createPipelineCacheUnique(vk::PipelineCacheCreateInfo{});
+		}
+		catch (const vk::SystemError& err) {
+			Log_warn("failed to create vulkan pipeline cache. error {}", err.what());
+		}
+
+		pipeline_ = createPipeline(specialization_);
+	}
+
+	Pipeline::~Pipeline() noexcept {
+		// the jobs use the cache and the shaders
+		for (auto& [specialization, variant] : variants_) {
+			try {
+				jobs_.wait(variant.created);
+			}
+			catch (...) {
+			}
+		}
+	}
+
+	void Pipeline::bind(vk::CommandBuffer commandBuffer) {
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, selectedPipeline());
+	}
+
+	void Pipeline::request(const Specialization& specialization) {
+		if (specialization == specialization_ || variants_.count(specialization) != 0)
+			return;
+		auto& variant = variants_[specialization];
+		variant.future = jobs_.async(variant.created, [this, specialization]() {
+			return createPipeline(specialization);
+		});
+	}
+
+	void Pipeline::select(const Specialization& specialization) {
+		if (specialization == specialization_) {
+			selected_ = nullptr;
+			return;
+		}
+		request(specialization);
+		selected_ = &variants_.at(specialization);
+	}
+
+	void Pipeline::wait() {
+		// the error of a failed creation stays in the future, selectedPipeline() reports it
+		if (selected_ && !selected_->pipeline && !selected_->failed)
+			jobs_.wait(selected_->created);
+	}
+
+	vk::Pipeline Pipeline::selectedPipeline() {
+		if (!selected_)
+			return *pipeline_;
+
+		auto& variant = *selected_;
+		if (!variant.pipeline && !variant.failed && variant.future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready) {
+			try {
+				variant.pipeline = variant.future.get();
+			}
+			catch (const std::exception& ex) {
+				Log_error("failed to create pipeline variant. error {}", ex.what());
+				variant.failed = true;
+			}
+		}
+
+		return variant.pipeline ? *variant.pipeline : *pipeline_;
+	}
+
+	vk::UniquePipeline Pipeline::createPipeline(const Specialization& specialization) const {
+		Trace_zone("create pipeline variant");
+
+		const auto specializationInfo = specialization.info();
+
 		std::vector<vk::PipelineShaderStageCreateInfo> shaderStageCreateInfos{};
-		for (auto shader : shaders) {
+		for (auto shader : shaders_) {
 			vk::PipelineShaderStageCreateInfo shaderStageCreateInfo{};
 			shaderStageCreateInfo.setModule(shader->shaderModule());
 			shaderStageCreateInfo.setStage(shader->shaderStage());
 			shaderStageCreateInfo.setPName(SHADER_ENTRY_POINT);
+			if (!specialization.empty())
+				shaderStageCreateInfo.setPSpecializationInfo(&specializationInfo);
 			shaderStageCreateInfos.emplace_back(shaderStageCreateInfo);
 		}
 
+		const auto& settings = settings_;
+
 		vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
 		vertexInputStateCreateInfo.setVertexBindingDescriptions(settings.bindingDescriptions);
 		vertexInputStateCreateInfo.setVertexAttributeDescriptions(settings.attributeDescriptions);
@@ -48,14 +210,7 @@ namespace fve {
 		pipelineCreateInfo.setRenderPass(settings.renderPass);
 		pipelineCreateInfo.setSubpass(settings.subpass);
 
-		pipeline_ = device.logical().createGraphicsPipelineUnique(nullptr, pipelineCreateInfo);
-	}
-
-	Pipeline::~Pipeline() noexcept {
-	}
-
-	void Pipeline::bind(vk::CommandBuffer commandBuffer) {
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline_);
+		return device_.logical().createGraphicsPipelineUnique(*pipelineCache_, pipelineCreateInfo);
 	}
 
 	void Pipeline::defaultPipelineSettings(Settings& settings) noexcept {
@@ -2,9 +2,13 @@
 
 #include <vector>
 #include <memory>
+#include <future>
+#include <unordered_map>
 
 #include <vulkan/vulkan.hpp>
 
+#include "JobSystem.hpp"
+
 namespace fve {
 
 	class Device;
@@ -16,8 +20,8 @@ namespace fve {
 			Settings() = default;
 			~Settings() = default;
 
-			Settings(const Settings&) = delete;
-			Settings& operator=(const Settings&) = delete;
+			Settings(const Settings&) = default;
+			Settings& operator=(const Settings&) = default;
 
 			vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
 			vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
@@ -33,19 +37,89 @@ namespace fve {
 			uint32_t subpass = 0;
 		};
 
-		explicit Pipeline(Device& device, const std::vector<std::shared_ptr<Shader>>& shaders, const Settings& settings);
+		// values of the specialization constants of every shader stage. constants that a stage
+		// does not declare are ignored by it, constants that are not set keep their default value
+		class Specialization final {
+		public:
+			struct Hash {
+				inline size_t operator()(const Specialization& specialization) const noexcept { return specialization.hash(); }
+			};
+
+			Specialization& set(uint32_t constantId, int32_t value);
+			Specialization& set(uint32_t constantId, uint32_t value);
+			Specialization& set(uint32_t constantId, float value);
+
+			// returns nullptr when the constant is not set
+			const uint32_t* get(uint32_t constantId) const noexcept;
+
+			inline bool empty() const noexcept { return entries_.empty(); }
+
+			// the returned info points into this object
+			vk::SpecializationInfo info() const noexcept;
+
+			size_t hash() const noexcept;
+
+			bool operator==(const Specialization& other) const noexcept;
+			inline bool operator!=(const Specialization& other) const noexcept { return !(*this == other); }
+
+		private:
+			Specialization& setRaw(uint32_t constantId, uint32_t bits);
+
+			// sorted by constant id, so equal sets compare and hash equal
+			std::vector<vk::SpecializationMapEntry> entries_;
+			std::vector<uint32_t> data_;
+		};
+
+		// variants are created on the job system
+		explicit Pipeline(Device& device,
+						  JobSystem& jobs,
+						  const std::vector<std::shared_ptr<Shader>>& shaders,
+						  const Settings& settings,
+						  const Specialization& specialization = {});
 
 		~Pipeline() noexcept;
 
 		Pipeline(const Pipeline&) = delete;
 		Pipeline& operator=(const Pipeline&) = delete;
 
+		// binds the selected variant, or the default one while the selected variant is being created
 		void bind(vk::CommandBuffer commandBuffer);
+		// the pipeline bind() would bind. not thread safe, threads recording in parallel have to bind
+		// the pipeline returned by a single call made before the recording
+		vk::Pipeline selectedPipeline();
+
+		// starts creating the variant in the background if it does not exist yet
+		void request(const Specialization& specialization);
+		// requests the variant and makes bind() use it as soon as it is ready
+		void select(const Specialization& specialization);
+		// blocks until the selected variant has been created, so the frame it is used from is known
+		void wait();
+
+		inline const Specialization& specialization() const noexcept { return specialization_; }
 
 		static void defaultPipelineSettings(Settings& settings) noexcept;
 
 	private:
+		struct Variant {
+			// counts the creation job, waited for with the job system so the waiting thread helps
+			JobSystem::Counter created;
+			std::future<vk::UniquePipeline> future;
+			vk::UniquePipeline pipeline;
+			bool failed = false;
+		};
+
+		vk::UniquePipeline createPipeline(const Specialization& specialization) const;
+
+		Device& device_;
+		JobSystem& jobs_;
+		std::vector<std::shared_ptr<Shader>> shaders_;
+		Settings settings_;
+		Specialization specialization_;
+		vk::UniquePipelineCache pipelineCache_;
 		vk::UniquePipeline pipeline_;
+		// declared last, pending creations are waited for in the destructor
+		std::unordered_map<Specialization, Variant, Specialization::Hash> variants_;
+		Variant* selected_ = nullptr;
 	};
 
 }
\ No newline at end of file
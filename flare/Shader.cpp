@@ -1,5 +1,99 @@
 #include "Shader.hpp"
 
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+	// the few SPIR-V opcodes and enums needed to find the push constant accesses
+	static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+	static constexpr uint32_t SPIRV_HEADER_SIZE = 5;
+	static constexpr uint32_t OP_TYPE_POINTER = 32;
+	static constexpr uint32_t OP_CONSTANT = 43;
+	static constexpr uint32_t OP_VARIABLE = 59;
+	static constexpr uint32_t OP_LOAD = 61;
+	static constexpr uint32_t OP_ACCESS_CHAIN = 65;
+	static constexpr uint32_t OP_IN_BOUNDS_ACCESS_CHAIN = 66;
+	static constexpr uint32_t OP_MEMBER_DECORATE = 72;
+	static constexpr uint32_t DECORATION_OFFSET = 35;
+	static constexpr uint32_t STORAGE_CLASS_PUSH_CONSTANT = 9;
+}
+
 namespace fve {
 
+	bool Shader::readsPushConstant(uint32_t offset) const noexcept {
+		return pushConstantLoaded_ || std::find(pushConstantReads_.begin(), pushConstantReads_.end(), offset) != pushConstantReads_.end();
+	}
+
+	void Shader::reflect(const std::vector<uint32_t>& shaderBinary) noexcept {
+		if (shaderBinary.size() < SPIRV_HEADER_SIZE || shaderBinary[0] != SPIRV_MAGIC) {
+			// nothing is known about the shader, assume it reads everything
+			pushConstantLoaded_ = true;
+			return;
+		}
+
+		std::unordered_map<uint32_t, uint32_t> pointees;
+		std::unordered_map<uint32_t, uint32_t> constants;
+		// (struct type, member index) to byte offset
+		std::unordered_map<uint64_t, uint32_t> offsets;
+		// push constant variable to its pointer type
+		std::unordered_map<uint32_t, uint32_t> variables;
+		// (variable, index constant) of every access chain into a push constant block
+		std::vector<std::pair<uint32_t, uint32_t>> accesses;
+
+		auto key = [](uint32_t type, uint32_t member) { return static_cast<uint64_t>(type) << 32 | member; };
+
+		for (size_t i = SPIRV_HEADER_SIZE; i < shaderBinary.size();) {
+			const auto wordCount = shaderBinary[i] >> 16;
+			const auto opcode = shaderBinary[i] & 0xffff;
+			if (wordCount == 0 || i + wordCount > shaderBinary.size())
+				break;
+			const auto* operands = &shaderBinary[i + 1];
+
+			switch (opcode) {
+			case OP_TYPE_POINTER:
+				pointees[operands[0]] = operands[2];
+				break;
+			case OP_CONSTANT:
+				constants[operands[1]] = operands[2];
+				break;
+			case OP_MEMBER_DECORATE:
+				if (wordCount >= 5 && operands[2] == DECORATION_OFFSET)
+					offsets[key(operands[0], operands[1])] = operands[3];
+				break;
+			case OP_VARIABLE:
+				if (operands[2] == STORAGE_CLASS_PUSH_CONSTANT)
+					variables[operands[1]] = operands[0];
+				break;
+			case OP_LOAD:
+				if (variables.count(operands[2]))
+					pushConstantLoaded_ = true;
+				break;
+			case OP_ACCESS_CHAIN:
+			case OP_IN_BOUNDS_ACCESS_CHAIN:
+				if (variables.count(operands[2])) {
+					if (wordCount >= 5)
+						accesses.emplace_back(operands[2], operands[3]);
+					else
+						pushConstantLoaded_ = true;
+				}
+				break;
+			default:
+				break;
+			}
+
+			i += wordCount;
+		}
+
+		for (const auto& [variable, index] : accesses) {
+			const auto constant = constants.find(index);
+			const auto offset = constant != constants.end() ? offsets.find(key(pointees[variables[variable]], constant->second)) : offsets.end();
+			if (offset == offsets.end()) {
+				pushConstantLoaded_ = true;
+				continue;
+			}
+			if (std::find(pushConstantReads_.begin(), pushConstantReads_.end(), offset->second) == pushConstantReads_.end())
+				pushConstantReads_.push_back(offset->second);
+		}
+	}
+
 }
\ No newline at end of file
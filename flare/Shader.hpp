@@ -4,6 +4,9 @@
 
 #include "Device.hpp"
 
+#include <cstdint>
+#include <vector>
+
 namespace fve {
 
 	class Shader final {
@@ -20,14 +23,25 @@ namespace fve {
 		inline vk::ShaderModule shaderModule() const noexcept { return shaderModule_; }
 		inline vk::ShaderStageFlagBits shaderStage() const noexcept { return shaderStage_; }
 
+		// whether the shader reads the push constant member at the byte offset. reflected from the
+		// SPIR-V, a shader loading the whole block reads every member
+		bool readsPushConstant(uint32_t offset) const noexcept;
+
 	private:
-		explicit Shader(Device& device, vk::ShaderModule shaderModule, vk::ShaderStageFlagBits shaderStage) :
+		explicit Shader(Device& device, vk::ShaderModule shaderModule, vk::ShaderStageFlagBits shaderStage, const std::vector<uint32_t>& shaderBinary) :
 			device_{ device }, shaderModule_{ shaderModule }, shaderStage_{ shaderStage }
-		{}
+		{
+			reflect(shaderBinary);
+		}
+
+		void reflect(const std::vector<uint32_t>& shaderBinary) noexcept;
 
 		Device& device_;
 		vk::ShaderModule shaderModule_;
 		vk::ShaderStageFlagBits shaderStage_;
+		// byte offsets of the push constant members accessed by the shader
+		std::vector<uint32_t> pushConstantReads_;
+		bool pushConstantLoaded_ = false;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "ShaderBuilder.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+	// a keyword slot that defines nothing
+	static constexpr const char* NO_KEYWORD = "_";
+
+	std::vector<std::string> tokenize(const std::string& line) {
+		std::istringstream stream{ line };
+		std::vector<std::string> tokens;
+		for (std::string token; stream >> token;)
+			tokens.push_back(token);
+		return tokens;
+	}
+
+	bool isPermutationPragma(const std::vector<std::string>& tokens) noexcept {
+		return tokens.size() >= 3 && tokens[0] == "#pragma" && (tokens[1] == "keywords" || tokens[1] == "optimize");
+	}
+}
+
+namespace fve {
+
+	ShaderBuilder::ShaderBuilder(JobSystem& jobs, std::filesystem::path sourceDirectory, std::filesystem::path outputDirectory)
+		:
+		jobs_{ jobs },
+		sourceDirectory_{ std::move(sourceDirectory) },
+		outputDirectory_{ std::move(outputDirectory) }
+	{
+	}
+
+	ShaderBuilder::~ShaderBuilder() noexcept {
+	}
+
+	bool ShaderBuilder::build() noexcept {
+		Trace_zone("build shaders");
+
+		try {
+			const auto begin = Trace::now();
+
+			std::filesystem::create_directories(outputDirectory_);
+			const auto includeDirectory = sourceDirectory_ / INCLUDE_DIRECTORY;
+			if (std::filesystem::is_directory(includeDirectory)) {
+				std::filesystem::copy(includeDirectory,
+									  outputDirectory_ / INCLUDE_DIRECTORY,
+									  std::filesystem::copy_options::recursive | std::filesystem::copy_options::update_existing);
+			}
+
+			std::unordered_map<std::string, Entry> manifest;
+			if (std::ifstream file{ outputDirectory_ / MANIFEST }; file.is_open()) {
+				try {
+					nlohmann::json json;
+					file >> json;
+					for (const auto& [name, entry] : json.items())
+						manifest[name] = { entry.at("key").get<std::string>(), entry.at("dependencies").get<std::unordered_map<std::string, std::string>>() };
+				}
+				catch (const std::exception& ex) {
+					Log_warn("failed to read shader manifest, every variant is rebuilt. error {}", ex.what());
+					manifest.clear();
+				}
+			}
+
+			std::vector<Variant> variants;
+			for (const auto& entry : std::filesystem::directory_iterator(sourceDirectory_)) {
+				vk::ShaderStageFlagBits stage{};
+				if (!entry.is_regular_file() || !ShaderCompiler::stageOf(entry.path().string(), stage))
+					continue;
+
+				std::ifstream file{ entry.path(), std::ios::in | std::ios::binary };
+				std::ostringstream content;
+				content << file.rdbuf();
+
+				for (auto& variant : permutations(std::filesystem::absolute(entry.path()).lexically_normal(), content.str()))
+					variants.push_back(std::move(variant));
+			}
+
+			std::vector<const Variant*> stale;
+			for (const auto& variant : variants) {
+				if (!upToDate(variant, manifest))
+					stale.push_back(&variant);
+			}
+
+			// every job compiles with its own compiler, taking the next stale variant until none is left
+			std::vector<ShaderCompiler::Result> results(stale.size());
+			std::atomic<size_t> next{ 0 };
+			const auto workerCount = static_cast<uint32_t>(std::min<size_t>(jobs_.threadCount(), stale.size()));
+			jobs_.parallelFor(workerCount, 1, [&](uint32_t, uint32_t) {
+				const ShaderCompiler compiler;
+				for (size_t index = next++; index < stale.size(); index = next++) {
+					const auto& variant = *stale[index];
+					results[index] = compiler.compile(variant.content, variant.source.string(), variant.stage, variant.options);
+				}
+			});
+
+			bool succeeded = true;
+			for (size_t i = 0; i < stale.size(); ++i) {
+				const auto& variant = *stale[i];
+				const auto& result = results[i];
+				if (!result.error.empty()) {
+					Log_error("failed to compile shader variant {}. error {}", variant.name, result.error);
+					manifest.erase(variant.name);
+					succeeded = false;
+					continue;
+				}
+
+				std::ofstream file{ outputDirectory_ / (variant.name + ".spv"), std::ios::out | std::ios::binary | std::ios::trunc };
+				file.write(reinterpret_cast<const char*>(result.binary.data()), result.binary.size() * sizeof(uint32_t));
+				if (!file) {
+					Log_error("failed to write shader variant {}", variant.name);
+					manifest.erase(variant.name);
+					succeeded = false;
+					continue;
+				}
+
+				Entry entry{ variant.key, {} };
+				entry.dependencies[variant.source.string()] = hashFile(variant.source.string());
+				for (const auto& include : result.includes)
+					entry.dependencies[include] = hashFile(include);
+				manifest[variant.name] = std::move(entry);
+			}
+
+			nlohmann::json json = nlohmann::json::object();
+			for (const auto& [name, entry] : manifest)
+				json[name] = { { "key", entry.key }, { "dependencies", entry.dependencies } };
+			std::ofstream file{ outputDirectory_ / MANIFEST, std::ios::out | std::ios::binary | std::ios::trunc };
+			file << std::setw(4) << json;
+
+			Log_info("built {} of {} shader variants in {:.2f} ms on {} threads",
+					 stale.size(),
+					 variants.size(),
+					 static_cast<double>(Trace::now() - begin) / 1e6,
+					 workerCount);
+			return succeeded;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to build shaders from {}. error {}", sourceDirectory_.string(), ex.what());
+		}
+		return false;
+	}
+
+	std::vector<ShaderBuilder::Variant> ShaderBuilder::permutations(const std::filesystem::path& source, const std::string& content) const {
+		vk::ShaderStageFlagBits stage{};
+		ShaderCompiler::stageOf(source.string(), stage);
+
+		std::vector<std::vector<std::string>> keywordSets;
+		auto optimization = ShaderCompiler::Optimization::Size;
+		std::vector<std::pair<std::string, ShaderCompiler::Optimization>> overrides;
+
+		std::istringstream stream{ content };
+		for (std::string line; std::getline(stream, line);) {
+			const auto tokens = tokenize(line);
+			if (!isPermutationPragma(tokens))
+				continue;
+
+			if (tokens[1] == "keywords") {
+				std::vector<std::string> keywords{ tokens.begin() + 2, tokens.end() };
+				// a lone keyword is optional
+				if (keywords.size() == 1)
+					keywords.insert(keywords.begin(), NO_KEYWORD);
+				keywordSets.push_back(std::move(keywords));
+			}
+			else if (tokens.size() > 3) {
+				overrides.push_back({ tokens[3], ShaderCompiler::parseOptimization(tokens[2]) });
+			}
+			else {
+				optimization = ShaderCompiler::parseOptimization(tokens[2]);
+			}
+		}
+
+		const auto stripped = strip(content);
+		const auto stem = source.stem().string();
+		const auto extension = source.extension().string();
+
+		// counts through every combination of one keyword per set
+		std::vector<Variant> variants;
+		std::vector<size_t> choice(keywordSets.size(), 0);
+		do {
+			Variant variant{};
+			variant.source = source;
+			variant.content = stripped;
+			variant.name = stem;
+			variant.stage = stage;
+			variant.options.optimization = optimization;
+			variant.options.includeDirectory = (sourceDirectory_ / INCLUDE_DIRECTORY).string();
+
+			std::vector<std::string> keywords;
+			for (size_t i = 0; i < keywordSets.size(); ++i) {
+				const auto& keyword = keywordSets[i][choice[i]];
+				if (keyword == NO_KEYWORD)
+					continue;
+				keywords.push_back(keyword);
+				variant.name += "+" + keyword;
+				variant.options.defines.push_back({ keyword, "1" });
+			}
+			variant.name += extension;
+
+			for (const auto& [keyword, level] : overrides) {
+				if (std::find(keywords.begin(), keywords.end(), keyword) != keywords.end())
+					variant.options.optimization = level;
+			}
+
+			std::string key = vk::to_string(stage) + " " + std::to_string(static_cast<int>(variant.options.optimization));
+			for (const auto& keyword : keywords)
+				key += " " + keyword;
+			variant.key = hash(key);
+
+			variants.push_back(std::move(variant));
+
+			size_t i = 0;
+			for (; i < choice.size(); ++i) {
+				if (++choice[i] < keywordSets[i].size())
+					break;
+				choice[i] = 0;
+			}
+			if (i == choice.size())
+				break;
+		} while (true);
+
+		return variants;
+	}
+
+	bool ShaderBuilder::upToDate(const Variant& variant, const std::unordered_map<std::string, Entry>& manifest) {
+		const auto entry = manifest.find(variant.name);
+		if (entry == manifest.end() || entry->second.key != variant.key)
+			return false;
+		if (!std::filesystem::exists(outputDirectory_ / (variant.name + ".spv")))
+			return false;
+		return std::all_of(entry->second.dependencies.begin(), entry->second.dependencies.end(), [&](const auto& dependency) {
+			return hashFile(dependency.first) == dependency.second;
+		});
+	}
+
+	std::string ShaderBuilder::hash(const std::string& content) noexcept {
+		// fnv-1a, enough to notice an edit
+		uint64_t value = 0xcbf29ce484222325ull;
+		for (const auto c : content) {
+			value ^= static_cast<uint8_t>(c);
+			value *= 0x100000001b3ull;
+		}
+		std::ostringstream stream;
+		stream << std::hex << std::setw(16) << std::setfill('0') << value;
+		return stream.str();
+	}
+
+	std::string ShaderBuilder::hashFile(const std::string& filepath) {
+		if (auto it = hashes_.find(filepath); it != hashes_.end())
+			return it->second;
+
+		// missing files hash empty, which never matches a recorded hash
+		std::string value;
+		if (std::ifstream file{ filepath, std::ios::in | std::ios::binary }; file.is_open()) {
+			std::ostringstream content;
+			content << file.rdbuf();
+			value = hash(content.str());
+		}
+		hashes_[filepath] = value;
+		return value;
+	}
+
+	std::string ShaderBuilder::strip(const std::string& content) {
+		std::string stripped;
+		stripped.reserve(content.size());
+		std::istringstream stream{ content };
+		for (std::string line; std::getline(stream, line);) {
+			if (!isPermutationPragma(tokenize(line)))
+				stripped += line;
+			stripped += '\n';
+		}
+		return stripped;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ShaderCompiler.hpp"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fve {
+
+	class JobSystem;
+
+	// compiles the shader permutations of a source directory into x.frag.spv style binaries, only
+	// rebuilding the variants whose source, includes or options changed since the last build.
+	// sources declare their permutations with pragmas that are blanked before compiling:
+	//
+	//   #pragma keywords A          A is defined or not
+	//   #pragma keywords _ B C      none, B or C is defined
+	//   #pragma optimize performance
+	//   #pragma optimize none B     variants with B are not optimized
+	//
+	// every combination of one entry per keywords line is a variant named after its keywords in
+	// declaration order, x+A+B.frag.spv. the variant without keywords keeps the plain name.
+	// variants are compiled on the job system, every thread with its own compiler. the
+	// dependencies of every binary are recorded in shaders.json next to them
+	class ShaderBuilder final {
+	public:
+		// files of the include directory are shared by the sources, it is mirrored into the output
+		static constexpr const char* INCLUDE_DIRECTORY = "include";
+		static constexpr const char* MANIFEST = "shaders.json";
+
+		explicit ShaderBuilder(JobSystem& jobs, std::filesystem::path sourceDirectory, std::filesystem::path outputDirectory);
+
+		~ShaderBuilder() noexcept;
+
+		ShaderBuilder(const ShaderBuilder&) = delete;
+		ShaderBuilder& operator=(const ShaderBuilder&) = delete;
+
+		// false when any variant failed, the others are still written
+		bool build() noexcept;
+
+	private:
+		struct Variant {
+			std::filesystem::path source;
+			// without the permutation pragmas
+			std::string content;
+			std::string name;
+			vk::ShaderStageFlagBits stage;
+			ShaderCompiler::Options options;
+			// identifies the options, a changed key rebuilds the variant
+			std::string key;
+		};
+
+		struct Entry {
+			std::string key;
+			// content hash of the source and every include
+			std::unordered_map<std::string, std::string> dependencies;
+		};
+
+		std::vector<Variant> permutations(const std::filesystem::path& source, const std::string& content) const;
+		bool upToDate(const Variant& variant, const std::unordered_map<std::string, Entry>& manifest);
+		static std::string hash(const std::string& content) noexcept;
+		// files are hashed once per build, includes are shared by many variants
+		std::string hashFile(const std::string& filepath);
+		// the source without the permutation pragmas, lines stay where they are
+		static std::string strip(const std::string& content);
+
+		JobSystem& jobs_;
+		std::filesystem::path sourceDirectory_;
+		std::filesystem::path outputDirectory_;
+		std::unordered_map<std::string, std::string> hashes_;
+	};
+
+}
\ No newline at end of file
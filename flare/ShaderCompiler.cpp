@@ -0,0 +1,144 @@
+#include "ShaderCompiler.hpp"
+#include "Trace.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace {
+	// resolves #include "x" next to the including file, then in the include directory, and
+	// #include <x> in the include directory only
+	class Includer final : public shaderc::CompileOptions::IncluderInterface {
+	public:
+		Includer(std::string includeDirectory, std::vector<std::string>& includes) : includeDirectory_{ std::move(includeDirectory) }, includes_{ includes } {
+		}
+
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t) override {
+			auto include = std::make_unique<Include>();
+
+			std::vector<std::filesystem::path> candidates;
+			if (type == shaderc_include_type_relative)
+				candidates.push_back(std::filesystem::path{ requestingSource }.parent_path() / requestedSource);
+			if (!includeDirectory_.empty())
+				candidates.push_back(std::filesystem::path{ includeDirectory_ } / requestedSource);
+
+			for (const auto& candidate : candidates) {
+				std::ifstream file{ candidate, std::ios::in | std::ios::binary };
+				if (!file.is_open())
+					continue;
+				std::ostringstream content;
+				content << file.rdbuf();
+				include->name = std::filesystem::absolute(candidate).lexically_normal().string();
+				include->content = content.str();
+				includes_.push_back(include->name);
+				break;
+			}
+
+			// an empty name tells shaderc the include failed, the content is the error message
+			if (include->name.empty())
+				include->content = std::string{ "failed to resolve include " } + requestedSource;
+
+			include->result.source_name = include->name.c_str();
+			include->result.source_name_length = include->name.size();
+			include->result.content = include->content.c_str();
+			include->result.content_length = include->content.size();
+			include->result.user_data = include.get();
+			return &include.release()->result;
+		}
+
+		void ReleaseInclude(shaderc_include_result* data) override {
+			delete static_cast<Include*>(data->user_data);
+		}
+
+	private:
+		struct Include {
+			shaderc_include_result result{};
+			std::string name;
+			std::string content;
+		};
+
+		std::string includeDirectory_;
+		std::vector<std::string>& includes_;
+	};
+}
+
+namespace fve {
+
+	ShaderCompiler::ShaderCompiler() {
+	}
+
+	ShaderCompiler::~ShaderCompiler() noexcept {
+	}
+
+	ShaderCompiler::Optimization ShaderCompiler::parseOptimization(const std::string& name) noexcept {
+		if (name == "none")
+			return Optimization::None;
+		if (name == "performance")
+			return Optimization::Performance;
+		return Optimization::Size;
+	}
+
+	bool ShaderCompiler::stageOf(const std::string& filepath, vk::ShaderStageFlagBits& shaderStage) noexcept {
+		const auto extension = std::filesystem::path{ filepath }.extension();
+		if (extension == ".vert")
+			shaderStage = vk::ShaderStageFlagBits::eVertex;
+		else if (extension == ".frag")
+			shaderStage = vk::ShaderStageFlagBits::eFragment;
+		else if (extension == ".comp")
+			shaderStage = vk::ShaderStageFlagBits::eCompute;
+		else
+			return false;
+		return true;
+	}
+
+	ShaderCompiler::Result ShaderCompiler::compile(const std::string& source, const std::string& name, vk::ShaderStageFlagBits shaderStage, const Options& options) const {
+		Trace_zone("compile shader");
+
+		Result result{};
+
+		shaderc_shader_kind kind;
+		switch (shaderStage) {
+		case vk::ShaderStageFlagBits::eVertex:
+			kind = shaderc_vertex_shader;
+			break;
+		case vk::ShaderStageFlagBits::eFragment:
+			kind = shaderc_fragment_shader;
+			break;
+		case vk::ShaderStageFlagBits::eCompute:
+			kind = shaderc_compute_shader;
+			break;
+		default:
+			result.error = "unsupported shader stage " + vk::to_string(shaderStage);
+			return result;
+		}
+
+		shaderc::CompileOptions compileOptions;
+		// subgroup operations need spir-v 1.3
+		compileOptions.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+		for (const auto& [macro, value] : options.defines)
+			compileOptions.AddMacroDefinition(macro, value);
+		switch (options.optimization) {
+		case Optimization::None:
+			compileOptions.SetOptimizationLevel(shaderc_optimization_level_zero);
+			break;
+		case Optimization::Size:
+			compileOptions.SetOptimizationLevel(shaderc_optimization_level_size);
+			break;
+		case Optimization::Performance:
+			compileOptions.SetOptimizationLevel(shaderc_optimization_level_performance);
+			break;
+		}
+		compileOptions.SetIncluder(std::make_unique<Includer>(options.includeDirectory, result.includes));
+
+		const auto module = compiler_.CompileGlslToSpv(source, kind, name.c_str(), compileOptions);
+		if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
+			result.error = module.GetErrorMessage();
+			return result;
+		}
+
+		result.binary.assign(module.cbegin(), module.cend());
+		return result;
+	}
+
+}
\ No newline at end of file
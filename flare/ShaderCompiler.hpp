@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <shaderc/shaderc.hpp>
+
+namespace fve {
+
+	// glsl to spir-v with macro definitions, a selectable optimization level and #include. includes
+	// are resolved relative to the including file first and then in the include directory, every
+	// file read is reported so callers can track what a binary depends on. every instance owns its
+	// own shaderc compiler, threads compiling in parallel each use their own instance
+	class ShaderCompiler final {
+	public:
+		enum class Optimization {
+			None,
+			Size,
+			Performance
+		};
+
+		struct Options {
+			std::vector<std::pair<std::string, std::string>> defines;
+			Optimization optimization = Optimization::Size;
+			std::string includeDirectory;
+		};
+
+		struct Result {
+			std::vector<uint32_t> binary;
+			// absolute paths of the included files
+			std::vector<std::string> includes;
+			// empty on success
+			std::string error;
+		};
+
+		ShaderCompiler();
+
+		~ShaderCompiler() noexcept;
+
+		ShaderCompiler(const ShaderCompiler&) = delete;
+		ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+		// "none", "size" or "performance", unknown names fall back to size
+		static Optimization parseOptimization(const std::string& name) noexcept;
+		// from the extension of x.vert, x.frag or x.comp
+		static bool stageOf(const std::string& filepath, vk::ShaderStageFlagBits& shaderStage) noexcept;
+
+		// the name is the path includes of the source are resolved relative to
+		Result compile(const std::string& source, const std::string& name, vk::ShaderStageFlagBits shaderStage, const Options& options) const;
+
+	private:
+		shaderc::Compiler compiler_;
+	};
+
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Swapchain.hpp"
 #include "Device.hpp"
+#include "Trace.hpp"
 #include "Log.hpp"
 
 namespace fve {
@@ -18,13 +19,29 @@ namespace fve {
 	}
 
 	vk::Result Swapchain::acquireNextImage(uint32_t& imageIndex) {
-		if (device_.logical().waitForFences(1, &(*inFlightFences_[currentFrame_]), VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
-			throw std::runtime_error{ "failed to wait for fence" };
+		{
+			Trace_zone("wait for fence");
+			if (device_.logical().waitForFences(1, &(*inFlightFences_[currentFrame_]), VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+				throw std::runtime_error{ "failed to wait for fence" };
+		}
+		auto rv = device_.logical().acquireNextImageKHR(*swapchain_, std::numeric_limits<uint64_t>::max(), *imageAvailableSemaphores_[currentFrame_], nullptr);
+		if (rv.result != vk::Result::eSuccess)
+			return rv.result;
+		imageIndex = rv.value;
+
+		// there are more images than frames in flight, the frame that last rendered this image may
+		// still run. everything the engine keeps per image is reused once it is done
+		auto& imageFence = imagesInFlight_[imageIndex];
+		if (imageFence && imageFence != *inFlightFences_[currentFrame_]) {
+			Trace_zone("wait for image");
+			if (device_.logical().waitForFences(1, &imageFence, VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+				throw std::runtime_error{ "failed to wait for fence" };
+		}
+		imageFence = *inFlightFences_[currentFrame_];
+
+		// reset once an image is acquired, a failed acquire leaves the fence signaled for the next try
 		if (device_.logical().resetFences(1, &(*inFlightFences_[currentFrame_])) != vk::Result::eSuccess)
 			throw std::runtime_error{ "failed to reset fence" };
-		auto rv = device_.logical().acquireNextImageKHR(*swapchain_, std::numeric_limits<uint64_t>::max(), *imageAvailableSemaphores_[currentFrame_], nullptr);
-		if (rv.result == vk::Result::eSuccess)
-			imageIndex = rv.value;
 		return rv.result;
 	}
 
@@ -34,7 +51,8 @@ namespace fve {
 		std::array<vk::SwapchainKHR, 1> swapchains{ *swapchain_ };
 		std::array<vk::Semaphore, 1> waitSemaphores{ *imageAvailableSemaphores_[currentFrame_] };
 		std::array<vk::Semaphore, 1> signalSemaphores{ *renderFinishedSemaphores_[currentFrame_] };
-		std::array<vk::PipelineStageFlags, 1> waitStages{ vk::PipelineStageFlagBits::eColorAttachmentOutput };
+		// images are either rendered to or copied into
+		std::array<vk::PipelineStageFlags, 1> waitStages{ vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer };
 
 		vk::SubmitInfo submitInfo{};
 		submitInfo.setSignalSemaphores(signalSemaphores);
@@ -43,6 +61,7 @@ namespace fve {
 		submitInfo.setCommandBuffers(commandBuffers);
 
 		try {
+			Trace_zone("submit");
 			device_.graphicsQueue().submit(submitInfo, *inFlightFences_[currentFrame_]);
 		}
 		catch (const vk::SystemError& err) {
@@ -55,7 +74,11 @@ namespace fve {
 		presentInfo.setSwapchains(swapchains);
 		presentInfo.setImageIndices(imageIndices);
 
-		auto res = device_.presentQueue().presentKHR(presentInfo);
+		vk::Result res;
+		{
+			Trace_zone("present");
+			res = device_.presentQueue().presentKHR(presentInfo);
+		}
 
 		currentFrame_ = (currentFrame_ + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -106,7 +129,10 @@ namespace fve {
 		swapchainCreateInfo.setImageColorSpace(surfaceFormat.colorSpace);
 		swapchainCreateInfo.setImageExtent(extent);
 		swapchainCreateInfo.setImageArrayLayers(1);
-		swapchainCreateInfo.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment);
+		auto imageUsage = vk::ImageUsageFlags{ vk::ImageUsageFlagBits::eColorAttachment };
+		if (details.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst)
+			imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
+		swapchainCreateInfo.setImageUsage(imageUsage);
 
 		auto indices = Device::QueueFamilyIndices::findQueueFamilyIndices(device_.physical(), device_.surface());
 
@@ -135,6 +161,7 @@ namespace fve {
 
 		extent_ = extent;
 		imageFormat_ = surfaceFormat.format;
+		imageUsage_ = imageUsage;
 		images_ = device_.logical().getSwapchainImagesKHR(*swapchain_);
 	}
 
@@ -230,6 +257,7 @@ namespace fve {
 		imageAvailableSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
 		renderFinishedSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
 		inFlightFences_.resize(MAX_FRAMES_IN_FLIGHT);
+		imagesInFlight_.assign(images_.size(), vk::Fence{});
 
 		try {
 			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
@@ -34,9 +34,14 @@ namespace fve {
 		inline uint32_t size() const noexcept { return images_.size(); }
 		inline vk::RenderPass renderPass() const noexcept { return *renderPass_; };
 		inline vk::Framebuffer framebuffer(size_t index) const { return *framebuffers_[index]; };
+		inline vk::Image image(size_t index) const { return images_[index]; };
+		// transfer destination when the surface supports it, see TileScheduler
+		inline vk::ImageUsageFlags imageUsage() const noexcept { return imageUsage_; }
 		inline vk::Extent2D extent() const noexcept { return extent_; }
 		inline vk::Format imageFormat() const noexcept { return imageFormat_; };
 
+		// returns once the frame slot and the last frame that rendered the image are done, so the
+		// resources kept per image index can be reused
 		[[nodiscard]] vk::Result acquireNextImage(uint32_t& imageIndex);
 		[[nodiscard]] vk::Result submit(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
 
@@ -56,6 +61,7 @@ namespace fve {
 		vk::Extent2D windowExtent_;
 		vk::UniqueSwapchainKHR swapchain_;
 		vk::Format imageFormat_;
+		vk::ImageUsageFlags imageUsage_;
 		std::vector<vk::Image> images_;
 		std::vector<vk::ImageView> imageViews_;
 		vk::UniqueRenderPass renderPass_;
@@ -63,6 +69,8 @@ namespace fve {
 		std::vector<vk::UniqueSemaphore> imageAvailableSemaphores_;
 		std::vector<vk::UniqueSemaphore> renderFinishedSemaphores_;
 		std::vector<vk::UniqueFence> inFlightFences_;
+		// fence of the frame that last rendered each image, null until the image is first acquired
+		std::vector<vk::Fence> imagesInFlight_;
 		size_t currentFrame_ = 0;
 	};
 
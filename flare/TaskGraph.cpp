@@ -0,0 +1,167 @@
+#include "TaskGraph.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+namespace fve {
+
+	TaskGraph::TaskGraph(std::string name, JobSystem& jobs) : name_{ std::move(name) }, traceName_{ Trace::intern(name_) }, jobs_{ jobs } {
+	}
+
+	TaskGraph::~TaskGraph() noexcept {
+	}
+
+	TaskGraph::Id TaskGraph::add(std::string name, Task task, std::vector<Id> dependencies) {
+		return insert(std::move(name), std::move(task), std::move(dependencies), false);
+	}
+
+	TaskGraph::Id TaskGraph::addMain(std::string name, Task task, std::vector<Id> dependencies) {
+		return insert(std::move(name), std::move(task), std::move(dependencies), true);
+	}
+
+	TaskGraph::Id TaskGraph::insert(std::string name, Task task, std::vector<Id> dependencies, bool mainThread) {
+		const Id id = nodes_.size();
+		for (auto dependency : dependencies) {
+			if (dependency >= id)
+				throw std::invalid_argument{ "failed to add task " + name + ". unknown dependency" };
+			nodes_[dependency].dependents.push_back(id);
+		}
+
+		Node node{};
+		node.traceName = Trace::intern(name);
+		node.name = std::move(name);
+		node.task = std::move(task);
+		node.dependencies = static_cast<uint32_t>(dependencies.size());
+		node.mainThread = mainThread;
+		nodes_.push_back(std::move(node));
+		return id;
+	}
+
+	void TaskGraph::run() {
+		Trace_zone(traceName_);
+
+		const auto begin = Trace::now();
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::vector<Id> completed;
+		// counts the tasks on the job system, they are done with the lock once it drops to zero
+		JobSystem::Counter running;
+
+		std::vector<uint32_t> pending(nodes_.size());
+		std::vector<Id> ready;
+		std::vector<Id> mainReady;
+		for (Id id = 0; id < nodes_.size(); ++id) {
+			pending[id] = nodes_[id].dependencies;
+			if (pending[id] == 0)
+				ready.push_back(id);
+		}
+
+		size_t finished = 0;
+		auto complete = [&](Id id) {
+			++finished;
+			const auto& node = nodes_[id];
+			for (auto dependent : node.dependents) {
+				if (node.error || node.skipped)
+					nodes_[dependent].skipped = true;
+				if (--pending[dependent] == 0)
+					ready.push_back(dependent);
+			}
+		};
+
+		while (finished < nodes_.size()) {
+			while (!ready.empty()) {
+				const auto id = ready.back();
+				ready.pop_back();
+
+				auto& node = nodes_[id];
+				if (node.skipped) {
+					complete(id);
+				}
+				else if (node.mainThread) {
+					mainReady.push_back(id);
+				}
+				else {
+					jobs_.run(running, [&, id]() {
+						execute(nodes_[id]);
+						{
+							std::lock_guard<std::mutex> lock{ mutex };
+							completed.push_back(id);
+						}
+						wake.notify_one();
+					});
+				}
+			}
+
+			// the calling thread helps out with the tasks pinned to it
+			if (!mainReady.empty()) {
+				const auto id = mainReady.front();
+				mainReady.erase(mainReady.begin());
+				execute(nodes_[id]);
+				complete(id);
+				continue;
+			}
+
+			if (finished == nodes_.size())
+				break;
+
+			std::vector<Id> done;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				wake.wait(lock, [&]() { return !completed.empty(); });
+				done.swap(completed);
+			}
+			for (auto id : done)
+				complete(id);
+		}
+
+		jobs_.wait(running);
+
+		report(begin, Trace::now());
+
+		for (const auto& node : nodes_) {
+			if (node.error)
+				std::rethrow_exception(node.error);
+		}
+	}
+
+	void TaskGraph::execute(Node& node) noexcept {
+		Trace_zone(node.traceName);
+
+		node.begin = Trace::now();
+		try {
+			node.task();
+		}
+		catch (...) {
+			node.error = std::current_exception();
+		}
+		node.end = Trace::now();
+	}
+
+	void TaskGraph::report(int64_t begin, int64_t end) const {
+		auto milliseconds = [](int64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1e6; };
+
+		int64_t busy = 0;
+		for (const auto& node : nodes_) {
+			if (node.skipped) {
+				Log_info("{} {} skipped", name_, node.name);
+				continue;
+			}
+			busy += node.end - node.begin;
+			Log_info("{} {} {:.2f} ms, started at {:.2f} ms{}",
+					 name_,
+					 node.name,
+					 milliseconds(node.end - node.begin),
+					 milliseconds(node.begin - begin),
+					 node.error ? ", failed" : "");
+		}
+
+		// the ratio of the summed task times to the wall time is the speedup over running in sequence
+		Log_info("{} done in {:.2f} ms, {:.2f} ms of tasks", name_, milliseconds(end - begin), milliseconds(busy));
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace fve {
+
+	class JobSystem;
+
+	// runs a set of named tasks as soon as their dependencies are done. tasks run on the job system,
+	// except the ones pinned to the calling thread (glfw wants its windows on the main thread). when a task throws its dependents are skipped and run() rethrows the first error.
+	// the timing of every task is logged once the graph is done
+	class TaskGraph final {
+	public:
+		using Id = size_t;
+		using Task = std::function<void()>;
+
+		explicit TaskGraph(std::string name, JobSystem& jobs);
+
+		~TaskGraph() noexcept;
+
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+
+		// dependencies must have been added before
+		Id add(std::string name, Task task, std::vector<Id> dependencies = {});
+		Id addMain(std::string name, Task task, std::vector<Id> dependencies = {});
+
+		void run();
+
+	private:
+		struct Node {
+			std::string name;
+			// interned, the trace outlives the graph
+			const char* traceName = nullptr;
+			Task task;
+			std::vector<Id> dependents;
+			uint32_t dependencies = 0;
+			bool mainThread = false;
+			// set when a dependency failed
+			bool skipped = false;
+			std::exception_ptr error;
+			int64_t begin = 0;
+			int64_t end = 0;
+		};
+
+		Id insert(std::string name, Task task, std::vector<Id> dependencies, bool mainThread);
+		static void execute(Node& node) noexcept;
+		void report(int64_t begin, int64_t end) const;
+
+		std::string name_;
+		const char* traceName_;
+		JobSystem& jobs_;
+		std::vector<Node> nodes_;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,459 @@
+#include "TextureStreamer.hpp"
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <stb_image.h>
+
+namespace {
+	static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Unorm;
+	// uploads recorded per frame, a burst of decoded images is spread over several frames
+	static constexpr uint32_t UPLOADS_PER_FRAME = 1;
+}
+
+namespace fve {
+
+	TextureStreamer::TextureStreamer(Device& device, JobSystem& jobs, Descriptors& descriptors, uint32_t slotCount, vk::DeviceSize budget)
+		: device_{ device }, jobs_{ jobs }, descriptors_{ descriptors }, slotCount_{ slotCount }, budget_{ budget } {
+		// mipmaps are blitted down from the first level, which needs linear blits of the format
+		const auto features = device_.physical().getFormatProperties(FORMAT).optimalTilingFeatures;
+		const auto required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+		mipmaps_ = (features & required) == required;
+		if (!mipmaps_)
+			Log_warn("linear blits of {} are not supported, textures have no mipmaps", vk::to_string(FORMAT));
+
+		createSampler();
+		createPlaceholder();
+		if (descriptors_.bindless())
+			placeholderHandle_ = descriptors_.addImage(placeholder_.view, *sampler_);
+
+		std::array<vk::DescriptorSetLayoutBinding, CHANNEL_COUNT> bindings{};
+		for (uint32_t i = 0; i < CHANNEL_COUNT; ++i) {
+			bindings[i].setBinding(i);
+			bindings[i].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+			bindings[i].setDescriptorCount(1);
+			bindings[i].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		}
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+		descriptorSetLayoutCreateInfo.setBindings(bindings);
+
+		try {
+			descriptorSetLayout_ = device_.logical().createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create texture descriptor set layout. error {}", err.what());
+			throw;
+		}
+	}
+
+	TextureStreamer::~TextureStreamer() noexcept {
+		try {
+			jobs_.wait(decodes_);
+		}
+		catch (...) {
+		}
+		for (auto& [filepath, texture] : textures_) {
+			if (texture.decoding.valid()) {
+				try {
+					texture.pending = texture.decoding.get();
+				}
+				catch (...) {
+				}
+			}
+			if (texture.pending)
+				destroy(texture.pending->image);
+			destroy(texture.image);
+		}
+		for (auto& retired : retired_)
+			destroy(retired.image);
+		destroy(placeholder_);
+	}
+
+	bool TextureStreamer::streaming() const noexcept {
+		return std::any_of(textures_.begin(), textures_.end(), [](const auto& entry) {
+			return entry.second.state == State::Decoding || (entry.second.pending && entry.second.lastUsed == frame_);
+		});
+	}
+
+	uint32_t TextureStreamer::addChannels(const Channels& channels) {
+		channels_.push_back(channels);
+		used_.push_back(false);
+		handles_.emplace_back().fill(placeholderHandle_);
+		descriptorSets_.emplace_back();
+		return static_cast<uint32_t>(channels_.size() - 1);
+	}
+
+	void TextureStreamer::use(uint32_t channels) noexcept {
+		used_[channels] = true;
+	}
+
+	void TextureStreamer::update(vk::CommandBuffer commandBuffer, uint32_t slot) {
+		Trace_zone("stream textures");
+
+		++frame_;
+
+		// the slot's previous frame is done, anything retired a full round of slots ago is unused
+		retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [&](Retired& retired) {
+			if (retired.frame + slotCount_ + 1 > frame_)
+				return false;
+			destroy(retired.image);
+			return true;
+		}), retired_.end());
+
+		if (!placeholderCleared_) {
+			vk::ImageMemoryBarrier barrier{};
+			barrier.setImage(placeholder_.image);
+			barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+			barrier.setOldLayout(vk::ImageLayout::eUndefined);
+			barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+			const vk::ClearColorValue black{ std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f } };
+			const vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+			commandBuffer.clearColorImage(placeholder_.image, vk::ImageLayout::eTransferDstOptimal, black, range);
+
+			barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+			placeholderCleared_ = true;
+		}
+
+		// the images of the sets drawn this frame are in use, missing ones start decoding
+		for (size_t i = 0; i < channels_.size(); ++i) {
+			if (!used_[i])
+				continue;
+			used_[i] = false;
+			for (const auto& filepath : channels_[i]) {
+				if (filepath.empty())
+					continue;
+				auto& texture = textures_[filepath];
+				texture.lastUsed = frame_;
+				if (texture.state == State::Idle && !texture.pending) {
+					texture.state = State::Decoding;
+					texture.decoding = jobs_.async(decodes_, [this, filepath]() { return decode(filepath); });
+				}
+			}
+		}
+		// decode errors stay in the futures and are reported below
+		if (blocking_)
+			jobs_.wait(decodes_);
+
+		uint32_t uploads = 0;
+		for (auto& [filepath, texture] : textures_) {
+			if (texture.state == State::Decoding && texture.decoding.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready) {
+				try {
+					texture.pending = texture.decoding.get();
+					texture.state = State::Idle;
+				}
+				catch (const std::exception& ex) {
+					Log_error("failed to load texture {}. error {}", filepath, ex.what());
+					texture.state = State::Failed;
+				}
+			}
+
+			// textures no drawn set refers to stay decoded, they do not make others leave
+			if (!texture.pending || texture.lastUsed != frame_ || uploads == UPLOADS_PER_FRAME)
+				continue;
+
+			const auto size = texture.pending->image.size;
+			if (resident_ + size > budget_ && !evict(size)) {
+				if (!budgetWarned_)
+					Log_warn("texture budget of {} MB is exceeded, {} waits for room", budget_ >> 20, filepath);
+				budgetWarned_ = true;
+				continue;
+			}
+
+			try {
+				createImage(texture.pending->image);
+			}
+			catch (const std::exception& ex) {
+				Log_error("failed to load texture {}. error {}", filepath, ex.what());
+				retired_.push_back({ frame_, {}, std::move(texture.pending->staging) });
+				texture.pending.reset();
+				texture.state = State::Failed;
+				continue;
+			}
+
+			upload(commandBuffer, *texture.pending);
+			texture.image = texture.pending->image;
+			texture.state = State::Resident;
+			if (descriptors_.bindless())
+				texture.handle = descriptors_.addImage(texture.image.view, *sampler_);
+			resident_ += texture.image.size;
+			retired_.push_back({ frame_, {}, std::move(texture.pending->staging) });
+			texture.pending.reset();
+			++uploads;
+
+			Log_info("texture {} resident, {}x{} with {} mips, {:.1f} of {} MB used",
+					 filepath,
+					 texture.image.width,
+					 texture.image.height,
+					 texture.image.mipLevels,
+					 static_cast<double>(resident_) / (1 << 20),
+					 budget_ >> 20);
+		}
+
+		// the handles are pushed per draw, a texture the full table has no room for reads the placeholder
+		if (descriptors_.bindless()) {
+			for (size_t i = 0; i < channels_.size(); ++i) {
+				for (uint32_t c = 0; c < CHANNEL_COUNT; ++c) {
+					handles_[i][c] = placeholderHandle_;
+					if (channels_[i][c].empty())
+						continue;
+					const auto& texture = textures_[channels_[i][c]];
+					if (texture.state == State::Resident && texture.handle != Descriptors::INVALID)
+						handles_[i][c] = texture.handle;
+				}
+			}
+			return;
+		}
+
+		// sets from the frame pools are written whole, the sets of the other slots may be read by frames in flight
+		std::vector<vk::DescriptorImageInfo> imageInfos;
+		std::vector<vk::WriteDescriptorSet> writes;
+		imageInfos.reserve(channels_.size() * CHANNEL_COUNT);
+		for (size_t i = 0; i < channels_.size(); ++i) {
+			descriptorSets_[i] = descriptors_.allocate(slot, *descriptorSetLayout_);
+			for (uint32_t c = 0; c < CHANNEL_COUNT; ++c) {
+				auto view = placeholder_.view;
+				if (!channels_[i][c].empty()) {
+					const auto& texture = textures_[channels_[i][c]];
+					if (texture.state == State::Resident)
+						view = texture.image.view;
+				}
+				imageInfos.push_back({ *sampler_, view, vk::ImageLayout::eShaderReadOnlyOptimal });
+			}
+
+			vk::WriteDescriptorSet write{};
+			write.setDstSet(descriptorSets_[i]);
+			write.setDstBinding(0);
+			write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+			write.setDescriptorCount(CHANNEL_COUNT);
+			write.setPImageInfo(&imageInfos[i * CHANNEL_COUNT]);
+			writes.push_back(write);
+		}
+		if (!writes.empty())
+			device_.logical().updateDescriptorSets(writes, nullptr);
+	}
+
+	void TextureStreamer::bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t channels, uint32_t set) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descriptorSets_[channels], nullptr);
+	}
+
+	void TextureStreamer::createSampler() {
+		vk::SamplerCreateInfo samplerCreateInfo{};
+		samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
+		samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
+		samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
+		samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eRepeat);
+		samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eRepeat);
+		samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eRepeat);
+		samplerCreateInfo.setMinLod(0.0f);
+		samplerCreateInfo.setMaxLod(VK_LOD_CLAMP_NONE);
+
+		try {
+			sampler_ = device_.logical().createSamplerUnique(samplerCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create texture sampler. error {}", err.what());
+			throw;
+		}
+	}
+
+	void TextureStreamer::createPlaceholder() {
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.setImageType(vk::ImageType::e2D);
+		imageCreateInfo.setFormat(FORMAT);
+		imageCreateInfo.setExtent({ 1, 1, 1 });
+		imageCreateInfo.setMipLevels(1);
+		imageCreateInfo.setArrayLayers(1);
+		imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+		imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+		imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+		imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+
+		std::tie(placeholder_.image, placeholder_.memory) = device_.createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, "texture placeholder");
+		if (!placeholder_.image)
+			throw std::runtime_error{ "failed to create texture placeholder" };
+
+		vk::ImageViewCreateInfo imageViewCreateInfo{};
+		imageViewCreateInfo.setImage(placeholder_.image);
+		imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+		imageViewCreateInfo.setFormat(FORMAT);
+		imageViewCreateInfo.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+		placeholder_.view = device_.logical().createImageView(imageViewCreateInfo);
+		placeholder_.width = 1;
+		placeholder_.height = 1;
+	}
+
+	std::unique_ptr<TextureStreamer::Decoded> TextureStreamer::decode(const std::string& filepath) const {
+		Trace_zone("decode texture");
+
+		int width, height, components;
+		stbi_uc* pixels = stbi_load(filepath.c_str(), &width, &height, &components, STBI_rgb_alpha);
+		if (!pixels)
+			throw std::runtime_error{ stbi_failure_reason() };
+
+		auto decoded = std::make_unique<Decoded>();
+		auto& image = decoded->image;
+		image.width = static_cast<uint32_t>(width);
+		image.height = static_cast<uint32_t>(height);
+		image.mipLevels = mipmaps_ ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1 : 1;
+
+		// the staging memory is written here, the frame only records the copy
+		const auto size = static_cast<vk::DeviceSize>(width) * height * 4;
+		try {
+			decoded->staging = std::make_unique<Buffer>(device_,
+														1,
+														size,
+														vk::BufferUsageFlagBits::eTransferSrc,
+														vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+														"texture staging");
+			if (!decoded->staging->write(pixels, size, 0))
+				throw std::runtime_error{ "failed to write the staging buffer" };
+			decoded->staging->unmap();
+		}
+		catch (...) {
+			stbi_image_free(pixels);
+			throw;
+		}
+		stbi_image_free(pixels);
+
+		// the size the budget admits the texture with, the image is only created then
+		for (uint32_t level = 0; level < image.mipLevels; ++level)
+			image.size += static_cast<vk::DeviceSize>(std::max(1u, image.width >> level)) * std::max(1u, image.height >> level) * 4;
+
+		return decoded;
+	}
+
+	void TextureStreamer::createImage(Image& image) const {
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.setImageType(vk::ImageType::e2D);
+		imageCreateInfo.setFormat(FORMAT);
+		imageCreateInfo.setExtent({ image.width, image.height, 1 });
+		imageCreateInfo.setMipLevels(image.mipLevels);
+		imageCreateInfo.setArrayLayers(1);
+		imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+		imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+		imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+		imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+
+		std::tie(image.image, image.memory) = device_.createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, "textures");
+		if (!image.image)
+			throw std::runtime_error{ "failed to create texture image" };
+		image.size = device_.logical().getImageMemoryRequirements(image.image).size;
+
+		vk::ImageViewCreateInfo imageViewCreateInfo{};
+		imageViewCreateInfo.setImage(image.image);
+		imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+		imageViewCreateInfo.setFormat(FORMAT);
+		imageViewCreateInfo.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, image.mipLevels, 0, 1 });
+		try {
+			image.view = device_.logical().createImageView(imageViewCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			device_.logical().destroyImage(image.image);
+			device_.freeMemory(image.memory);
+			Log_error("failed to create texture image view. error {}", err.what());
+			throw;
+		}
+	}
+
+	void TextureStreamer::upload(vk::CommandBuffer commandBuffer, Decoded& decoded) const {
+		const auto& image = decoded.image;
+
+		vk::ImageMemoryBarrier barrier{};
+		barrier.setImage(image.image);
+		barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, image.mipLevels, 0, 1 });
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+		vk::BufferImageCopy region{};
+		region.setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+		region.setImageExtent({ image.width, image.height, 1 });
+		commandBuffer.copyBufferToImage(decoded.staging->buffer(), image.image, vk::ImageLayout::eTransferDstOptimal, region);
+
+		// every level is blitted from the previous one, which is then done and handed to the shaders
+		int32_t width = static_cast<int32_t>(image.width);
+		int32_t height = static_cast<int32_t>(image.height);
+		barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+		for (uint32_t level = 1; level < image.mipLevels; ++level) {
+			barrier.subresourceRange.setBaseMipLevel(level - 1);
+			barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+			const int32_t nextWidth = std::max(1, width / 2);
+			const int32_t nextHeight = std::max(1, height / 2);
+
+			vk::ImageBlit blit{};
+			blit.setSrcSubresource({ vk::ImageAspectFlagBits::eColor, level - 1, 0, 1 });
+			blit.setSrcOffsets({ vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ width, height, 1 } });
+			blit.setDstSubresource({ vk::ImageAspectFlagBits::eColor, level, 0, 1 });
+			blit.setDstOffsets({ vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ nextWidth, nextHeight, 1 } });
+			commandBuffer.blitImage(image.image, vk::ImageLayout::eTransferSrcOptimal, image.image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+			barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+
+			width = nextWidth;
+			height = nextHeight;
+		}
+
+		barrier.subresourceRange.setBaseMipLevel(image.mipLevels - 1);
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+	}
+
+	bool TextureStreamer::evict(vk::DeviceSize size) {
+		while (resident_ + size > budget_) {
+			// least recently used first, textures used this frame stay
+			Texture* victim = nullptr;
+			for (auto& [filepath, texture] : textures_) {
+				if (texture.state == State::Resident && texture.lastUsed < frame_ && (!victim || texture.lastUsed < victim->lastUsed))
+					victim = &texture;
+			}
+			if (!victim)
+				return false;
+
+			resident_ -= victim->image.size;
+			retired_.push_back({ frame_, victim->image, nullptr });
+			descriptors_.removeImage(victim->handle);
+			victim->handle = Descriptors::INVALID;
+			victim->image = {};
+			victim->state = State::Idle;
+		}
+		return true;
+	}
+
+	void TextureStreamer::destroy(Image& image) noexcept {
+		if (image.view)
+			device_.logical().destroyImageView(image.view);
+		if (image.image)
+			device_.logical().destroyImage(image.image);
+		if (image.memory)
+			device_.freeMemory(image.memory);
+		image = {};
+	}
+
+}
\ No newline at end of file
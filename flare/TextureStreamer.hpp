@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Descriptors.hpp"
+#include "JobSystem.hpp"
+
+namespace fve {
+
+	class Device;
+	class Buffer;
+
+	// image inputs of the effects, bound as iChannel0..3 like on shadertoy. images are decoded and
+	// staged on the job system, the frame only records the copy and the mipmap blits once an image
+	// is ready, so loading never blocks the frame loop. unbound or loading channels read black.
+	//
+	// with a bindless table every resident texture has a handle in it and the shaders index the table
+	// with the handles of their channels. without one every set of channels gets a descriptor set
+	// from the frame pools each frame
+	//
+	// resident textures are kept in an lru cache within a memory budget. a texture is in use while a
+	// set drawn this frame refers to it, see use(). the least recently used ones are evicted first,
+	// textures in use never are, the ones beyond the budget wait on the black placeholder until room
+	// is made. decoded textures waiting for room only hold their staging memory, the device image is
+	// created once they are admitted
+	class TextureStreamer final {
+	public:
+		static constexpr uint32_t CHANNEL_COUNT = 4;
+		using Channels = std::array<std::string, CHANNEL_COUNT>;
+
+		explicit TextureStreamer(Device& device, JobSystem& jobs, Descriptors& descriptors, uint32_t slotCount, vk::DeviceSize budget);
+
+		~TextureStreamer() noexcept;
+
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		inline vk::DescriptorSetLayout descriptorSetLayout() const noexcept { return *descriptorSetLayout_; }
+		// true while images are decoding or in use and waiting for room
+		bool streaming() const noexcept;
+
+		// decodes started by a frame are finished before its uploads are recorded, so the frame a
+		// texture becomes resident in does not depend on how fast the jobs run. for reproducible clocks
+		inline void setBlocking(bool blocking) noexcept { blocking_ = blocking; }
+
+		// returns the index the set is bound with
+		uint32_t addChannels(const Channels& channels);
+		// the set is drawn by the next update()'s frame, its images are loaded and kept resident
+		void use(uint32_t channels) noexcept;
+
+		// starts decoding the images the sets refer to, records the uploads of decoded ones and
+		// points the sets at the resident textures. after Descriptors::beginFrame() of the slot and
+		// before the render pass
+		void update(vk::CommandBuffer commandBuffer, uint32_t slot);
+		// bindless table handles of the set, valid for the frame of the last update()
+		inline const std::array<uint32_t, CHANNEL_COUNT>& handles(uint32_t channels) const noexcept { return handles_[channels]; }
+		// binds the descriptor set of the set, when there is no bindless table
+		void bind(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout, uint32_t channels, uint32_t set = 2);
+
+	private:
+		struct Image {
+			vk::Image image;
+			vk::DeviceMemory memory;
+			vk::ImageView view;
+			vk::DeviceSize size = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 1;
+		};
+
+		// decoded on a worker, the pixels are already in the staging buffer. the image only has its
+		// size until it is created
+		struct Decoded {
+			Image image;
+			std::unique_ptr<Buffer> staging;
+		};
+
+		enum class State {
+			Idle,
+			Decoding,
+			Resident,
+			Failed
+		};
+
+		struct Texture {
+			State state = State::Idle;
+			std::future<std::unique_ptr<Decoded>> decoding;
+			// decoded, waiting for room in the budget
+			std::unique_ptr<Decoded> pending;
+			Image image;
+			// in the bindless table, while resident
+			uint32_t handle = Descriptors::INVALID;
+			uint64_t lastUsed = 0;
+		};
+
+		// released once the frames that may still read them are done
+		struct Retired {
+			uint64_t frame;
+			Image image;
+			std::unique_ptr<Buffer> staging;
+		};
+
+		void createSampler();
+		void createPlaceholder();
+		std::unique_ptr<Decoded> decode(const std::string& filepath) const;
+		void createImage(Image& image) const;
+		void upload(vk::CommandBuffer commandBuffer, Decoded& decoded) const;
+		bool evict(vk::DeviceSize size);
+		void destroy(Image& image) noexcept;
+
+		Device& device_;
+		JobSystem& jobs_;
+		Descriptors& descriptors_;
+		uint32_t slotCount_;
+		vk::DeviceSize budget_;
+		vk::DeviceSize resident_ = 0;
+		uint64_t frame_ = 0;
+		bool mipmaps_ = false;
+		bool placeholderCleared_ = false;
+		bool budgetWarned_ = false;
+		bool blocking_ = false;
+		Image placeholder_;
+		uint32_t placeholderHandle_ = Descriptors::INVALID;
+		vk::UniqueSampler sampler_;
+		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
+		std::vector<Channels> channels_;
+		// the sets use() was called with since the last update
+		std::vector<bool> used_;
+		// of every set of channels, for the current frame
+		std::vector<std::array<uint32_t, CHANNEL_COUNT>> handles_;
+		std::vector<vk::DescriptorSet> descriptorSets_;
+		// declared last, decodes still running are waited for before anything they use is destroyed
+		std::vector<Retired> retired_;
+		// counts the decodes, which are waited for with the job system so the waiting thread helps
+		JobSystem::Counter decodes_;
+		std::unordered_map<std::string, Texture> textures_;
+	};
+
+}
\ No newline at end of file
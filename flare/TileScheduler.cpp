@@ -0,0 +1,264 @@
+#include "TileScheduler.hpp"
+#include "Device.hpp"
+#include "Swapchain.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace {
+	// weight of the latest measurement in the smoothed tile time
+	static constexpr double SMOOTHING = 0.25;
+	// the target starts out like the cleared swapchain image
+	static constexpr std::array<float, 4> CLEAR_COLOR{ 0.1f, 0.1f, 0.1f, 1.0f };
+}
+
+namespace fve {
+
+	TileScheduler::TileScheduler(Device& device, const Swapchain& swapchain, uint32_t tileSize, float budget)
+		: device_{ device }, extent_{ swapchain.extent() }, format_{ swapchain.imageFormat() }, budget_{ budget } {
+		auto indices = Device::QueueFamilyIndices::findQueueFamilyIndices(device_.physical(), device_.surface());
+		const auto timestampValidBits = device_.physical().getQueueFamilyProperties()[indices.graphicsFamily.value()].timestampValidBits;
+		if (timestampValidBits == 0)
+			throw std::runtime_error{ "failed to create tile scheduler. graphics queue does not support timestamps" };
+		if (timestampValidBits < 64)
+			timestampMask_ = (1ull << timestampValidBits) - 1;
+		timestampPeriod_ = static_cast<double>(device_.physical().getProperties().limits.timestampPeriod);
+
+		createTiles(std::max(tileSize, 16u));
+		createTarget();
+		createRenderPass();
+		createQueryPool(swapchain.size());
+
+		Log_info("frames are drawn in {} tiles of {} px, {:.1f} ms of gpu time per refresh", tiles_.size(), std::max(tileSize, 16u), budget_);
+	}
+
+	TileScheduler::~TileScheduler() noexcept {
+		framebuffer_.reset();
+		if (view_)
+			device_.logical().destroyImageView(view_);
+		if (image_)
+			device_.logical().destroyImage(image_);
+		if (memory_)
+			device_.freeMemory(memory_);
+	}
+
+	void TileScheduler::schedule(uint32_t slot, bool restart, uint32_t count) {
+		currentSlot_ = slot;
+
+		if (measured_[slot] != 0) {
+			std::array<uint64_t, 2> timestamps{};
+			const auto result = device_.logical().getQueryPoolResults(*queryPool_,
+																	  slot * 2,
+																	  2,
+																	  timestamps.size() * sizeof(uint64_t),
+																	  timestamps.data(),
+																	  sizeof(uint64_t),
+																	  vk::QueryResultFlagBits::e64);
+			if (result == vk::Result::eSuccess) {
+				const auto ticks = ((timestamps[1] & timestampMask_) - (timestamps[0] & timestampMask_)) & timestampMask_;
+				const auto time = static_cast<double>(ticks) * timestampPeriod_ / 1e6 / measured_[slot];
+				tileTime_ = tileTime_ == 0.0 ? time : tileTime_ + SMOOTHING * (time - tileTime_);
+			}
+			measured_[slot] = 0;
+		}
+
+		if (restart || finished())
+			last_ = 0;
+		first_ = last_;
+
+		// a single tile until the first measurement comes back, at least one tile so every pass ends
+		if (count == 0) {
+			count = 1;
+			if (tileTime_ > 0.0)
+				count = std::max(1u, static_cast<uint32_t>(std::min(budget_ / tileTime_, static_cast<double>(tiles_.size()))));
+		}
+		last_ = std::min(first_ + count, tiles_.size());
+	}
+
+	void TileScheduler::beginRenderPass(vk::CommandBuffer commandBuffer) {
+		if (!cleared_) {
+			vk::ImageMemoryBarrier barrier{};
+			barrier.setImage(image_);
+			barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+			barrier.setOldLayout(vk::ImageLayout::eUndefined);
+			barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+			const vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+			commandBuffer.clearColorImage(image_, vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue{ CLEAR_COLOR }, range);
+
+			// the render pass expects the layout the copies leave behind
+			barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eColorAttachmentOutput, {}, nullptr, nullptr, barrier);
+			cleared_ = true;
+		}
+
+		commandBuffer.resetQueryPool(*queryPool_, currentSlot_ * 2, 2);
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *queryPool_, currentSlot_ * 2);
+
+		vk::RenderPassBeginInfo renderPassBeginInfo{};
+		renderPassBeginInfo.setRenderPass(*renderPass_);
+		renderPassBeginInfo.setFramebuffer(*framebuffer_);
+		renderPassBeginInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+		renderPassBeginInfo.renderArea.extent = extent_;
+
+		commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+	}
+
+	void TileScheduler::endRenderPass(vk::CommandBuffer commandBuffer, vk::Image swapchainImage) {
+		commandBuffer.endRenderPass();
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *queryPool_, currentSlot_ * 2 + 1);
+		measured_[currentSlot_] = count();
+
+		// the swapchain image is acquired once the transfer stage waits, see Swapchain::submit
+		vk::ImageMemoryBarrier barrier{};
+		barrier.setImage(swapchainImage);
+		barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+		vk::ImageCopy region{};
+		region.setSrcSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+		region.setDstSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+		region.setExtent({ extent_.width, extent_.height, 1 });
+		commandBuffer.copyImage(image_, vk::ImageLayout::eTransferSrcOptimal, swapchainImage, vk::ImageLayout::eTransferDstOptimal, region);
+
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setDstAccessMask({});
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, barrier);
+	}
+
+	void TileScheduler::createTiles(uint32_t tileSize) {
+		for (uint32_t y = 0; y < extent_.height; y += tileSize) {
+			for (uint32_t x = 0; x < extent_.width; x += tileSize) {
+				const vk::Extent2D size{ std::min(tileSize, extent_.width - x), std::min(tileSize, extent_.height - y) };
+				tiles_.push_back({ { static_cast<int32_t>(x), static_cast<int32_t>(y) }, size });
+			}
+		}
+
+		// the centre is usually what is looked at, it is refreshed first
+		const auto distance = [&](const vk::Rect2D& tile) {
+			const auto dx = (2.0 * tile.offset.x + tile.extent.width - extent_.width) * 0.5;
+			const auto dy = (2.0 * tile.offset.y + tile.extent.height - extent_.height) * 0.5;
+			return dx * dx + dy * dy;
+		};
+		std::stable_sort(tiles_.begin(), tiles_.end(), [&](const vk::Rect2D& a, const vk::Rect2D& b) {
+			return distance(a) < distance(b);
+		});
+
+		// the first refresh begins a pass
+		last_ = tiles_.size();
+	}
+
+	void TileScheduler::createTarget() {
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.setImageType(vk::ImageType::e2D);
+		imageCreateInfo.setFormat(format_);
+		imageCreateInfo.setExtent({ extent_.width, extent_.height, 1 });
+		imageCreateInfo.setMipLevels(1);
+		imageCreateInfo.setArrayLayers(1);
+		imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+		imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+		imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+		imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+
+		std::tie(image_, memory_) = device_.createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, "tile target");
+		if (!image_)
+			throw std::runtime_error{ "failed to create tile target" };
+
+		vk::ImageViewCreateInfo imageViewCreateInfo{};
+		imageViewCreateInfo.setImage(image_);
+		imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+		imageViewCreateInfo.setFormat(format_);
+		imageViewCreateInfo.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+
+		try {
+			view_ = device_.logical().createImageView(imageViewCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create tile target view. error {}", err.what());
+			throw;
+		}
+	}
+
+	void TileScheduler::createRenderPass() {
+		// the tiles not drawn by a refresh keep what the previous passes left
+		vk::AttachmentDescription colorAttachment{};
+		colorAttachment.setFormat(format_);
+		colorAttachment.setSamples(vk::SampleCountFlagBits::e1);
+		colorAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad);
+		colorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
+		colorAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+		colorAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+		colorAttachment.setInitialLayout(vk::ImageLayout::eTransferSrcOptimal);
+		colorAttachment.setFinalLayout(vk::ImageLayout::eTransferSrcOptimal);
+
+		vk::AttachmentReference colorAttachmentRef{ 0, vk::ImageLayout::eColorAttachmentOptimal };
+
+		vk::SubpassDescription subpass{};
+		subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+		subpass.setColorAttachments(colorAttachmentRef);
+
+		// the draws wait for the copy of the previous refresh, the copy of this one for the draws
+		std::array<vk::SubpassDependency, 2> dependencies{};
+		dependencies[0].setSrcSubpass(VK_SUBPASS_EXTERNAL);
+		dependencies[0].setDstSubpass(0);
+		dependencies[0].setSrcStageMask(vk::PipelineStageFlagBits::eTransfer);
+		dependencies[0].setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+		dependencies[0].setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
+		dependencies[1].setSrcSubpass(0);
+		dependencies[1].setDstSubpass(VK_SUBPASS_EXTERNAL);
+		dependencies[1].setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+		dependencies[1].setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+		dependencies[1].setDstStageMask(vk::PipelineStageFlagBits::eTransfer);
+		dependencies[1].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+
+		vk::RenderPassCreateInfo renderPassCreateInfo{};
+		renderPassCreateInfo.setAttachments(colorAttachment);
+		renderPassCreateInfo.setSubpasses(subpass);
+		renderPassCreateInfo.setDependencies(dependencies);
+
+		vk::FramebufferCreateInfo framebufferCreateInfo{};
+		framebufferCreateInfo.setAttachments(view_);
+		framebufferCreateInfo.setWidth(extent_.width);
+		framebufferCreateInfo.setHeight(extent_.height);
+		framebufferCreateInfo.setLayers(1);
+
+		try {
+			renderPass_ = device_.logical().createRenderPassUnique(renderPassCreateInfo);
+			framebufferCreateInfo.setRenderPass(*renderPass_);
+			framebuffer_ = device_.logical().createFramebufferUnique(framebufferCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create tile render pass. error {}", err.what());
+			throw;
+		}
+	}
+
+	void TileScheduler::createQueryPool(uint32_t slotCount) {
+		measured_.assign(slotCount, 0);
+
+		vk::QueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.setQueryType(vk::QueryType::eTimestamp);
+		queryPoolCreateInfo.setQueryCount(slotCount * 2);
+
+		try {
+			queryPool_ = device_.logical().createQueryPoolUnique(queryPoolCreateInfo);
+		}
+		catch (const vk::SystemError& err) {
+			Log_error("failed to create vulkan query pool. error {}", err.what());
+			throw;
+		}
+	}
+
+}
\ No newline at end of file
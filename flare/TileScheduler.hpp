@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+namespace fve {
+
+	class Device;
+	class Swapchain;
+
+	// spreads frames that are too expensive for one refresh over several. the frame is split into
+	// tiles ordered from the screen centre outwards, every refresh draws the next tiles into a
+	// persistent target, as many as fit the gpu time budget, and copies the target into the
+	// swapchain image. the partially updated image is presented in between, so the refresh rate
+	// holds however heavy the shaders get. the cost of a tile is measured with timestamps around
+	// the render pass of every refresh
+	//
+	// a pass is the sequence of refreshes that draws every tile once. a pass that fits the budget
+	// draws every tile in one refresh, like rendering without the scheduler
+	class TileScheduler final {
+	public:
+		explicit TileScheduler(Device& device, const Swapchain& swapchain, uint32_t tileSize, float budget);
+
+		~TileScheduler() noexcept;
+
+		TileScheduler(const TileScheduler&) = delete;
+		TileScheduler& operator=(const TileScheduler&) = delete;
+
+		// compatible with the render pass of the swapchain, the pipelines are shared
+		inline vk::RenderPass renderPass() const noexcept { return *renderPass_; }
+		inline vk::Framebuffer framebuffer() const noexcept { return *framebuffer_; }
+
+		// the tiles drawn by this refresh
+		inline uint32_t count() const noexcept { return static_cast<uint32_t>(last_ - first_); }
+		inline const vk::Rect2D& tile(uint32_t index) const noexcept { return tiles_[first_ + index]; }
+		// true when this refresh draws the first tiles of a pass
+		inline bool first() const noexcept { return first_ == 0; }
+		// true when this refresh draws the last tiles of a pass
+		inline bool finished() const noexcept { return last_ == tiles_.size(); }
+		// true when this refresh draws the whole pass
+		inline bool whole() const noexcept { return first() && finished(); }
+
+		// reads the timings of the previous refresh of the slot and picks the tiles of this one. a
+		// new pass begins once the previous one is finished, or right away on restart. the previous
+		// frame of the slot has to be done. a count other than 0 draws that many tiles instead of
+		// as many as the measured tile time fits into the budget, replays pass the captured one
+		void schedule(uint32_t slot, bool restart, uint32_t count = 0);
+
+		// outside of a render pass, around the draws of the scheduled tiles. the target is copied
+		// into the swapchain image, which is left ready to present
+		void beginRenderPass(vk::CommandBuffer commandBuffer);
+		void endRenderPass(vk::CommandBuffer commandBuffer, vk::Image swapchainImage);
+
+	private:
+		void createTiles(uint32_t tileSize);
+		void createTarget();
+		void createRenderPass();
+		void createQueryPool(uint32_t slotCount);
+
+		Device& device_;
+		vk::Extent2D extent_;
+		vk::Format format_;
+		float budget_;
+		// sorted by the distance of their centre to the centre of the screen
+		std::vector<vk::Rect2D> tiles_;
+		size_t first_ = 0;
+		size_t last_ = 0;
+		// milliseconds of gpu time per tile, smoothed over the refreshes, 0 until measured
+		double tileTime_ = 0.0;
+		double timestampPeriod_ = 1.0;
+		uint64_t timestampMask_ = ~0ull;
+		uint32_t currentSlot_ = 0;
+		// tiles drawn by the last refresh of every slot, 0 when there is nothing to read
+		std::vector<uint32_t> measured_;
+		bool cleared_ = false;
+		vk::Image image_;
+		vk::DeviceMemory memory_;
+		vk::ImageView view_;
+		vk::UniqueRenderPass renderPass_;
+		vk::UniqueFramebuffer framebuffer_;
+		vk::UniqueQueryPool queryPool_;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+
+namespace {
+	// chrome trace json has no notion of a gpu, the gpu timeline is shown as a separate thread
+	static constexpr uint32_t GPU_THREAD_ID = 0x7fffffff;
+
+	// a json string without its quotes. names come from shader and file names, which may contain
+	// quotes, backslashes and control characters
+	struct Escaped {
+		const char* text;
+	};
+
+	std::ostream& operator<<(std::ostream& os, Escaped escaped) {
+		static constexpr char HEX[] = "0123456789abcdef";
+		for (auto c = escaped.text; c && *c; ++c) {
+			const auto byte = static_cast<unsigned char>(*c);
+			switch (byte) {
+			case '"': os << "\\\""; break;
+			case '\\': os << "\\\\"; break;
+			case '\n': os << "\\n"; break;
+			case '\r': os << "\\r"; break;
+			case '\t': os << "\\t"; break;
+			default:
+				if (byte < 0x20)
+					os << "\\u00" << HEX[byte >> 4] << HEX[byte & 0xf];
+				else
+					os << *c;
+			}
+		}
+		return os;
+	}
+}
+
+namespace fve {
+
+	std::atomic<bool> Trace::enabled_{ false };
+	std::mutex Trace::mutex_;
+	std::vector<std::unique_ptr<Trace::ThreadBuffer>> Trace::buffers_;
+	Trace::ThreadBuffer Trace::gpuBuffer_;
+	std::unordered_set<std::string> Trace::names_;
+
+	int64_t Trace::now() noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Trace::enable(bool enabled) noexcept {
+		enabled_.store(enabled, std::memory_order_relaxed);
+	}
+
+	void Trace::setThreadName(const std::string& name) {
+		auto& buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		buffer.name = name;
+	}
+
+	const char* Trace::intern(const std::string& name) {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return names_.insert(name).first->c_str();
+	}
+
+	void Trace::event(const char* name, int64_t begin, int64_t end) noexcept {
+		threadBuffer().push({ name, begin, end });
+	}
+
+	void Trace::gpuEvent(const char* name, int64_t begin, int64_t end) noexcept {
+		gpuBuffer_.push({ name, begin, end });
+	}
+
+	void Trace::ThreadBuffer::push(const Event& event) noexcept {
+		auto count = tail->count.load(std::memory_order_relaxed);
+		if (count == CHUNK_SIZE) {
+			try {
+				chunks.emplace_back(std::make_unique<Chunk>());
+			}
+			catch (...) {
+				return;
+			}
+			tail->next.store(chunks.back().get(), std::memory_order_release);
+			tail = chunks.back().get();
+			count = 0;
+		}
+		tail->events[count] = event;
+		tail->count.store(count + 1, std::memory_order_release);
+	}
+
+	Trace::ThreadBuffer& Trace::threadBuffer() {
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			buffers_.emplace_back(std::make_unique<ThreadBuffer>());
+			buffer = buffers_.back().get();
+			buffer->id = static_cast<uint32_t>(buffers_.size());
+			buffer->name = "thread " + std::to_string(buffer->id);
+		}
+		return *buffer;
+	}
+
+	bool Trace::write(const std::string& filepath) noexcept {
+		try {
+			std::ofstream file{ filepath, std::ios::out | std::ios::trunc };
+			if (!file.is_open()) {
+				Log_error("failed to open file {} for writing", filepath);
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lock{ mutex_ };
+
+			gpuBuffer_.id = GPU_THREAD_ID;
+			gpuBuffer_.name = "gpu";
+
+			std::vector<const ThreadBuffer*> buffers;
+			for (const auto& buffer : buffers_)
+				buffers.push_back(buffer.get());
+			buffers.push_back(&gpuBuffer_);
+
+			int64_t origin = std::numeric_limits<int64_t>::max();
+			for (auto buffer : buffers) {
+				for (auto chunk = buffer->head.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+					const auto count = chunk->count.load(std::memory_order_acquire);
+					for (size_t i = 0; i < count; ++i)
+						origin = std::min(origin, chunk->events[i].begin);
+				}
+			}
+
+			// chrome trace timestamps are in microseconds
+			auto us = [origin](int64_t ns) { return static_cast<double>(ns - origin) / 1000.0; };
+
+			size_t eventCount = 0;
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			file << std::fixed;
+			file.precision(3);
+			bool first = true;
+			for (auto buffer : buffers) {
+				file << (first ? "" : ",\n")
+					<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+					<< ",\"args\":{\"name\":\"" << Escaped{ buffer->name.c_str() } << "\"}}";
+				first = false;
+				for (auto chunk = buffer->head.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+					const auto count = chunk->count.load(std::memory_order_acquire);
+					for (size_t i = 0; i < count; ++i) {
+						const auto& event = chunk->events[i];
+						file << ",\n{\"name\":\"" << Escaped{ event.name }
+							<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+							<< ",\"ts\":" << us(event.begin)
+							<< ",\"dur\":" << static_cast<double>(event.end - event.begin) / 1000.0 << "}";
+					}
+					eventCount += count;
+				}
+			}
+			file << "\n]}\n";
+
+			Log_info("trace with {} events written to {}", eventCount, filepath);
+			return true;
+		}
+		catch (const std::exception& ex) {
+			Log_error("failed to write trace into file {}. error {}", filepath, ex.what());
+		}
+		catch (...) {
+			Log_error("failed to write trace into file {}. unknown error", filepath);
+		}
+		return false;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#define Trace_concat_impl(a, b) a##b
+#define Trace_concat(a, b) Trace_concat_impl(a, b)
+#define Trace_zone(name) fve::Trace::Zone Trace_concat(traceZone, __LINE__){ name }
+
+namespace fve {
+
+	// collects scoped cpu zones into per-thread buffers and exports them as chrome trace json,
+	// which can be opened in chrome://tracing or ui.perfetto.dev. every thread appends to its own
+	// buffer without locks, the global mutex is only taken the first time a thread records a zone
+	class Trace {
+	public:
+		struct Event {
+			const char* name;
+			int64_t begin;
+			int64_t end;
+		};
+
+		class Zone final {
+		public:
+			explicit Zone(const char* name) noexcept : name_{ name }, begin_{ enabled() ? now() : 0 } {
+			}
+
+			~Zone() noexcept {
+				if (begin_ != 0)
+					Trace::event(name_, begin_, now());
+			}
+
+			Zone(const Zone&) = delete;
+			Zone& operator=(const Zone&) = delete;
+
+		private:
+			const char* name_;
+			int64_t begin_;
+		};
+
+		static constexpr size_t CHUNK_SIZE = 4096;
+
+		Trace() = delete;
+		~Trace() = delete;
+
+		Trace(const Trace&) = delete;
+		Trace& operator=(const Trace&) = delete;
+
+		// steady clock in nanoseconds, the time base for every cpu and gpu event
+		static int64_t now() noexcept;
+
+		inline static bool enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+		static void enable(bool enabled) noexcept;
+
+		static void setThreadName(const std::string& name);
+		// events keep the pointer to their name until the trace is written. names that do not live as
+		// long, like those built at runtime, are copied into a table that does and looked up there
+		static const char* intern(const std::string& name);
+
+		// records a complete event on the calling thread
+		static void event(const char* name, int64_t begin, int64_t end) noexcept;
+		// records a complete event on the gpu track. timestamps must already be in the cpu time base
+		static void gpuEvent(const char* name, int64_t begin, int64_t end) noexcept;
+
+		static bool write(const std::string& filepath) noexcept;
+
+	private:
+		struct Chunk {
+			std::array<Event, CHUNK_SIZE> events;
+			std::atomic<size_t> count{ 0 };
+			std::atomic<Chunk*> next{ nullptr };
+		};
+
+		// written by a single thread only. the exporter walks the chunks with acquire loads, so it can
+		// run while the owning thread keeps recording
+		struct ThreadBuffer {
+			uint32_t id = 0;
+			std::string name;
+			std::unique_ptr<Chunk> head = std::make_unique<Chunk>();
+			Chunk* tail = head.get();
+			std::vector<std::unique_ptr<Chunk>> chunks;
+
+			void push(const Event& event) noexcept;
+		};
+
+		static ThreadBuffer& threadBuffer();
+
+		static std::atomic<bool> enabled_;
+		static std::mutex mutex_;
+		static std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+		static ThreadBuffer gpuBuffer_;
+		// nodes of an unordered_set do not move, the pointers into them stay valid
+		static std::unordered_set<std::string> names_;
+
+	};
+
+}
\ No newline at end of file
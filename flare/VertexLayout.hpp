@@ -0,0 +1,211 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+namespace fve {
+
+	// vertex attribute formats. every attribute converts between the value the application works
+	// with and the bytes the vertex fetch reads, sizes are multiples of 4 so attributes stay aligned
+	namespace attributes {
+
+		template<typename T, vk::Format F>
+		struct Plain {
+			using Value = T;
+			static constexpr vk::Format format = F;
+			static constexpr uint32_t size = sizeof(T);
+
+			static inline void encode(const Value& value, uint8_t* bytes) noexcept { std::memcpy(bytes, &value, size); }
+			static inline Value decode(const uint8_t* bytes) noexcept {
+				Value value;
+				std::memcpy(&value, bytes, size);
+				return value;
+			}
+		};
+
+		template<typename T, typename P, vk::Format F, P(*Pack)(const T&), T(*Unpack)(P)>
+		struct Packed {
+			using Value = T;
+			static constexpr vk::Format format = F;
+			static constexpr uint32_t size = sizeof(P);
+
+			static inline void encode(const Value& value, uint8_t* bytes) noexcept {
+				const P packed = Pack(value);
+				std::memcpy(bytes, &packed, size);
+			}
+			static inline Value decode(const uint8_t* bytes) noexcept {
+				P packed;
+				std::memcpy(&packed, bytes, size);
+				return Unpack(packed);
+			}
+		};
+
+		inline glm::uint64 packHalf4(const glm::vec4& v) noexcept { return glm::packHalf4x16(v); }
+		inline glm::vec4 unpackHalf4(glm::uint64 p) noexcept { return glm::unpackHalf4x16(p); }
+		inline glm::uint32 packHalf2(const glm::vec2& v) noexcept { return glm::packHalf2x16(v); }
+		inline glm::vec2 unpackHalf2(glm::uint32 p) noexcept { return glm::unpackHalf2x16(p); }
+		inline glm::uint64 packSnorm4(const glm::vec4& v) noexcept { return glm::packSnorm4x16(v); }
+		inline glm::vec4 unpackSnorm4(glm::uint64 p) noexcept { return glm::unpackSnorm4x16(p); }
+		inline glm::uint32 packSnorm2(const glm::vec2& v) noexcept { return glm::packSnorm2x16(v); }
+		inline glm::vec2 unpackSnorm2(glm::uint32 p) noexcept { return glm::unpackSnorm2x16(p); }
+		// signed values are stored biased, A2B10G10R10 unorm is a mandatory vertex format unlike snorm
+		inline glm::uint32 packNormal(const glm::vec3& v) noexcept { return glm::packUnorm3x10_1x2(glm::vec4{ v * 0.5f + 0.5f, 0.0f }); }
+		inline glm::vec3 unpackNormal(glm::uint32 p) noexcept { return glm::vec3{ glm::unpackUnorm3x10_1x2(p) } * 2.0f - 1.0f; }
+		inline glm::uint32 packColor(const glm::vec4& v) noexcept { return glm::packUnorm4x8(v); }
+		inline glm::vec4 unpackColor(glm::uint32 p) noexcept { return glm::unpackUnorm4x8(p); }
+
+		using Float2 = Plain<glm::vec2, vk::Format::eR32G32Sfloat>;
+		using Float3 = Plain<glm::vec3, vk::Format::eR32G32B32Sfloat>;
+		using Float4 = Plain<glm::vec4, vk::Format::eR32G32B32A32Sfloat>;
+		using Half2 = Packed<glm::vec2, glm::uint32, vk::Format::eR16G16Sfloat, packHalf2, unpackHalf2>;
+		using Half4 = Packed<glm::vec4, glm::uint64, vk::Format::eR16G16B16A16Sfloat, packHalf4, unpackHalf4>;
+		// values in [-1, 1], positions have to be normalized to the bounds of the mesh first
+		using Snorm16x2 = Packed<glm::vec2, glm::uint32, vk::Format::eR16G16Snorm, packSnorm2, unpackSnorm2>;
+		using Snorm16x4 = Packed<glm::vec4, glm::uint64, vk::Format::eR16G16B16A16Snorm, packSnorm4, unpackSnorm4>;
+		// unit vectors in 10:10:10:2, read in the shader as normal * 2.0 - 1.0
+		using Normal1010102 = Packed<glm::vec3, glm::uint32, vk::Format::eA2B10G10R10UnormPack32, packNormal, unpackNormal>;
+		using Unorm8x4 = Packed<glm::vec4, glm::uint32, vk::Format::eR8G8B8A8Unorm, packColor, unpackColor>;
+
+	}
+
+	// interleaved vertex made of the attributes in order. the stride, the offsets and the vulkan
+	// descriptions are computed at compile time from the attribute formats
+	template<typename... Attributes>
+	struct VertexLayout {
+		static_assert(sizeof...(Attributes) > 0, "a vertex needs at least one attribute");
+		static_assert(((Attributes::size % 4 == 0) && ...), "attribute sizes must be multiples of 4");
+
+		static constexpr uint32_t attributeCount = sizeof...(Attributes);
+		static constexpr uint32_t stride = (Attributes::size + ...);
+		static constexpr std::array<uint32_t, attributeCount> offsets = []() {
+			std::array<uint32_t, attributeCount> offsets{};
+			uint32_t offset = 0;
+			size_t i = 0;
+			((offsets[i++] = offset, offset += Attributes::size), ...);
+			return offsets;
+		}();
+
+		template<size_t I>
+		using Attribute = std::tuple_element_t<I, std::tuple<Attributes...>>;
+
+		static constexpr std::array<vk::VertexInputAttributeDescription, attributeCount> attributes(uint32_t binding, uint32_t firstLocation) noexcept {
+			std::array<vk::VertexInputAttributeDescription, attributeCount> descriptions{};
+			constexpr std::array<vk::Format, attributeCount> formats{ Attributes::format... };
+			for (uint32_t i = 0; i < attributeCount; ++i)
+				descriptions[i] = vk::VertexInputAttributeDescription{ firstLocation + i, binding, formats[i], offsets[i] };
+			return descriptions;
+		}
+
+		struct alignas(4) Vertex {
+			Vertex() = default;
+			Vertex(const typename Attributes::Value&... values) noexcept {
+				size_t i = 0;
+				(Attributes::encode(values, bytes.data() + offsets[i++]), ...);
+			}
+
+			template<size_t I>
+			inline typename Attribute<I>::Value get() const noexcept { return Attribute<I>::decode(bytes.data() + offsets[I]); }
+
+			template<size_t I>
+			inline void set(const typename Attribute<I>::Value& value) noexcept { Attribute<I>::encode(value, bytes.data() + offsets[I]); }
+
+			inline static std::vector<vk::VertexInputBindingDescription> bindingDescriptions(uint32_t binding = 0) noexcept {
+				std::vector<vk::VertexInputBindingDescription> bindingDescriptions{};
+				bindingDescriptions.push_back({ binding, stride, vk::VertexInputRate::eVertex });
+				return bindingDescriptions;
+			}
+
+			inline static std::vector<vk::VertexInputAttributeDescription> attributeDescriptions(uint32_t binding = 0, uint32_t firstLocation = 0) noexcept {
+				const auto descriptions = attributes(binding, firstLocation);
+				return { descriptions.begin(), descriptions.end() };
+			}
+
+			inline bool operator==(const Vertex& other) const noexcept {
+				return bytes == other.bytes;
+			}
+
+			std::array<uint8_t, stride> bytes{};
+		};
+	};
+
+	namespace layouts {
+
+		// 12 bytes, what the canvas, the geometry arena and the mesh files use
+		using Position = VertexLayout<attributes::Float3>;
+		// 8 bytes, positions normalized to the bounds of the mesh
+		using CompactPosition = VertexLayout<attributes::Snorm16x4>;
+		// position, normal and texture coordinates, 32 bytes as floats and 16 bytes quantized
+		using Lit = VertexLayout<attributes::Float3, attributes::Float3, attributes::Float2>;
+		using CompactLit = VertexLayout<attributes::Snorm16x4, attributes::Normal1010102, attributes::Half2>;
+		// position and color, 28 bytes as floats and 12 bytes quantized
+		using PointCloud = VertexLayout<attributes::Float3, attributes::Float4>;
+		using CompactPointCloud = VertexLayout<attributes::Half4, attributes::Unorm8x4>;
+
+		// the layouts above as stored in mesh files and the geometry arena, the values are part of
+		// the file format
+		enum class Id : uint32_t {
+			Position = 0,
+			CompactPosition = 1,
+			Lit = 2,
+			CompactLit = 3,
+			PointCloud = 4,
+			CompactPointCloud = 5,
+			Count
+		};
+
+		// box around the positions of a mesh. snorm positions are stored relative to it, from -1 at
+		// min to 1 at max on every axis
+		struct Bounds {
+			glm::vec3 min{ 0.0f };
+			glm::vec3 max{ 0.0f };
+
+			inline glm::vec3 center() const noexcept { return 0.5f * (min + max); }
+			// half the size, axes without extent are treated as 1 so quantizing never divides by 0
+			inline glm::vec3 extent() const noexcept {
+				const auto extent = 0.5f * (max - min);
+				return glm::vec3{ extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f };
+			}
+		};
+
+		// calls f with the layout type of the id, f gets a default constructed layout
+		template<typename F>
+		inline decltype(auto) visit(Id id, F&& f) {
+			switch (id) {
+			case Id::CompactPosition: return f(CompactPosition{});
+			case Id::Lit: return f(Lit{});
+			case Id::CompactLit: return f(CompactLit{});
+			case Id::PointCloud: return f(PointCloud{});
+			case Id::CompactPointCloud: return f(CompactPointCloud{});
+			default: return f(Position{});
+			}
+		}
+
+		inline bool valid(uint32_t id) noexcept { return id < static_cast<uint32_t>(Id::Count); }
+
+		inline uint32_t stride(Id id) noexcept {
+			return visit(id, [](auto layout) { return decltype(layout)::stride; });
+		}
+
+		// the first attribute of every layout is the position
+		inline vk::VertexInputAttributeDescription positionDescription(Id id, uint32_t binding = 0, uint32_t location = 0) noexcept {
+			return visit(id, [&](auto layout) { return decltype(layout)::attributes(binding, location)[0]; });
+		}
+
+		// positions in snorm16 have to be scaled back with the bounds of the mesh
+		inline bool quantized(Id id) noexcept {
+			return id == Id::CompactPosition || id == Id::CompactLit;
+		}
+
+	}
+
+}
\ No newline at end of file
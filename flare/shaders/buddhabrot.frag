@@ -0,0 +1,38 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// tone maps the histogram accumulated by buddhabrot.comp
+
+layout(location = 0) in flat vec4 cell;
+layout(location = 1) in flat vec4 parameters;
+
+layout(location = 0) out vec4 fragColor;
+
+// per channel gain of the exposure, the red channel has the longest orbits
+const vec3 EXPOSURE = vec3(0.02, 0.05, 0.15);
+
+layout(set = 1, binding = 0) readonly buffer Histogram {
+    uint histogram[];
+};
+
+layout(set = 1, binding = 1) readonly buffer Resolve {
+    uint width;
+    uint height;
+    // samples per pixel accumulated so far, makes the brightness independent of the progress
+    float density;
+} resolve;
+
+void main() {
+	vec2 resolution = vec2(resolve.width, resolve.height);
+	vec2 uv = (gl_FragCoord.xy - cell.xy - 0.5 * cell.zw) / cell.w;
+	vec2 p = uv * resolution.y + 0.5 * resolution;
+
+	vec3 col = vec3(0);
+	if (all(greaterThanEqual(p, vec2(0.))) && all(lessThan(p, resolution)) && resolve.density > 0.) {
+		uint bin = (uint(p.y) * resolve.width + uint(p.x)) * 3u;
+		vec3 counts = vec3(histogram[bin], histogram[bin + 1u], histogram[bin + 2u]);
+		col = 1.0 - exp(-EXPOSURE * counts / resolve.density);
+	}
+
+	fragColor = vec4(col, 1.0);
+}
\ No newline at end of file
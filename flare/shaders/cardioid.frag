@@ -1,5 +1,10 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+layout(location = 0) in flat vec4 cell;
+layout(location = 1) in flat vec4 parameters;
+layout(location = 2) in flat uint instance;
 
 layout(location = 0) out vec4 fragColor;
 
@@ -8,32 +13,41 @@ layout(push_constant) uniform globalConstant {
 	float time;
 } global;
 
+// curve points written once per frame by cardioid.prologue.comp
+#include "cardioid.glsl"
+
+layout(set = 4, binding = 0) readonly buffer Records {
+    Record records[];
+};
+
 vec2 rotate(in vec2 uv, in float a) {
 	float c = cos(a);
 	float s = sin(a);
 	return mat2(c, -s, s, c) * uv;
 }
 
-float cardioid(in vec2 uv, in float r) {
+// quality knob, selected per pipeline variant without recompiling the shader
+layout(constant_id = 0) const int STEPS = 60;
+
+float cardioid(in vec2 uv) {
+	// the curve parameter advances by 1 + f per point until it reaches STEPS
+	uint count = min(uint(ceil(float(STEPS) / records[instance].advance)), MAX_POINTS);
 	float c = 0.;
-	for (float i = 0.0; i < 60.0; ++i) {
-		float f = (sin(global.time) * 0.5 + 0.5) + 0.3;
-		i += f;
-		float a = i / 5;
-		float dx = 2 * r * cos(a) - r * cos(2.0 * a);
-		float dy = 2 * r * sin(a) - r * sin(2.0 * a);
-		c += 0.01 * f / length(uv - vec2(dx + 0.1, dy));
-	}
-	return c;
+	for (uint i = 0u; i < count; ++i)
+		c += 1.0 / length(uv - records[instance].points[i]);
+	return c * records[instance].weight;
 }
 
 void main() {
-	vec2 uv = (gl_FragCoord.xy - 0.5 * global.resolution.xy) / global.resolution.y;
+	// parameters.x offsets the time, so cells of the same effect do not animate in lockstep
+	float time = global.time + parameters.x;
+
+	vec2 uv = (gl_FragCoord.xy - cell.xy - 0.5 * cell.zw) / cell.w;
 	uv = rotate(uv, -1.0 * 3.14 / 2.0);
 
 	vec3 col = vec3(0.0);
-	col += cardioid(uv, 0.17);
-	col *= sin(vec3(0.2, 0.8, 0.9) * global.time) * 0.15 + 0.25;
+	col += cardioid(uv);
+	col *= sin(vec3(0.2, 0.8, 0.9) * time) * 0.15 + 0.25;
 
 	fragColor = vec4(col, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// BINDLESS reads the channels from the bindless table, with the handles in the push constants
+#pragma keywords _ BINDLESS
+
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : enable
+#endif
+
+layout(location = 0) in flat vec4 cell;
+layout(location = 1) in flat vec4 parameters;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(push_constant) uniform globalConstant {
+    vec2 resolution;
+	float time;
+#ifdef BINDLESS
+	layout(offset = 48) uvec4 channels;
+#endif
+} global;
+
+// the channels of the effect, black until the images are streamed in
+#ifdef BINDLESS
+layout(set = 5, binding = 0) uniform sampler2D images[];
+#define iChannel0 images[global.channels.x]
+#define iChannel1 images[global.channels.y]
+#define iChannel2 images[global.channels.z]
+#define iChannel3 images[global.channels.w]
+#else
+layout(set = 2, binding = 0) uniform sampler2D iChannel0;
+layout(set = 2, binding = 1) uniform sampler2D iChannel1;
+layout(set = 2, binding = 2) uniform sampler2D iChannel2;
+layout(set = 2, binding = 3) uniform sampler2D iChannel3;
+#endif
+
+void main() {
+	// parameters.x scales the swirl, the channels are blended in the quadrants of the cell
+	vec2 uv = (gl_FragCoord.xy - cell.xy) / cell.zw;
+	vec2 p = uv - 0.5;
+	float r = length(p);
+	float a = atan(p.y, p.x) + (1.0 + parameters.x) * 0.5 * sin(global.time - 4.0 * r);
+	vec2 st = vec2(0.5) + r * vec2(cos(a), sin(a));
+
+	vec2 w = smoothstep(0.3, 0.7, uv);
+	vec3 top = mix(texture(iChannel0, st).rgb, texture(iChannel1, st).rgb, w.x);
+	vec3 bottom = mix(texture(iChannel2, st).rgb, texture(iChannel3, st).rgb, w.x);
+
+	fragColor = vec4(mix(top, bottom, w.y), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+// shared by cardioid.prologue.comp, which writes the records, and cardioid.frag, which reads them
+
+// the record fills the 4096 bytes of a frame prologue record
+const uint MAX_POINTS = 511u;
+
+struct Record {
+    // weight of every point and advance of the curve parameter per point
+    float weight;
+    float advance;
+    vec2 points[MAX_POINTS];
+};
\ No newline at end of file
@@ -0,0 +1,9 @@
+// shared by histogram.comp and histogram_scan.comp, which build the distribution of the escape
+// counts, and mandelbrot.frag, which colours by it. see IterationHistogram
+
+const uint HISTOGRAM_BINS = 2048u;
+
+// escape counts per bin, a bin only spans several counts beyond HISTOGRAM_BINS steps
+uint histogramBinWidth(in uint steps) {
+    return max(1u, (steps + HISTOGRAM_BINS - 1u) / HISTOGRAM_BINS);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+// shared by mandelbulb.cone.comp, which marches the cones of the depth pre-pass, and mandelbulb.frag,
+// which marches the rays of the pixels. both have to see the same camera and distances for the
+// depths of the pre-pass to be conservative
+
+// TILE_SIZE of ConeMarcher, pixels per side of a cone
+const uint CONE_TILE = 8u;
+// the fractal lies within this radius around the origin
+const float BOUND = 1.2;
+// distance of the image plane, in cell heights
+const float FOCAL = 1.5;
+const float POWER = 8.0;
+const int ITERATIONS = 8;
+
+struct Camera {
+    vec3 origin;
+    vec3 right;
+    vec3 up;
+    vec3 forward;
+    // rays that get further than this have missed
+    float far;
+};
+
+// the view orbits the fractal, dragging turns it and zooming moves the camera closer
+Camera camera(in vec2 center, in float scale, in float time) {
+    float yaw = 0.1 * time + center.x;
+    float pitch = clamp(center.y, -1.4, 1.4);
+    float distance = BOUND + scale;
+
+    Camera cam;
+    cam.origin = distance * vec3(cos(pitch) * sin(yaw), sin(pitch), cos(pitch) * cos(yaw));
+    cam.forward = normalize(-cam.origin);
+    cam.right = normalize(cross(cam.forward, vec3(0., 1., 0.)));
+    cam.up = cross(cam.right, cam.forward);
+    cam.far = distance + BOUND;
+    return cam;
+}
+
+// uv is the offset from the cell centre in cell heights, y pointing down like gl_FragCoord
+vec3 rayDirection(in Camera cam, in vec2 uv) {
+    return normalize(uv.x * cam.right - uv.y * cam.up + FOCAL * cam.forward);
+}
+
+// lower bound of the distance to the surface of the power 8 mandelbulb
+float distanceEstimate(in vec3 p) {
+    vec3 z = p;
+    float dr = 1.;
+    float r = length(z);
+
+    for (int i = 0; i < ITERATIONS; ++i) {
+        if (r > 2.) break;
+        float theta = acos(clamp(z.z / max(r, 1e-6), -1., 1.)) * POWER;
+        float phi = atan(z.y, z.x) * POWER;
+        dr = pow(r, POWER - 1.) * POWER * dr + 1.;
+        z = pow(r, POWER) * vec3(sin(theta) * cos(phi), sin(phi) * sin(theta), cos(theta)) + p;
+        r = length(z);
+    }
+
+    return 0.5 * log(max(r, 1e-6)) * r / dr;
+}
\ No newline at end of file
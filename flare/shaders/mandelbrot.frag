@@ -1,33 +1,159 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+#include "histogram.glsl"
+
+// framebuffer area of the instance, offset xy and size zw
+layout(location = 0) in flat vec4 cell;
+layout(location = 1) in flat vec4 parameters;
 
 layout(location = 0) out vec4 fragColor;
 
 layout(push_constant) uniform globalConstant {
     vec2 resolution;
 	float time;
+	float scale;
+	vec2 center;
+	// view of the previous frame, previousScale is 0 when there is no usable history
+	vec2 previousCenter;
+	float previousScale;
+	uint frame;
+	// 1 while the view is the one of the previous frame, also when previousScale is 0
+	uint still;
 } global;
 
-float mandelbrot(in vec2 uv) {
-    const float MAX_STEPS = 256.;
-    
-    vec2 c = 2.3*uv - vec2(0.5, 0.0);
+// quality knob, selected per pipeline variant without recompiling the shader
+layout(constant_id = 0) const int MAX_STEPS = 256;
+
+// per tile iteration budget from the previous frame, see iteration_budget.comp
+const uint TILE_SIZE = 16u;
+const uint BUDGET_FULL = 0xffffffffu;
+const uint INTERIOR = 0x80000000u;
+// set on values taken from a neighbouring sample of the previous frame, cleared once re-evaluated
+const uint REPROJECTED = 0x40000000u;
+const uint ITERATIONS = 0x3fffffffu;
+// previous samples closer than this (in pixels) are treated as an exact hit
+const float EXACT_OFFSET = 1e-3;
+
+struct Tile {
+    uint budget;
+    uint maxEscape;
+    uint interior;
+    uint pixels;
+};
+
+layout(set = 0, binding = 0) readonly buffer Tiles {
+    Tile tiles[];
+};
+
+layout(set = 0, binding = 1) writeonly buffer Iterations {
+    uint iterations[];
+};
+
+// iterations written by the previous frame
+layout(set = 0, binding = 2) readonly buffer History {
+    uint history[];
+};
+
+// shades of the edge pixels supersampled after the previous frame, negative elsewhere. see
+// supersample.comp
+layout(set = 3, binding = 0) readonly buffer Shades {
+    float shades[];
+};
+
+// distribution of the escape counts of the previous frame, see histogram_scan.comp
+layout(set = 6, binding = 0) readonly buffer Distribution {
+    uint escaped;
+    float cdf[];
+} distribution;
+
+uint mandelbrot(in vec2 c, in int steps) {
     vec2 z = vec2(0.);
 
-    for (float i = 0.; i < MAX_STEPS; ++i) {
+    for (int i = 0; i < MAX_STEPS; ++i) {
+        if (i >= steps) break;
         z = vec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
-        if (length(z) > 2.) return i/MAX_STEPS;
+        if (length(z) > 2.)
+            return uint(i);
     }
 
-    return 0.;
+    return uint(steps) | INTERIOR;
+}
+
+// maps an escape count onto the palette. every shade covers the same share of the escaped pixels
+// once there is a distribution, before that the count is scaled linearly. fractional counts, like
+// the averages of the supersampled shades, are interpolated between the bins
+float equalize(in float escape) {
+    if (distribution.escaped == 0u)
+        return escape / float(MAX_STEPS);
+
+    float position = escape / float(histogramBinWidth(uint(MAX_STEPS)));
+    uint bin = min(uint(position), HISTOGRAM_BINS - 1u);
+    uint next = min(bin + 1u, HISTOGRAM_BINS - 1u);
+    return mix(distribution.cdf[bin], distribution.cdf[next], fract(position));
+}
+
+// looks up the previous frame's sample nearest to c. reprojected values are refreshed on a
+// rotating 2x2 pattern so a moving view converges within four frames, exact hits on a rotating
+// 8x8 pattern so a still image is re-evaluated in full every 64 frames
+bool reproject(in vec2 c, in uvec2 pixel, out uint value) {
+    if (global.previousScale <= 0.)
+        return false;
+
+    vec2 previous = (c - global.previousCenter) / global.previousScale * cell.w + 0.5 * cell.zw;
+    if (any(lessThan(previous, vec2(0.))) || any(greaterThanEqual(previous, cell.zw)))
+        return false;
+
+    // distance to the previous sample in current pixels. when zooming in the previous samples
+    // are sparser than the pixels, those without a sample inside their footprint are evaluated
+    uvec2 source = uvec2(previous);
+    vec2 offset = (vec2(source) + 0.5 - previous) * global.previousScale / global.scale;
+    source += uvec2(cell.xy);
+    if (any(greaterThan(abs(offset), vec2(0.5))))
+        return false;
+
+    value = history[source.y * uint(global.resolution.x) + source.x];
+    if (length(offset) > EXACT_OFFSET)
+        value |= REPROJECTED;
+
+    uint phase = (value & REPROJECTED) != 0u
+        ? ((pixel.y & 1u) << 1) | (pixel.x & 1u)
+        : ((pixel.y & 7u) << 3) | (pixel.x & 7u);
+    uint period = (value & REPROJECTED) != 0u ? 4u : 64u;
+    return phase != global.frame % period;
 }
 
 void main() {
-	vec2 uv = (gl_FragCoord.xy - 0.5 * global.resolution.xy) / global.resolution.y;
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	uint width = uint(global.resolution.x);
+	uint tilesX = (width + TILE_SIZE - 1u) / TILE_SIZE;
+	uvec2 tile = pixel / TILE_SIZE;
+	uint budget = tiles[tile.y * tilesX + tile.x].budget;
+	int steps = budget == BUDGET_FULL ? MAX_STEPS : min(MAX_STEPS, int(budget));
+
+	vec2 uv = (gl_FragCoord.xy - cell.xy - 0.5 * cell.zw) / cell.w;
+	vec2 c = global.center + global.scale * uv;
+
+    uint used;
+    if (!reproject(c, pixel, used))
+        used = mandelbrot(c, steps);
+
+    // the supersampled shades are only valid while the view stands still. not tied to the history,
+    // which is dropped without reprojection and while sliced
+    float shade = -1.;
+    if (global.still != 0u)
+        shade = shades[pixel.y * width + pixel.x];
 
     vec3 col = vec3(0);
-    col += mandelbrot(uv);
-	col *= sin(vec3(0.2, 0.8, 0.9) * global.time) * 0.5 + 0.5;
+    if (shade >= 0.)
+        col += equalize(shade * float(MAX_STEPS));
+    else if ((used & INTERIOR) == 0u)
+        col += equalize(float(used & ITERATIONS));
+	// parameters.x offsets the time, so cells of the same effect do not animate in lockstep
+	col *= sin(vec3(0.2, 0.8, 0.9) * (global.time + parameters.x)) * 0.5 + 0.5;
+
+	iterations[pixel.y * width + pixel.x] = used;
 
 	fragColor = vec4(col, 1.0);
 }
\ No newline at end of file
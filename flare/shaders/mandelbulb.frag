@@ -0,0 +1,72 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+// sphere traced power 8 mandelbulb. the rays start at the depth mandelbulb.cone.comp found for
+// their tile instead of at the camera, the depths are 0 without the pre-pass
+
+#include "mandelbulb.glsl"
+
+// framebuffer area of the instance, offset xy and size zw
+layout(location = 0) in flat vec4 cell;
+layout(location = 1) in flat vec4 parameters;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(push_constant) uniform globalConstant {
+    vec2 resolution;
+	float time;
+	float scale;
+	vec2 center;
+} global;
+
+// quality knob, selected per pipeline variant without recompiling the shader
+layout(constant_id = 0) const int MAX_STEPS = 128;
+
+layout(set = 7, binding = 0) readonly buffer Depths {
+    float depths[];
+};
+
+vec3 normal(in vec3 p, in float epsilon) {
+    vec2 e = vec2(epsilon, 0.);
+    return normalize(vec3(distanceEstimate(p + e.xyy) - distanceEstimate(p - e.xyy),
+                          distanceEstimate(p + e.yxy) - distanceEstimate(p - e.yxy),
+                          distanceEstimate(p + e.yyx) - distanceEstimate(p - e.yyx)));
+}
+
+void main() {
+    Camera cam = camera(global.center, global.scale, global.time);
+    vec2 uv = (gl_FragCoord.xy - cell.xy - 0.5 * cell.zw) / cell.w;
+    vec3 direction = rayDirection(cam, uv);
+
+    uvec2 tile = uvec2(gl_FragCoord.xy) / CONE_TILE;
+    uint width = (uint(global.resolution.x) + CONE_TILE - 1u) / CONE_TILE;
+    float t = depths[tile.y * width + tile.x];
+
+    // a hit is closer than the footprint of the pixel
+    float pixel = 0.5 / (cell.w * FOCAL);
+    bool hit = false;
+    for (int i = 0; i < MAX_STEPS && t < cam.far; ++i) {
+        float d = distanceEstimate(cam.origin + t * direction);
+        if (d < t * pixel) {
+            hit = true;
+            break;
+        }
+        t += d;
+    }
+
+    vec3 col = mix(vec3(0.05, 0.06, 0.09), vec3(0.15, 0.17, 0.22), 0.5 - 0.5 * uv.y);
+    if (hit) {
+        vec3 p = cam.origin + t * direction;
+        vec3 n = normal(p, max(t * pixel, 1e-4));
+        vec3 light = normalize(vec3(0.6, 0.8, -0.4));
+        float diffuse = max(dot(n, light), 0.);
+        // crevices are darkened by how close the surface is a short way along the normal, unlike the
+        // step count this does not depend on where the ray started
+        float occlusion = clamp(distanceEstimate(p + 0.05 * n) / 0.05, 0., 1.);
+        vec3 albedo = 0.5 + 0.5 * cos(vec3(0., 0.6, 1.2) + 3. * length(p));
+        col = albedo * (0.15 + 0.85 * diffuse) * occlusion;
+    }
+
+    fragColor = vec4(col, 1.0);
+}
\ No newline at end of file